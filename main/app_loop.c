@@ -0,0 +1,105 @@
+/*
+ * Loop task and the esp_timer that wakes it, the passes themselves are run by app_loop_dispatch.c.
+ */
+
+#include "app_loop.h"
+
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "APP_LOOP";
+
+static StackType_t loop_task_stack[APP_LOOP_TASK_STACK_SIZE];
+static StaticTask_t loop_task_buffer;
+
+/* free stack logged last by app_loop_log_stack, only accessed on the loop task */
+static uint32_t logged_stack_free = UINT32_MAX;
+
+/* one-shot timer that wakes the loop at the earliest deadline of the wheel */
+static esp_timer_handle_t wake_timer = NULL;
+
+TaskHandle_t app_loop_task_handle = NULL;
+
+static void wake_timer_callback(void *arg)
+{
+    (void)arg;
+    app_loop_signal(APP_LOOP_SIGNAL_WAKE);
+}
+
+static void arm_wake_timer(void)
+{
+    int64_t deadline_us = app_loop_next_deadline();
+    esp_timer_stop(wake_timer);
+    if (deadline_us != TIMER_WHEEL_NO_DEADLINE)
+    {
+        int64_t timeout_us = deadline_us - esp_timer_get_time();
+        ESP_ERROR_CHECK(esp_timer_start_once(wake_timer, timeout_us > 0 ? timeout_us : 0));
+    }
+}
+
+static void app_loop_task(void *arg)
+{
+    // FreeRTOS task entry requires this parameter, even though this task does not use it.
+    (void)arg;
+    for (;;)
+    {
+        // sleep until a signal is raised or the wake timer expires
+        uint32_t signals = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &signals, portMAX_DELAY);
+        app_loop_run_pass(signals);
+        arm_wake_timer();
+    }
+}
+
+esp_err_t app_loop_init(void)
+{
+    ESP_RETURN_ON_FALSE(app_loop_task_handle == NULL, ESP_ERR_INVALID_STATE, TAG, "Loop already initialized");
+
+    const esp_timer_create_args_t wake_timer_args = {
+        .callback = &wake_timer_callback,
+        .name = "app_loop_wake",
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&wake_timer_args, &wake_timer), TAG, "Unable to create wake timer");
+
+    app_loop_task_handle = xTaskCreateStatic(app_loop_task, "app_loop", APP_LOOP_TASK_STACK_SIZE, NULL,
+                                             APP_LOOP_TASK_PRIORITY, loop_task_stack, &loop_task_buffer);
+    return ESP_OK;
+}
+
+void app_loop_signal(app_loop_signal_t signal)
+{
+    if (app_loop_task_handle != NULL)
+    {
+        xTaskNotify(app_loop_task_handle, 1UL << signal, eSetBits);
+    }
+}
+
+uint32_t app_loop_get_stack_high_water_mark(void)
+{
+    if (app_loop_task_handle == NULL)
+    {
+        return 0;
+    }
+    // StackType_t is a byte on ESP-IDF, so the result is in bytes
+    return uxTaskGetStackHighWaterMark(app_loop_task_handle) * sizeof(StackType_t);
+}
+
+void app_loop_log_stack(const char *where)
+{
+    uint32_t stack_free = app_loop_get_stack_high_water_mark();
+    if (stack_free < logged_stack_free)
+    {
+        logged_stack_free = stack_free;
+        if (stack_free < APP_LOOP_STACK_MARGIN)
+        {
+            ESP_LOGW(TAG, "Stack: only %lu of %u bytes left after %s, raise APP_LOOP_TASK_STACK_SIZE",
+                     (unsigned long)stack_free, (unsigned int)APP_LOOP_TASK_STACK_SIZE, where);
+        }
+        else
+        {
+            ESP_LOGI(TAG, "Stack: %lu of %u bytes left after %s", (unsigned long)stack_free,
+                     (unsigned int)APP_LOOP_TASK_STACK_SIZE, where);
+        }
+    }
+}
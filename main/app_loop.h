@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "timer_wheel.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* the loop runs all input callbacks, pulse completions and timers of the application, including the NVS write
+ * after a calibration, steering retries and the OTA reboot, on the stack that used to belong to the debounce task.
+ * Not measured on the target yet: app_loop_log_stack() logs the free stack after these paths and warns below
+ * APP_LOOP_STACK_MARGIN, diagnostics attribute LOOP_STACK_FREE has the minimum since boot. Size it from those */
+#ifndef APP_LOOP_TASK_STACK_SIZE
+#define APP_LOOP_TASK_STACK_SIZE 3072
+#endif
+#define APP_LOOP_STACK_MARGIN 512 /* free bytes left below which app_loop_log_stack warns */
+#define APP_LOOP_TASK_PRIORITY 10
+#define APP_LOOP_EVENT_DEPTH 16  /* events waiting for the loop, newer ones are dropped when full */
+#define APP_LOOP_TICK_US 1000    /* slot width of the timer wheel, deadlines themselves are exact */
+
+    /**
+     * Signals wake the loop from ISRs and other tasks without queueing anything, repeated signals collapse.
+     * Every pass runs the handlers of the raised signals in this order, then the posted events in the
+     * order they were posted, then the expired timers ordered by deadline and start.
+     */
+    typedef enum app_loop_signal_enum
+    {
+        APP_LOOP_SIGNAL_WAKE = 0, /* events were posted or timers changed, no handler */
+        APP_LOOP_SIGNAL_INPUTS,   /* gpio edges arrived or an input tick was requested */
+        APP_LOOP_SIGNAL_COUNT
+    } app_loop_signal_t;
+
+    typedef void (*app_loop_signal_handler)(void);
+    /* runs on the loop task, posted with app_loop_post */
+    typedef void (*app_loop_event_handler)(uint32_t arg);
+    /* runs on the loop task when the timer expires */
+    typedef void (*app_loop_timer_cb)(void *arg);
+
+    /** one-shot timer of the loop, owned by its user and never allocated */
+    typedef struct app_loop_timer_t
+    {
+        timer_wheel_entry_t entry; /* first member, the loop gets from the entry back to the timer */
+        app_loop_timer_cb callback;
+        void *arg;
+    } app_loop_timer_t;
+
+    /* written once by app_loop_init, read by app_loop_signal_from_isr */
+    extern TaskHandle_t app_loop_task_handle;
+
+    /**
+     * Single task of the application that replaces separate tasks and esp_timers for inputs, pulses,
+     * retries and delayed actions. One esp_timer wakes the loop at the earliest deadline of the timer wheel.
+     * Work that needs the zigbee stack is handed on with zb_cmd_queue_post.
+     */
+    esp_err_t app_loop_init(void);
+
+    /* lets a module handle @p signal on the loop, set before the signal is raised for the first time */
+    void app_loop_set_signal_handler(app_loop_signal_t signal, app_loop_signal_handler handler);
+
+    /* raise @p signal, safe to call from any task */
+    void app_loop_signal(app_loop_signal_t signal);
+
+    /* raise @p signal from an ISR, always inlined so it runs from IRAM as part of the interrupt handler */
+    static inline __attribute__((always_inline)) void app_loop_signal_from_isr(app_loop_signal_t signal)
+    {
+        BaseType_t higher_priority_task_woken = pdFALSE;
+        xTaskNotifyFromISR(app_loop_task_handle, 1UL << signal, eSetBits, &higher_priority_task_woken);
+        portYIELD_FROM_ISR(higher_priority_task_woken);
+    }
+
+    /**
+     * @brief Run @p handler with @p arg on the loop task. Safe to call from any task, not from ISRs.
+     * @return ESP_ERR_NO_MEM if the queue is full and the event was dropped
+     */
+    esp_err_t app_loop_post(app_loop_event_handler handler, uint32_t arg);
+
+    /* prepares @p timer, nothing is allocated */
+    void app_loop_timer_init(app_loop_timer_t *timer, app_loop_timer_cb callback, void *arg);
+    /* (re)starts @p timer to expire at @p deadline_us (esp_timer_get_time), safe to call from any task */
+    void app_loop_timer_start_at(app_loop_timer_t *timer, int64_t deadline_us);
+    /* (re)starts @p timer to expire @p timeout_us from now, safe to call from any task */
+    void app_loop_timer_start_once(app_loop_timer_t *timer, uint64_t timeout_us);
+    /* stops @p timer, a callback that already started still completes */
+    void app_loop_timer_stop(app_loop_timer_t *timer);
+    bool app_loop_timer_is_active(const app_loop_timer_t *timer);
+
+    /**
+     * @brief One pass of the loop: handlers of the raised @p signals, the events queued before the pass, then the
+     * timers expired at esp_timer_get_time(). Runs on the loop task, the host simulation calls it the same way.
+     */
+    void app_loop_run_pass(uint32_t signals);
+
+    /* deadline of the earliest timer, TIMER_WHEEL_NO_DEADLINE if none is active */
+    int64_t app_loop_next_deadline(void);
+
+    /* minimum free stack of the loop task ever seen, in bytes */
+    uint32_t app_loop_get_stack_high_water_mark(void);
+
+    /* on the loop task: logs the minimum free stack if it dropped since the last call, @p where names the path that just ran */
+    void app_loop_log_stack(const char *where);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,153 @@
+/*
+ * Event queue, timer wheel and the pass that dispatches signals, events and timers. Shared by the loop task
+ * in app_loop.c and the host simulation, so the host tests replay the firmware's own ordering.
+ */
+
+#include "app_loop.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "APP_LOOP";
+
+typedef struct app_loop_event_t
+{
+    app_loop_event_handler handler;
+    uint32_t arg;
+} app_loop_event_t;
+
+static app_loop_signal_handler signal_handlers[APP_LOOP_SIGNAL_COUNT];
+
+/* written by any task under loop_lock, read by the loop task */
+static app_loop_event_t events[APP_LOOP_EVENT_DEPTH];
+static uint32_t events_head = 0; /* next event to write */
+static uint32_t events_tail = 0; /* next event to run */
+/* the wheel is changed from any task under loop_lock, callbacks run without it */
+static timer_wheel_t wheel = {.tick_us = APP_LOOP_TICK_US};
+static portMUX_TYPE loop_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool pop_event(app_loop_event_t *event)
+{
+    bool available;
+    taskENTER_CRITICAL(&loop_lock);
+    available = events_head != events_tail;
+    if (available)
+    {
+        *event = events[events_tail % APP_LOOP_EVENT_DEPTH];
+        events_tail++;
+    }
+    taskEXIT_CRITICAL(&loop_lock);
+    return available;
+}
+
+static app_loop_timer_t *pop_expired_timer(int64_t now_us)
+{
+    taskENTER_CRITICAL(&loop_lock);
+    timer_wheel_entry_t *entry = timer_wheel_pop_expired(&wheel, now_us);
+    taskEXIT_CRITICAL(&loop_lock);
+    // entry is the first member of app_loop_timer_t
+    return (app_loop_timer_t *)entry;
+}
+
+void app_loop_run_pass(uint32_t signals)
+{
+    for (int signal = 0; signal < APP_LOOP_SIGNAL_COUNT; ++signal)
+    {
+        if ((signals & (1UL << signal)) && signal_handlers[signal] != NULL)
+        {
+            signal_handlers[signal]();
+        }
+    }
+
+    // only the events that are already queued, events posted by handlers run in the next pass
+    taskENTER_CRITICAL(&loop_lock);
+    uint32_t pending = events_head - events_tail;
+    taskEXIT_CRITICAL(&loop_lock);
+    app_loop_event_t event;
+    while (pending-- > 0 && pop_event(&event))
+    {
+        event.handler(event.arg);
+    }
+
+    // timers are checked against a single point in time, so the order doesn't depend on how long callbacks take
+    int64_t now_us = esp_timer_get_time();
+    app_loop_timer_t *timer;
+    while ((timer = pop_expired_timer(now_us)) != NULL)
+    {
+        timer->callback(timer->arg);
+    }
+}
+
+int64_t app_loop_next_deadline(void)
+{
+    taskENTER_CRITICAL(&loop_lock);
+    int64_t deadline_us = timer_wheel_next_deadline(&wheel);
+    taskEXIT_CRITICAL(&loop_lock);
+    return deadline_us;
+}
+
+void app_loop_set_signal_handler(app_loop_signal_t signal, app_loop_signal_handler handler)
+{
+    if (signal < APP_LOOP_SIGNAL_COUNT)
+    {
+        signal_handlers[signal] = handler;
+    }
+}
+
+esp_err_t app_loop_post(app_loop_event_handler handler, uint32_t arg)
+{
+    taskENTER_CRITICAL(&loop_lock);
+    if (events_head - events_tail >= APP_LOOP_EVENT_DEPTH)
+    {
+        taskEXIT_CRITICAL(&loop_lock);
+        ESP_LOGW(TAG, "Event queue full, dropping event");
+        return ESP_ERR_NO_MEM;
+    }
+    events[events_head % APP_LOOP_EVENT_DEPTH] = (app_loop_event_t){
+        .handler = handler,
+        .arg = arg,
+    };
+    events_head++;
+    taskEXIT_CRITICAL(&loop_lock);
+
+    app_loop_signal(APP_LOOP_SIGNAL_WAKE);
+    return ESP_OK;
+}
+
+void app_loop_timer_init(app_loop_timer_t *timer, app_loop_timer_cb callback, void *arg)
+{
+    *timer = (app_loop_timer_t){
+        .callback = callback,
+        .arg = arg,
+    };
+}
+
+void app_loop_timer_start_at(app_loop_timer_t *timer, int64_t deadline_us)
+{
+    taskENTER_CRITICAL(&loop_lock);
+    timer_wheel_start(&wheel, &timer->entry, deadline_us);
+    taskEXIT_CRITICAL(&loop_lock);
+    // the loop re-arms its wake up after every pass, other tasks have to wake it up for that
+    if (xTaskGetCurrentTaskHandle() != app_loop_task_handle)
+    {
+        app_loop_signal(APP_LOOP_SIGNAL_WAKE);
+    }
+}
+
+void app_loop_timer_start_once(app_loop_timer_t *timer, uint64_t timeout_us)
+{
+    app_loop_timer_start_at(timer, esp_timer_get_time() + (int64_t)timeout_us);
+}
+
+void app_loop_timer_stop(app_loop_timer_t *timer)
+{
+    // an earlier wake up than necessary is harmless, the wake timer isn't touched
+    taskENTER_CRITICAL(&loop_lock);
+    timer_wheel_stop(&wheel, &timer->entry);
+    taskEXIT_CRITICAL(&loop_lock);
+}
+
+bool app_loop_timer_is_active(const app_loop_timer_t *timer)
+{
+    return timer->entry.active;
+}
@@ -0,0 +1,97 @@
+#include "debounce_fsm.h"
+
+void debounce_fsm_init(debounce_fsm_t *fsm, const gpio_input_timing_profile_t *profile, uint8_t level, int64_t now_us)
+{
+    fsm->profile = *profile;
+    fsm->phase = DEBOUNCE_FSM_IDLE;
+    fsm->level = level;
+    fsm->stable_level = level;
+    // the initial level was never reported, so don't report a long state for it either
+    fsm->long_reported = true;
+    fsm->last_edge_us = now_us;
+    fsm->deadline_us = DEBOUNCE_FSM_NO_DEADLINE;
+    fsm->glitch_count = 0;
+}
+
+void debounce_fsm_edge(debounce_fsm_t *fsm, uint8_t level, int64_t timestamp_us)
+{
+    fsm->level = level;
+    fsm->last_edge_us = timestamp_us;
+    fsm->phase = DEBOUNCE_FSM_SETTLING;
+    fsm->deadline_us = timestamp_us + fsm->profile.debounce_us;
+}
+
+void debounce_fsm_settled(debounce_fsm_t *fsm, uint8_t level, int64_t timestamp_us)
+{
+    fsm->level = level;
+    fsm->last_edge_us = timestamp_us;
+    fsm->phase = DEBOUNCE_FSM_SETTLING;
+    fsm->deadline_us = timestamp_us;
+}
+
+static void enter_holding_or_idle(debounce_fsm_t *fsm)
+{
+    if (fsm->profile.long_press_us != 0 && !fsm->long_reported)
+    {
+        fsm->phase = DEBOUNCE_FSM_HOLDING;
+        fsm->deadline_us = fsm->last_edge_us + fsm->profile.long_press_us;
+    }
+    else
+    {
+        fsm->phase = DEBOUNCE_FSM_IDLE;
+        fsm->deadline_us = DEBOUNCE_FSM_NO_DEADLINE;
+    }
+}
+
+bool debounce_fsm_update(debounce_fsm_t *fsm, int64_t now_us, gpio_input_state_t *event)
+{
+    if (fsm->phase == DEBOUNCE_FSM_IDLE || now_us < fsm->deadline_us)
+    {
+        return false;
+    }
+
+    switch (fsm->phase)
+    {
+    case DEBOUNCE_FSM_SETTLING:
+        if (fsm->level == fsm->stable_level)
+        {
+            // glitch, the level went back to where it was: nothing to report
+            fsm->glitch_count++;
+            enter_holding_or_idle(fsm);
+            return false;
+        }
+        fsm->stable_level = fsm->level;
+        fsm->long_reported = false;
+        enter_holding_or_idle(fsm);
+        *event = fsm->stable_level;
+        return true;
+
+    case DEBOUNCE_FSM_HOLDING:
+        fsm->long_reported = true;
+        if (fsm->profile.repeat_us != 0)
+        {
+            fsm->phase = DEBOUNCE_FSM_REPEATING;
+            fsm->deadline_us += fsm->profile.repeat_us;
+        }
+        else
+        {
+            fsm->phase = DEBOUNCE_FSM_IDLE;
+            fsm->deadline_us = DEBOUNCE_FSM_NO_DEADLINE;
+        }
+        *event = fsm->stable_level + 2;
+        return true;
+
+    case DEBOUNCE_FSM_REPEATING:
+        fsm->deadline_us += fsm->profile.repeat_us;
+        *event = fsm->stable_level + 2;
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+int64_t debounce_fsm_next_deadline(const debounce_fsm_t *fsm)
+{
+    return fsm->phase == DEBOUNCE_FSM_IDLE ? DEBOUNCE_FSM_NO_DEADLINE : fsm->deadline_us;
+}
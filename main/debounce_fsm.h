@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef enum gpio_input_state_enum
+    {
+        ON = 0,
+        OFF = 1,
+        ON_LONG = 2,
+        OFF_LONG = 3
+    } gpio_input_state_t;
+
+    /** per-pin timing, all values in microseconds */
+    typedef struct gpio_input_timing_profile_t
+    {
+        uint32_t debounce_us;   /* level must be stable this long after the last edge */
+        uint32_t long_press_us; /* time after the last edge until the long state is reported, 0 disables it */
+        uint32_t repeat_us;     /* interval for repeating the long state while it is held, 0 disables it */
+    } gpio_input_timing_profile_t;
+
+    typedef enum debounce_fsm_phase_enum
+    {
+        DEBOUNCE_FSM_IDLE = 0,   /* stable, nothing pending */
+        DEBOUNCE_FSM_SETTLING,   /* edge seen, waiting for the level to settle */
+        DEBOUNCE_FSM_HOLDING,    /* debounced state reported, waiting for long press */
+        DEBOUNCE_FSM_REPEATING,  /* long state reported, repeating it while held */
+    } debounce_fsm_phase_t;
+
+    /**
+     * Debounce state of a single input.
+     * Pure logic without any hardware or OS dependency, time is passed in by the caller.
+     */
+    typedef struct debounce_fsm_t
+    {
+        gpio_input_timing_profile_t profile;
+        debounce_fsm_phase_t phase;
+        uint8_t level;        /* level of the most recent edge */
+        uint8_t stable_level; /* last reported debounced level */
+        bool long_reported;   /* long state was reported for stable_level */
+        int64_t last_edge_us; /* time of the most recent edge */
+        int64_t deadline_us;  /* next time the state machine needs to run, valid unless idle */
+        uint32_t glitch_count; /* edge bursts that settled back to stable_level */
+    } debounce_fsm_t;
+
+#define DEBOUNCE_FSM_NO_DEADLINE INT64_MAX
+
+    /**
+     * @brief Initialize the state machine with a known stable level.
+     */
+    void debounce_fsm_init(debounce_fsm_t *fsm, const gpio_input_timing_profile_t *profile, uint8_t level, int64_t now_us);
+
+    /**
+     * @brief Feed an edge (level change) into the state machine.
+     */
+    void debounce_fsm_edge(debounce_fsm_t *fsm, uint8_t level, int64_t timestamp_us);
+
+    /**
+     * @brief Feed a level that was already debounced elsewhere, it is reported on the next update.
+     */
+    void debounce_fsm_settled(debounce_fsm_t *fsm, uint8_t level, int64_t timestamp_us);
+
+    /**
+     * @brief Advance the state machine to @p now_us.
+     *
+     * Call repeatedly until it returns false, each call reports at most one event.
+     *
+     * @param[out] event  the detected state, valid when true is returned
+     * @return true if an event was detected
+     */
+    bool debounce_fsm_update(debounce_fsm_t *fsm, int64_t now_us, gpio_input_state_t *event);
+
+    /**
+     * @brief Time at which debounce_fsm_update() needs to be called next, DEBOUNCE_FSM_NO_DEADLINE if idle.
+     */
+    int64_t debounce_fsm_next_deadline(const debounce_fsm_t *fsm);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,168 @@
+#include "diag_counters.h"
+
+#include "esp_check.h"
+#include "esp_log.h"
+#include "app_loop.h"
+#include "latency_probe.h"
+
+static const char *TAG = "DIAG";
+
+_Atomic uint32_t diag_counters[DIAG_COUNTER_COUNT];
+
+static const uint16_t diag_attr_ids[DIAG_COUNTER_COUNT] = {
+#define DIAG_ATTR_ID(name, attr_id) attr_id,
+    DIAG_COUNTERS(DIAG_ATTR_ID)
+#undef DIAG_ATTR_ID
+};
+
+/* values last written to the attributes, only accessed on the zigbee task */
+static uint32_t published[DIAG_COUNTER_COUNT];
+static uint16_t diag_manufacturer_code;
+static uint8_t diag_endpoint;
+static uint32_t published_latency_count;
+/* ZCL octet string: length byte followed by the saturated bucket counts */
+static uint8_t latency_hist_attr[1 + LATENCY_HIST_BUCKETS * 2];
+
+void diag_counter_max(diag_counter_t counter, uint32_t value)
+{
+    uint32_t current = atomic_load_explicit(&diag_counters[counter], memory_order_relaxed);
+    while (current < value &&
+           !atomic_compare_exchange_weak_explicit(&diag_counters[counter], &current, value,
+                                                  memory_order_relaxed, memory_order_relaxed))
+    {
+    }
+}
+
+esp_err_t diag_add_cluster(esp_zb_cluster_list_t *cluster_list, uint16_t manufacturer_code)
+{
+    diag_manufacturer_code = manufacturer_code;
+
+    esp_zb_diagnostics_cluster_cfg_t diag_cfg = {0};
+    esp_zb_attribute_list_t *diag_cluster = esp_zb_diagnostics_cluster_create(&diag_cfg);
+    ESP_RETURN_ON_FALSE(diag_cluster, ESP_ERR_NO_MEM, TAG, "Failed to create diagnostics cluster");
+
+    // standard counters, maintained by the stack. The MAC counters are 32 bit, the rest 16 bit
+    uint32_t counter32 = 0;
+    uint16_t counter16 = 0;
+    uint8_t lqi = 0;
+    int8_t rssi = 0;
+    static const uint16_t counter32_ids[] = {
+        ESP_ZB_ZCL_ATTR_DIAGNOSTICS_MAC_RX_BCAST_ID,
+        ESP_ZB_ZCL_ATTR_DIAGNOSTICS_MAC_TX_BCAST_ID,
+        ESP_ZB_ZCL_ATTR_DIAGNOSTICS_MAC_RX_UCAST_ID,
+        ESP_ZB_ZCL_ATTR_DIAGNOSTICS_MAC_TX_UCAST_ID,
+    };
+    static const uint16_t counter16_ids[] = {
+        ESP_ZB_ZCL_ATTR_DIAGNOSTICS_MAC_TX_UCAST_RETRY_ID,
+        ESP_ZB_ZCL_ATTR_DIAGNOSTICS_MAC_TX_UCAST_FAIL_ID,
+        ESP_ZB_ZCL_ATTR_DIAGNOSTICS_APS_RX_BCAST_ID,
+        ESP_ZB_ZCL_ATTR_DIAGNOSTICS_APS_TX_BCAST_ID,
+        ESP_ZB_ZCL_ATTR_DIAGNOSTICS_APS_RX_UCAST_ID,
+        ESP_ZB_ZCL_ATTR_DIAGNOSTICS_APS_TX_UCAST_SUCCESS_ID,
+        ESP_ZB_ZCL_ATTR_DIAGNOSTICS_APS_TX_UCAST_RETRY_ID,
+        ESP_ZB_ZCL_ATTR_DIAGNOSTICS_APS_TX_UCAST_FAIL_ID,
+    };
+    for (size_t i = 0; i < sizeof(counter32_ids) / sizeof(counter32_ids[0]); ++i)
+    {
+        ESP_RETURN_ON_ERROR(esp_zb_diagnostics_cluster_add_attr(diag_cluster, counter32_ids[i], &counter32), TAG,
+                            "Failed to add diagnostics attribute 0x%04x", counter32_ids[i]);
+    }
+    for (size_t i = 0; i < sizeof(counter16_ids) / sizeof(counter16_ids[0]); ++i)
+    {
+        ESP_RETURN_ON_ERROR(esp_zb_diagnostics_cluster_add_attr(diag_cluster, counter16_ids[i], &counter16), TAG,
+                            "Failed to add diagnostics attribute 0x%04x", counter16_ids[i]);
+    }
+    ESP_RETURN_ON_ERROR(esp_zb_diagnostics_cluster_add_attr(diag_cluster, ESP_ZB_ZCL_ATTR_DIAGNOSTICS_LAST_MESSAGE_LQI_ID, &lqi),
+                        TAG, "Failed to add LQI attribute");
+    ESP_RETURN_ON_ERROR(esp_zb_diagnostics_cluster_add_attr(diag_cluster, ESP_ZB_ZCL_ATTR_DIAGNOSTICS_LAST_MESSAGE_RSSI_ID, &rssi),
+                        TAG, "Failed to add RSSI attribute");
+
+    // our own counters. The stack takes the size of the octet string from its length byte when the attribute is added,
+    // it has to cover all buckets before any latency is published
+    latency_hist_attr[0] = LATENCY_HIST_BUCKETS * 2;
+    ESP_RETURN_ON_ERROR(esp_zb_cluster_add_manufacturer_attr(diag_cluster, ESP_ZB_ZCL_CLUSTER_ID_DIAGNOSTICS,
+                                                             DIAG_LATENCY_HIST_ATTR_ID, manufacturer_code,
+                                                             ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING,
+                                                             ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, latency_hist_attr),
+                        TAG, "Failed to add latency histogram attribute");
+    for (int i = 0; i < DIAG_COUNTER_COUNT; ++i)
+    {
+        uint32_t value = 0;
+        ESP_RETURN_ON_ERROR(esp_zb_cluster_add_manufacturer_attr(diag_cluster, ESP_ZB_ZCL_CLUSTER_ID_DIAGNOSTICS,
+                                                                 diag_attr_ids[i], manufacturer_code,
+                                                                 ESP_ZB_ZCL_ATTR_TYPE_U32,
+                                                                 ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &value),
+                            TAG, "Failed to add diagnostics attribute 0x%04x", diag_attr_ids[i]);
+    }
+
+    return esp_zb_cluster_list_add_diagnostics_cluster(cluster_list, diag_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+}
+
+/* copies the write to attribute update latencies into the attributes, returns true if there were new samples */
+static bool publish_latency(void)
+{
+    const latency_hist_t *hist = latency_probe_hist(LATENCY_PROBE_ATTRIBUTE_SET);
+    uint32_t count = latency_hist_count(hist);
+    if (count == published_latency_count)
+    {
+        return false;
+    }
+    published_latency_count = count;
+
+    diag_counter_set(DIAG_LATENCY_P50_US, latency_hist_percentile(hist, 50));
+    diag_counter_set(DIAG_LATENCY_P99_US, latency_hist_percentile(hist, 99));
+
+    for (int i = 0; i < LATENCY_HIST_BUCKETS; ++i)
+    {
+        uint32_t bucket = atomic_load_explicit(&hist->buckets[i], memory_order_relaxed);
+        uint16_t saturated = bucket > UINT16_MAX ? UINT16_MAX : bucket;
+        latency_hist_attr[1 + i * 2] = saturated & 0xFF;
+        latency_hist_attr[2 + i * 2] = saturated >> 8;
+    }
+    esp_zb_zcl_set_manufacturer_attribute_val(diag_endpoint, ESP_ZB_ZCL_CLUSTER_ID_DIAGNOSTICS,
+                                              ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, diag_manufacturer_code,
+                                              DIAG_LATENCY_HIST_ATTR_ID, latency_hist_attr, false);
+    return true;
+}
+
+/* scheduler alarm, runs on the zigbee task */
+static void diag_publish(uint8_t param)
+{
+    if (publish_latency())
+    {
+        latency_probe_dump();
+    }
+    diag_counter_set(DIAG_LOOP_STACK_FREE, app_loop_get_stack_high_water_mark());
+
+    int changed = 0;
+    for (int i = 0; i < DIAG_COUNTER_COUNT; ++i)
+    {
+        uint32_t value = atomic_load_explicit(&diag_counters[i], memory_order_relaxed);
+        if (value == published[i])
+        {
+            continue;
+        }
+        esp_zb_zcl_status_t status = esp_zb_zcl_set_manufacturer_attribute_val(diag_endpoint,
+                                                                               ESP_ZB_ZCL_CLUSTER_ID_DIAGNOSTICS,
+                                                                               ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                                                               diag_manufacturer_code,
+                                                                               diag_attr_ids[i],
+                                                                               &value,
+                                                                               false);
+        if (status == ESP_ZB_ZCL_STATUS_SUCCESS)
+        {
+            published[i] = value;
+            changed++;
+        }
+    }
+    ESP_LOGD(TAG, "Published %i changed counters", changed);
+
+    esp_zb_scheduler_alarm(diag_publish, 0, DIAG_PUBLISH_INTERVAL_MS);
+}
+
+void diag_start_publishing(uint8_t endpoint)
+{
+    diag_endpoint = endpoint;
+    esp_zb_scheduler_alarm_cancel(diag_publish, 0);
+    diag_publish(0);
+}
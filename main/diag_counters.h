@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_zigbee_core.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* manufacturer specific attributes of the diagnostics cluster: X(name, attribute id), all uint32 */
+#define DIAG_COUNTERS(X)                                                                                  \
+    X(TOGGLES, 0xF000)              /* toggle pulses issued */                                            \
+    X(DEBOUNCED_EVENTS, 0xF001)     /* debounced input events of all pins */                              \
+    X(LONG_PRESSES, 0xF002)         /* long and repeated long events */                                   \
+    X(STEERING_RETRIES, 0xF003)     /* network steering retries since boot */                             \
+    X(STEERING_MAX_ATTEMPT, 0xF004) /* highest steering retry attempt reached */                          \
+    X(OTA_BYTES, 0xF005)            /* OTA image bytes received */                                        \
+    X(OTA_ABORTS, 0xF006)           /* aborted OTA upgrades */                                            \
+    X(ACTUATION_LATENCY_MS, 0xF007) /* request to LED confirmation of the last switch */                  \
+    X(RESET_REASON, 0xF008)         /* esp_reset_reason() of the current boot */                          \
+    X(LATENCY_P50_US, 0xF009)       /* median time from a PresentValue write to the attribute update */   \
+    X(LATENCY_P99_US, 0xF00A)       /* 99th percentile of the same, both are log2 bucket upper bounds */  \
+    X(ZB_CMD_DROPS, 0xF00B)         /* commands for the zigbee task dropped because the queue was full */ \
+    X(ZB_CMD_HIGH_WATER, 0xF00C)    /* most commands waiting for the zigbee task at once */               \
+    X(ZB_CMD_DEFERRED, 0xF00D)      /* command drains delayed because the zigbee lock was busy */         \
+    X(LOOP_STACK_FREE, 0xF00E)      /* least free stack of the app loop task since boot, in bytes */
+
+/* octet string with the write to attribute update latency histogram, LATENCY_HIST_BUCKETS uint16 LE counts */
+#define DIAG_LATENCY_HIST_ATTR_ID 0xF010
+#define DIAG_PUBLISH_INTERVAL_MS (30 * 1000) /* counters are copied to the attributes this often */
+
+    typedef enum diag_counter_enum
+    {
+#define DIAG_COUNTER_ENUM(name, attr_id) DIAG_##name,
+        DIAG_COUNTERS(DIAG_COUNTER_ENUM)
+#undef DIAG_COUNTER_ENUM
+            DIAG_COUNTER_COUNT
+    } diag_counter_t;
+
+    /* written from any task or ISR, only read by the publisher */
+    extern _Atomic uint32_t diag_counters[DIAG_COUNTER_COUNT];
+
+    /**
+     * @brief Add @p amount to a counter. Lock free, doesn't touch the zigbee stack.
+     */
+    static inline void diag_counter_add(diag_counter_t counter, uint32_t amount)
+    {
+        atomic_fetch_add_explicit(&diag_counters[counter], amount, memory_order_relaxed);
+    }
+
+    /**
+     * @brief Set a gauge like the last latency. Lock free, doesn't touch the zigbee stack.
+     */
+    static inline void diag_counter_set(diag_counter_t counter, uint32_t value)
+    {
+        atomic_store_explicit(&diag_counters[counter], value, memory_order_relaxed);
+    }
+
+    /**
+     * @brief Raise a gauge to @p value if it is lower.
+     */
+    void diag_counter_max(diag_counter_t counter, uint32_t value);
+
+    /**
+     * @brief Create the diagnostics cluster with the standard MAC/APS counters kept by the stack
+     *        and the counters above, and add it to @p cluster_list.
+     */
+    esp_err_t diag_add_cluster(esp_zb_cluster_list_t *cluster_list, uint16_t manufacturer_code);
+
+    /**
+     * @brief Publish the counters to the attributes of @p endpoint every DIAG_PUBLISH_INTERVAL_MS.
+     *        New latency samples are dumped to the log at the same time.
+     *        Call from the zigbee task once the stack is running.
+     */
+    void diag_start_publishing(uint8_t endpoint);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* number of edge events that can be buffered between ISR and task, must be a power of two */
+#define EDGE_RING_SIZE 32
+#define EDGE_RING_MASK (EDGE_RING_SIZE - 1)
+
+    _Static_assert((EDGE_RING_SIZE & EDGE_RING_MASK) == 0, "EDGE_RING_SIZE must be a power of two");
+
+    /** a single level change as seen by the interrupt handler */
+    typedef struct edge_event_t
+    {
+        uint8_t input_index; /* index into the configured inputs */
+        uint8_t level;       /* level read right after the edge */
+        int64_t timestamp;   /* time of the edge in microseconds */
+    } edge_event_t;
+
+    /**
+     * Lock-free single-producer/single-consumer ring buffer.
+     * The producer only writes head, the consumer only writes tail.
+     * Both indices run freely and are masked on access.
+     */
+    typedef struct edge_ring_t
+    {
+        edge_event_t events[EDGE_RING_SIZE];
+        atomic_uint head;     /* next slot to write, owned by producer */
+        atomic_uint tail;     /* next slot to read, owned by consumer */
+        atomic_uint overflow; /* events dropped because the ring was full, owned by producer */
+    } edge_ring_t;
+
+    static inline void edge_ring_init(edge_ring_t *ring)
+    {
+        atomic_init(&ring->head, 0);
+        atomic_init(&ring->tail, 0);
+        atomic_init(&ring->overflow, 0);
+    }
+
+    /**
+     * Producer side (ISR). Returns false and counts an overflow if the ring is full.
+     * Always inlined, so it runs from IRAM as part of the interrupt handler.
+     */
+    static inline __attribute__((always_inline)) bool edge_ring_push(edge_ring_t *ring, const edge_event_t *event)
+    {
+        unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+        if (head - tail >= EDGE_RING_SIZE)
+        {
+            atomic_store_explicit(&ring->overflow,
+                                  atomic_load_explicit(&ring->overflow, memory_order_relaxed) + 1,
+                                  memory_order_release);
+            return false;
+        }
+
+        ring->events[head & EDGE_RING_MASK] = *event;
+        // publish the event only after it has been written completely
+        atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+        return true;
+    }
+
+    /**
+     * Consumer side (task). Returns false if the ring is empty.
+     */
+    static inline bool edge_ring_pop(edge_ring_t *ring, edge_event_t *event)
+    {
+        unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        unsigned int head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+        if (head == tail)
+        {
+            return false;
+        }
+
+        *event = ring->events[tail & EDGE_RING_MASK];
+        // hand the slot back to the producer only after it has been copied
+        atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+        return true;
+    }
+
+    static inline uint32_t edge_ring_overflow_count(edge_ring_t *ring)
+    {
+        return atomic_load_explicit(&ring->overflow, memory_order_acquire);
+    }
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* a pin with more edges than this within EDGE_STORM_WINDOW_US is considered noisy */
+#ifndef EDGE_STORM_MAX_EDGES
+#define EDGE_STORM_MAX_EDGES 50
+#endif
+#define EDGE_STORM_WINDOW_US (100 * 1000)
+/* sample interval of a noisy pin while its interrupt is masked */
+#define EDGE_STORM_POLL_US (10 * 1000)
+/* a noisy pin gets its interrupt back after its level didn't change for this long */
+#define EDGE_STORM_QUIET_US (1000 * 1000)
+
+    /**
+     * Edge-rate accounting of a single interrupt driven input.
+     * The ISR counts edges and trips the detector, the task then polls the pin until it is quiet.
+     * While tripped the pin's interrupt is masked, so ISR and task never run on the same fields concurrently.
+     */
+    typedef struct edge_storm_t
+    {
+        int64_t window_start_us; /* ISR: start of the current counting window */
+        uint32_t window_edges;   /* ISR: edges in the current window */
+        atomic_bool tripped;     /* set by the ISR, cleared by the task when the interrupt is enabled again */
+        bool polling;            /* task: the pin is sampled instead of interrupt driven */
+        uint8_t poll_level;      /* task: last sampled level */
+        int64_t quiet_since_us;  /* task: last level change seen while polling */
+    } edge_storm_t;
+
+    static inline void edge_storm_init(edge_storm_t *storm, int64_t now_us)
+    {
+        storm->window_start_us = now_us;
+        storm->window_edges = 0;
+        atomic_init(&storm->tripped, false);
+        storm->polling = false;
+        storm->poll_level = 0;
+        storm->quiet_since_us = now_us;
+    }
+
+    /**
+     * ISR side, accounts one edge. Returns true if the edge rate was exceeded and the interrupt has to be masked.
+     * Always inlined, so it runs from IRAM as part of the interrupt handler.
+     */
+    static inline __attribute__((always_inline)) bool edge_storm_isr_edge(edge_storm_t *storm, int64_t now_us)
+    {
+        if (now_us - storm->window_start_us >= EDGE_STORM_WINDOW_US)
+        {
+            storm->window_start_us = now_us;
+            storm->window_edges = 0;
+        }
+        if (++storm->window_edges <= EDGE_STORM_MAX_EDGES)
+        {
+            return false;
+        }
+        atomic_store_explicit(&storm->tripped, true, memory_order_release);
+        return true;
+    }
+
+    /**
+     * Task side, returns true once if the ISR tripped the detector and polling has to start.
+     */
+    static inline bool edge_storm_begin_polling(edge_storm_t *storm, uint8_t level, int64_t now_us)
+    {
+        if (storm->polling || !atomic_load_explicit(&storm->tripped, memory_order_acquire))
+        {
+            return false;
+        }
+        storm->polling = true;
+        storm->poll_level = level;
+        storm->quiet_since_us = now_us;
+        return true;
+    }
+
+    /**
+     * Task side, feeds a sampled level while polling. Returns true if the level changed.
+     */
+    static inline bool edge_storm_poll(edge_storm_t *storm, uint8_t level, int64_t now_us)
+    {
+        if (level == storm->poll_level)
+        {
+            return false;
+        }
+        storm->poll_level = level;
+        storm->quiet_since_us = now_us;
+        return true;
+    }
+
+    static inline bool edge_storm_is_quiet(const edge_storm_t *storm, int64_t now_us)
+    {
+        return now_us - storm->quiet_since_us >= EDGE_STORM_QUIET_US;
+    }
+
+    /**
+     * Task side, ends polling. Call right before the interrupt is enabled again.
+     */
+    static inline void edge_storm_resume(edge_storm_t *storm, int64_t now_us)
+    {
+        storm->polling = false;
+        storm->window_start_us = now_us;
+        storm->window_edges = 0;
+        atomic_store_explicit(&storm->tripped, false, memory_order_release);
+    }
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
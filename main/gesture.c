@@ -0,0 +1,183 @@
+#include "gesture.h"
+
+void gesture_engine_init(gesture_engine_t *engine, const gesture_def_t defs[], gesture_slot_t slots[], uint8_t count,
+                         gesture_callback cb)
+{
+    engine->defs = defs;
+    engine->slots = slots;
+    engine->count = count;
+    engine->callback = cb;
+    engine->suspended_mask = 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        slots[i] = (gesture_slot_t){.gpio_num = -1};
+    }
+}
+
+void gesture_engine_input(gesture_engine_t *engine, int gpio_num, gpio_input_state_t state, int64_t now_us)
+{
+    if ((state != ON && state != OFF) || (engine->suspended_mask & GESTURE_INPUT(gpio_num)) != 0)
+    {
+        return;
+    }
+
+    for (int i = 0; i < engine->count; ++i)
+    {
+        const gesture_def_t *def = &(engine->defs[i]);
+        gesture_slot_t *slot = &(engine->slots[i]);
+
+        if ((def->input_mask & GESTURE_INPUT(gpio_num)) == 0)
+        {
+            continue;
+        }
+
+        if (state == ON)
+        {
+            if (def->type != GESTURE_HOLD && slot->count < UINT8_MAX)
+            {
+                slot->count++;
+            }
+            slot->held = true;
+            slot->hold_fired = false;
+            slot->gpio_num = gpio_num;
+            slot->last_change_us = now_us;
+        }
+        else
+        {
+            slot->held = false;
+            if (def->type != GESTURE_HOLD && slot->count > 0)
+            {
+                // the gap is measured from the release as well
+                slot->last_change_us = now_us;
+            }
+        }
+    }
+}
+
+/**
+ * A fired hold consumes the press, so it doesn't also end up in a multi press sequence.
+ * A tap and hold consumes the hold as well, a longer plain hold on the same input doesn't fire anymore.
+ */
+static void cancel_overlapping_sequences(gesture_engine_t *engine, uint64_t input_mask, bool cancel_holds)
+{
+    for (int i = 0; i < engine->count; ++i)
+    {
+        if ((engine->defs[i].input_mask & input_mask) == 0)
+        {
+            continue;
+        }
+        if (engine->defs[i].type != GESTURE_HOLD)
+        {
+            engine->slots[i].count = 0;
+        }
+        else if (cancel_holds)
+        {
+            engine->slots[i].hold_fired = true;
+        }
+    }
+}
+
+void gesture_engine_suspend(gesture_engine_t *engine, uint64_t input_mask, bool suspended)
+{
+    uint64_t suspended_mask = suspended ? engine->suspended_mask | input_mask : engine->suspended_mask & ~input_mask;
+    if (suspended_mask == engine->suspended_mask)
+    {
+        return;
+    }
+    engine->suspended_mask = suspended_mask;
+
+    // presses before the suspension don't continue afterwards, and the held state is stale by then
+    for (int i = 0; i < engine->count; ++i)
+    {
+        if ((engine->defs[i].input_mask & input_mask) != 0)
+        {
+            engine->slots[i] = (gesture_slot_t){.gpio_num = -1};
+        }
+    }
+}
+
+int64_t gesture_engine_update(gesture_engine_t *engine, int64_t now_us)
+{
+    int64_t next_deadline = GESTURE_NO_DEADLINE;
+
+    for (int i = 0; i < engine->count; ++i)
+    {
+        const gesture_def_t *def = &(engine->defs[i]);
+        gesture_slot_t *slot = &(engine->slots[i]);
+        int64_t deadline = GESTURE_NO_DEADLINE;
+
+        switch (def->type)
+        {
+        case GESTURE_MULTI_PRESS:
+            if (slot->count == 0 || (def->wait_release && slot->held))
+            {
+                break;
+            }
+            deadline = slot->last_change_us + def->gap_us;
+            if (now_us >= deadline)
+            {
+                // sequence ended, only an exact match counts unless the rule takes more presses
+                if (slot->count == def->presses || (def->at_least && slot->count > def->presses))
+                {
+                    engine->callback(def->id, slot->gpio_num);
+                }
+                slot->count = 0;
+                deadline = GESTURE_NO_DEADLINE;
+            }
+            break;
+
+        case GESTURE_HOLD:
+            if (!slot->held || slot->hold_fired)
+            {
+                break;
+            }
+            deadline = slot->last_change_us + def->hold_us;
+            if (now_us >= deadline)
+            {
+                slot->hold_fired = true;
+                cancel_overlapping_sequences(engine, def->input_mask, false);
+                engine->callback(def->id, slot->gpio_num);
+                deadline = GESTURE_NO_DEADLINE;
+            }
+            break;
+
+        case GESTURE_TAP_HOLD:
+            if (slot->count == 0)
+            {
+                break;
+            }
+            if (!slot->held)
+            {
+                // between taps, the sequence ends after the gap
+                deadline = slot->last_change_us + def->gap_us;
+                if (now_us >= deadline)
+                {
+                    slot->count = 0;
+                    deadline = GESTURE_NO_DEADLINE;
+                }
+                break;
+            }
+            if (slot->count != def->presses)
+            {
+                // an earlier tap held too long or too many taps, the sequence ends after the release
+                break;
+            }
+            deadline = slot->last_change_us + def->hold_us;
+            if (now_us >= deadline)
+            {
+                cancel_overlapping_sequences(engine, def->input_mask, true);
+                engine->callback(def->id, slot->gpio_num);
+                deadline = GESTURE_NO_DEADLINE;
+            }
+            break;
+        }
+
+        if (deadline < next_deadline)
+        {
+            next_deadline = deadline;
+        }
+    }
+
+    return next_deadline;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "debounce_fsm.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define GESTURE_INPUT(GPIO_NUM) (1ULL << (GPIO_NUM))
+
+    typedef enum gesture_type_enum
+    {
+        GESTURE_MULTI_PRESS = 0, /* n presses (or more with at_least), each within gap_us of the previous input */
+        GESTURE_HOLD = 1,        /* input held for hold_us */
+        GESTURE_TAP_HOLD = 2,    /* presses - 1 taps within gap_us, then the next press held for hold_us */
+    } gesture_type_t;
+
+    /** one row of the gesture table */
+    typedef struct gesture_def_t
+    {
+        uint8_t id;          /* reported to the callback */
+        gesture_type_t type;
+        uint64_t input_mask; /* GESTURE_INPUT() of every input this gesture listens on */
+        uint8_t presses;     /* GESTURE_MULTI_PRESS, GESTURE_TAP_HOLD: number of presses, 2 is a double tap */
+        bool at_least;       /* GESTURE_MULTI_PRESS: more presses than that count as well, for counts nobody hits exactly */
+        bool wait_release;   /* GESTURE_MULTI_PRESS: the sequence can't end while the input is held */
+        uint32_t gap_us;     /* GESTURE_MULTI_PRESS, GESTURE_TAP_HOLD: the sequence ends after this much time without input */
+        uint32_t hold_us;    /* GESTURE_HOLD, GESTURE_TAP_HOLD: time the (last) press has to be held */
+    } gesture_def_t;
+
+    /** runtime state for one row of the gesture table */
+    typedef struct gesture_slot_t
+    {
+        uint8_t count;
+        bool held;
+        bool hold_fired;
+        int gpio_num;
+        int64_t last_change_us;
+    } gesture_slot_t;
+
+    typedef void (*gesture_callback)(uint8_t gesture_id, int gpio_num);
+
+    /**
+     * Table-driven gesture recognizer.
+     * The caller provides the table and one slot per row, the engine does not allocate.
+     * Pure logic, time is passed in by the caller.
+     */
+    typedef struct gesture_engine_t
+    {
+        const gesture_def_t *defs;
+        gesture_slot_t *slots;
+        uint8_t count;
+        gesture_callback callback;
+        uint64_t suspended_mask; /* GESTURE_INPUT() of inputs whose events are ignored */
+    } gesture_engine_t;
+
+#define GESTURE_NO_DEADLINE INT64_MAX
+
+    /**
+     * @brief Initialize the engine with a gesture table and matching slot storage.
+     */
+    void gesture_engine_init(gesture_engine_t *engine, const gesture_def_t defs[], gesture_slot_t slots[], uint8_t count,
+                             gesture_callback cb);
+
+    /**
+     * @brief Feed a debounced input event. ON is a press, OFF a release, long states are ignored.
+     */
+    void gesture_engine_input(gesture_engine_t *engine, int gpio_num, gpio_input_state_t state, int64_t now_us);
+
+    /**
+     * @brief Ignore the events of the inputs in @p input_mask while @p suspended, e.g. while the firmware itself
+     *        drives them. The sequences of gestures on these inputs are dropped when the suspension starts and ends.
+     */
+    void gesture_engine_suspend(gesture_engine_t *engine, uint64_t input_mask, bool suspended);
+
+    /**
+     * @brief Fire all gestures that are due at @p now_us.
+     *
+     * @return time at which this needs to be called again, GESTURE_NO_DEADLINE if nothing is pending
+     */
+    int64_t gesture_engine_update(gesture_engine_t *engine, int64_t now_us);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
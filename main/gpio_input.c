@@ -1,75 +1,345 @@
 #include "esp_log.h"
 #include "esp_check.h"
 #include "esp_err.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
+#include "esp_timer.h"
+#include <stdatomic.h>
+#include "app_loop.h"
 #include "gpio_input.h"
+#include "gpio_input_port.h"
+#include "input_pins.h"
+#include "edge_ring.h"
+#if GPIO_INPUT_SLEEP_WAKEUP
+#include "esp_sleep.h"
+#endif
+#if GPIO_INPUT_PORT_SCAN
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#include "vertical_debounce.h"
+#endif
 
 static const char *TAG = "GPIO_DEBOUNCED_INPUT";
 
-static uint8_t gpio_count = 0;
-static gpio_input_debounce_config_t *internal_config = NULL; /* pointer to array */
+#define GPIO_INPUT_PIN_CONFIG(gpio, timing) {.gpio_num = (gpio), .profile = timing},
+
+/* everything the input path needs is sized at compile time from the pin map, nothing is allocated */
+static const gpio_input_pin_config_t pin_map[] = {GPIO_INPUT_PINS(GPIO_INPUT_PIN_CONFIG)};
+#define gpio_count ((int)COUNT_ARRAY_ELEMENTS(pin_map))
+_Static_assert(COUNT_ARRAY_ELEMENTS(pin_map) <= UINT8_MAX, "edge events store the input index as uint8_t");
+_Static_assert(APP_LOOP_TASK_STACK_SIZE >= GPIO_INPUT_STACK_SIZE, "the input path runs on the app loop stack");
+
+/* used by the ISR, zero initialized data lives in DRAM (.dram0.bss), tools/check_iram.py verifies it */
+static gpio_input_debounce_config_t internal_config[COUNT_ARRAY_ELEMENTS(pin_map)];
 static debounced_input_callback callback = NULL;
+static gpio_input_tick_hook tick_hook = NULL;
+static gpio_input_settled_callback settled_callback = NULL;
+static gpio_input_edge_callback edge_callback = NULL;
+/* ON / OFF states were reported since the last settled callback */
+static bool settle_pending = false;
+
+/* edges travel from the ISR to the app loop through this ring, the ISR never touches internal_config state.
+ * All gpio interrupts are dispatched by the same ISR service, so there is only a single producer. */
+static edge_ring_t edge_ring;
+static uint32_t seen_overflow_count = 0;
 
-TaskHandle_t loop_task_handle = NULL;
+/* debounced level of every input (bit n is gpio n), double buffered so readers never wait for the app loop.
+ * The loop fills the inactive buffer and then publishes it by incrementing the generation. */
+static uint64_t snapshot_levels[2];
+static atomic_uint snapshot_generation;
+static uint64_t debounced_levels = 0; /* owned by the app loop */
 
+/* expires at the earliest debounce / long press deadline, the sample period in port scan mode */
+static app_loop_timer_t deadline_timer;
+static bool inputs_initialized = false;
+
+#if GPIO_INPUT_PORT_SCAN
+/* port scan mode: all inputs are debounced together from one register snapshot */
+static vertical_debounce_t port_debounce;
+static uint32_t port_mask = 0;
+static uint8_t port_bit_to_index[32];
+#endif
+
+#if !GPIO_INPUT_PORT_SCAN
 static void IRAM_ATTR gpio_interrupt_handler(void *arg)
 {
     gpio_input_debounce_config_t *input_debounce_helper = arg;
-    input_debounce_helper->interrupt_cnt++;
-    input_debounce_helper->last_state = gpio_get_level(input_debounce_helper->gpio_num);
-    input_debounce_helper->debounce_timeout = xTaskGetTickCountFromISR();
+
+    edge_event_t event = {
+        .input_index = input_debounce_helper - internal_config,
+        .level = gpio_input_port_get_level(input_debounce_helper->gpio_num),
+        .timestamp = gpio_input_port_now_us(),
+    };
+    edge_ring_push(&edge_ring, &event);
+#if GPIO_INPUT_SLEEP_WAKEUP
+    gpio_input_port_arm_level(input_debounce_helper->gpio_num, event.level);
+#endif
+
+    if (edge_storm_isr_edge(&(input_debounce_helper->storm), event.timestamp))
+    {
+        // too many edges, the loop polls this pin until it is quiet again
+        gpio_input_port_intr_disable(input_debounce_helper->gpio_num);
+    }
+
+    // wake up the app loop, it sleeps until the next edge or deadline
+    app_loop_signal_from_isr(APP_LOOP_SIGNAL_INPUTS);
 }
+#endif
 
-static const uint16_t debounce_loop_delay_ticks = 50 / portTICK_PERIOD_MS;
-static void debounce_gpio_input_loop_task(void *arg)
+#if !GPIO_INPUT_PORT_SCAN
+/**
+ * Moves all pending edge events from the ring into the per-pin state machines.
+ */
+static void drain_edge_events(void)
 {
-    // FreeRTOS task entry requires this parameter, even though this task does not use it.
-    (void)arg;
-    for (;;)
+    edge_event_t event;
+    while (edge_ring_pop(&edge_ring, &event))
+    {
+        if (event.input_index >= gpio_count)
+        {
+            continue;
+        }
+        gpio_input_debounce_config_t *gpio_helper = &(internal_config[event.input_index]);
+        gpio_helper->stats.edges++;
+        if (edge_callback != NULL)
+        {
+            edge_callback(gpio_helper->gpio_num, event.level, event.timestamp);
+        }
+        debounce_fsm_edge(&(gpio_helper->fsm), event.level, event.timestamp);
+    }
+
+    uint32_t overflow_count = edge_ring_overflow_count(&edge_ring);
+    if (overflow_count != seen_overflow_count)
     {
+        // edges were lost, the recorded levels can't be trusted anymore: restart debouncing on all pins
+        ESP_LOGW(TAG, "edge ring overflowed, %lu edges dropped", (unsigned long)(overflow_count - seen_overflow_count));
+        seen_overflow_count = overflow_count;
+
+        int64_t now = gpio_input_port_now_us();
         for (int i = 0; i < gpio_count; ++i)
         {
             gpio_input_debounce_config_t *gpio_helper = &(internal_config[i]);
-            int gpio_num = gpio_helper->gpio_num;
-            gpio_input_state_t gpio_state = gpio_get_level(gpio_num);
-
-            if ( // interrupt triggerd
-                gpio_helper->interrupt_cnt != 0 &&
-                // the input is still in the same state
-                gpio_state == gpio_helper->last_state &&
-                // check debounce time has expired
-                (xTaskGetTickCount() - gpio_helper->debounce_timeout > DEBOUNCE_TICKS))
-            {
-                // gpio_state is stable
-                ESP_LOGD(TAG, "gpio %i apprears to be stable in state %i", gpio_num, gpio_state);
+            debounce_fsm_edge(&(gpio_helper->fsm), gpio_input_port_get_level(gpio_helper->gpio_num), now);
+        }
+    }
+}
+#endif
 
-                // trigger callback
-                callback(gpio_num, gpio_state);
+#if !GPIO_INPUT_PORT_SCAN
+/**
+ * Samples all pins whose interrupt was masked by the storm protection and enables it again once they are quiet.
+ * Returns the time of the next sample or DEBOUNCE_FSM_NO_DEADLINE if no pin is polled.
+ */
+static int64_t poll_storm_inputs(void)
+{
+    int64_t next_poll = DEBOUNCE_FSM_NO_DEADLINE;
+    int64_t now = gpio_input_port_now_us();
 
-                // reset
-                gpio_helper->interrupt_cnt = 0;
-            }
+    for (int i = 0; i < gpio_count; ++i)
+    {
+        gpio_input_debounce_config_t *gpio_helper = &(internal_config[i]);
+        edge_storm_t *storm = &(gpio_helper->storm);
+        uint8_t level = gpio_input_port_get_level(gpio_helper->gpio_num);
 
-            if ( // no other interrupt was triggered (button still pressed)
-                gpio_helper->interrupt_cnt == 0 &&
-                // long enough for a long press
-                (xTaskGetTickCount() - gpio_helper->debounce_timeout > LONG_PRESS_TICKS) &&
-                // only trigger once
-                (xTaskGetTickCount() - gpio_helper->debounce_timeout < LONG_PRESS_TICKS + debounce_loop_delay_ticks))
-            {
-                ESP_LOGV(TAG, "long stable state on gpio %i in state %i", gpio_num, gpio_state);
+        if (edge_storm_begin_polling(storm, level, now))
+        {
+            ESP_LOGW(TAG, "gpio %i is too noisy, polling it until it is quiet", gpio_helper->gpio_num);
+            gpio_helper->stats.storms++;
+            gpio_helper->stats.storm_polling = true;
+            debounce_fsm_edge(&(gpio_helper->fsm), level, now);
+        }
+        if (!storm->polling)
+        {
+            continue;
+        }
 
-                // trigger callback
-                callback(gpio_num, gpio_state + 2);
+        if (edge_storm_poll(storm, level, now))
+        {
+            gpio_helper->stats.edges++;
+            debounce_fsm_edge(&(gpio_helper->fsm), level, now);
+        }
+        else if (edge_storm_is_quiet(storm, now))
+        {
+            ESP_LOGI(TAG, "gpio %i is quiet again", gpio_helper->gpio_num);
+            edge_storm_resume(storm, now);
+            gpio_helper->stats.storm_polling = false;
+            gpio_input_port_intr_enable(gpio_helper->gpio_num);
+            continue;
+        }
+        next_poll = now + EDGE_STORM_POLL_US;
+    }
+
+    return next_poll;
+}
+#endif
+
+#if GPIO_INPUT_PORT_SCAN
+static inline uint32_t read_port(void)
+{
+    return REG_READ(GPIO_IN_REG) & port_mask;
+}
+
+/**
+ * Takes one sample of all inputs and hands the debounced changes to the per-pin state machines.
+ */
+static void scan_inputs(void)
+{
+    uint32_t changed = vertical_debounce_sample(&port_debounce, read_port());
+    if (changed == 0)
+    {
+        return;
+    }
+
+    int64_t now = gpio_input_port_now_us();
+    while (changed != 0)
+    {
+        int bit = __builtin_ctz(changed);
+        changed &= changed - 1;
+
+        gpio_input_debounce_config_t *gpio_helper = &(internal_config[port_bit_to_index[bit]]);
+        gpio_helper->stats.edges++;
+        if (edge_callback != NULL)
+        {
+            // the port scan only sees debounced changes, they are reported at the time of the sample
+            edge_callback(gpio_helper->gpio_num, (port_debounce.state >> bit) & 1, now);
+        }
+        debounce_fsm_settled(&(gpio_helper->fsm), (port_debounce.state >> bit) & 1, now);
+    }
+}
+#endif
+
+static void record_detection(gpio_input_debounce_config_t *gpio_helper, int64_t now)
+{
+    // latency from the final edge of the burst to the callback
+    uint32_t latency_us = (uint32_t)(now - gpio_helper->fsm.last_edge_us);
+    gpio_helper->stats.events++;
+    gpio_helper->stats.last_latency_us = latency_us;
+    if (latency_us > gpio_helper->stats.max_latency_us)
+    {
+        gpio_helper->stats.max_latency_us = latency_us;
+    }
+}
+
+static void publish_snapshot(void)
+{
+    unsigned int generation = atomic_load_explicit(&snapshot_generation, memory_order_relaxed);
+    // keeps the buffer write after the previous publish, a reader still on that buffer sees the new generation
+    atomic_thread_fence(memory_order_release);
+    snapshot_levels[(generation + 1) & 1] = debounced_levels;
+    atomic_store_explicit(&snapshot_generation, generation + 1, memory_order_release);
+}
+
+/**
+ * Runs all state machines up to now, triggers callbacks and returns the earliest pending deadline.
+ */
+static int64_t process_inputs(void)
+{
+    int64_t next_deadline = DEBOUNCE_FSM_NO_DEADLINE;
+    int64_t now = gpio_input_port_now_us();
+    bool any_settling = false;
+    bool reported = false; /* a callback ran in this pass */
+
+    for (int i = 0; i < gpio_count; ++i)
+    {
+        gpio_input_debounce_config_t *gpio_helper = &(internal_config[i]);
+        gpio_input_state_t gpio_state;
+
+        while (debounce_fsm_update(&(gpio_helper->fsm), now, &gpio_state))
+        {
+            ESP_LOGD(TAG, "gpio %i is stable in state %i", gpio_helper->gpio_num, gpio_state);
+            if (gpio_state == ON || gpio_state == OFF)
+            {
+                record_detection(gpio_helper, now);
+                settle_pending = true;
+                if (gpio_state == ON)
+                {
+                    debounced_levels &= ~(1ULL << gpio_helper->gpio_num);
+                }
+                else
+                {
+                    debounced_levels |= (1ULL << gpio_helper->gpio_num);
+                }
             }
+            callback(gpio_helper->gpio_num, gpio_state);
+            reported = true;
+        }
+        gpio_helper->stats.glitches = gpio_helper->fsm.glitch_count;
+        any_settling |= gpio_helper->fsm.phase == DEBOUNCE_FSM_SETTLING;
+
+        int64_t deadline = debounce_fsm_next_deadline(&(gpio_helper->fsm));
+        if (deadline < next_deadline)
+        {
+            next_deadline = deadline;
+        }
+    }
+
+    if (debounced_levels != snapshot_levels[atomic_load_explicit(&snapshot_generation, memory_order_relaxed) & 1])
+    {
+        publish_snapshot();
+    }
+
+    if (settle_pending && !any_settling)
+    {
+        settle_pending = false;
+        if (settled_callback != NULL)
+        {
+            settled_callback();
         }
+    }
+
+    if (reported)
+    {
+        app_loop_log_stack("input pass");
+    }
+
+    if (tick_hook != NULL)
+    {
+        int64_t deadline = tick_hook(now);
+        if (deadline < next_deadline)
+        {
+            next_deadline = deadline;
+        }
+    }
+
+    return next_deadline;
+}
+
+/* runs on the app loop for edges, tick requests and the deadline timer */
+static void service_inputs(void)
+{
+#if GPIO_INPUT_PORT_SCAN
+    // deadlines are checked on every sample, the timer only keeps the sample period
+    if (!app_loop_timer_is_active(&deadline_timer))
+    {
+        scan_inputs();
+        app_loop_timer_start_once(&deadline_timer, GPIO_INPUT_PORT_SCAN_PERIOD_US);
+    }
+    process_inputs();
+#else
+    drain_edge_events();
+    int64_t next_poll = poll_storm_inputs();
+    int64_t next_deadline = process_inputs();
+    if (next_poll < next_deadline)
+    {
+        next_deadline = next_poll;
+    }
 
-        vTaskDelay(debounce_loop_delay_ticks);
+    if (next_deadline != DEBOUNCE_FSM_NO_DEADLINE)
+    {
+        app_loop_timer_start_at(&deadline_timer, next_deadline);
     }
+    else
+    {
+        app_loop_timer_stop(&deadline_timer);
+    }
+#endif
 }
 
-static esp_err_t configure_gpio_inputs(const int gpio_nums[])
+static void deadline_timer_callback(void *arg)
+{
+    (void)arg;
+    service_inputs();
+}
+
+static esp_err_t configure_gpio_inputs(void)
 {
     gpio_config_t io_conf = {};
     uint64_t pin_bit_mask = 0;
@@ -77,10 +347,15 @@ static esp_err_t configure_gpio_inputs(const int gpio_nums[])
     /* construct bitmask to configure potentially multiple gpios */
     for (int i = 0; i < gpio_count; ++i)
     {
-        pin_bit_mask |= (1ULL << gpio_nums[i]);
+        pin_bit_mask |= (1ULL << pin_map[i].gpio_num);
     }
+#if GPIO_INPUT_PORT_SCAN || GPIO_INPUT_SLEEP_WAKEUP
+    /* inputs are sampled, or level interrupts are armed once the handlers are installed */
+    io_conf.intr_type = GPIO_INTR_DISABLE;
+#else
     /* interrupt on all edges */
     io_conf.intr_type = GPIO_INTR_ANYEDGE;
+#endif
     io_conf.pin_bit_mask = pin_bit_mask;
     io_conf.mode = GPIO_MODE_INPUT;
     io_conf.pull_down_en = 0;
@@ -92,71 +367,136 @@ static esp_err_t configure_gpio_inputs(const int gpio_nums[])
     return ESP_OK;
 }
 
-static void clean_up()
+esp_err_t gpio_debounce_input_init(debounced_input_callback cb)
 {
-    if (gpio_count > 0)
-    {
-        // free previously allocated memory
-        free(internal_config);
-    }
-    if (loop_task_handle != NULL)
-    {
-        // remove previously started task
-        vTaskDelete(loop_task_handle);
-    }
-}
-
-esp_err_t gpio_debounce_input_init(const int gpio_debounce_inputs[], int number_of_inputs, debounced_input_callback cb)
-{
-    clean_up();
+    // state is static and interrupts may already reference it, so there is no re-initialization
+    ESP_RETURN_ON_FALSE(!inputs_initialized, ESP_ERR_INVALID_STATE, TAG, "Inputs are already initialized");
 
     callback = cb;
-    gpio_count = number_of_inputs;
-    // allocate memory for configuration
-    ESP_LOGI(TAG, "Allocating %i bytes of memory (size: %i, times: %i)", sizeof(gpio_input_debounce_config_t) * gpio_count, sizeof(gpio_input_debounce_config_t), gpio_count);
-    internal_config = malloc(sizeof(gpio_input_debounce_config_t) * gpio_count);
+    ESP_LOGI(TAG, "Configuring %i pins for input", gpio_count);
 
-    ESP_RETURN_ON_ERROR(configure_gpio_inputs(gpio_debounce_inputs), TAG, "Cannot configure GPIOs");
-
-    xTaskCreate(debounce_gpio_input_loop_task, "gpio_input_debounce", 4096, NULL, 10, &loop_task_handle);
-
-    ESP_RETURN_ON_ERROR(gpio_install_isr_service(ESP_INTR_FLAG_DEFAULT), TAG, "Cannot install ISR service.");
+    ESP_RETURN_ON_ERROR(configure_gpio_inputs(), TAG, "Cannot configure GPIOs");
 
+    int64_t now = gpio_input_port_now_us();
     for (int i = 0; i < gpio_count; i++)
     {
-        // Add gpio isr handlers with
-        int gpio_num = gpio_debounce_inputs[i];
+        int gpio_num = pin_map[i].gpio_num;
         internal_config[i].gpio_num = gpio_num;
-        internal_config[i].debounce_timeout = 0;
-        internal_config[i].last_state = gpio_get_level(gpio_num);
-        internal_config[i].interrupt_cnt = 0;
+        debounce_fsm_init(&(internal_config[i].fsm), &(pin_map[i].profile), gpio_input_port_get_level(gpio_num), now);
+        internal_config[i].stats = (gpio_input_stats_t){0};
+        edge_storm_init(&(internal_config[i].storm), now);
+        if (internal_config[i].fsm.stable_level)
+        {
+            debounced_levels |= (1ULL << gpio_num);
+        }
+    }
+    // the initial levels are only published, no callbacks are triggered for them
+    publish_snapshot();
+
+    edge_ring_init(&edge_ring);
+    seen_overflow_count = 0;
 
-        // trigger callback with initial value
-        // if you think about enableing this, take a look at the gpio_read_once() function
-        // callback(gpio_num, internal_config[i].last_state);
+    ESP_RETURN_ON_FALSE(app_loop_task_handle != NULL, ESP_ERR_INVALID_STATE, TAG, "The app loop has to run before the inputs");
+    app_loop_timer_init(&deadline_timer, deadline_timer_callback, NULL);
+    // the handler must be set before the first interrupt can raise the signal
+    app_loop_set_signal_handler(APP_LOOP_SIGNAL_INPUTS, service_inputs);
+    inputs_initialized = true;
 
+#if GPIO_INPUT_PORT_SCAN
+    port_mask = 0;
+    for (int i = 0; i < gpio_count; i++)
+    {
+        int gpio_num = internal_config[i].gpio_num;
+        ESP_RETURN_ON_FALSE(gpio_num < 32, ESP_ERR_INVALID_ARG, TAG, "gpio %i can't be port scanned", gpio_num);
+        port_mask |= (1UL << gpio_num);
+        port_bit_to_index[gpio_num] = i;
+    }
+    vertical_debounce_init(&port_debounce, read_port());
+    app_loop_timer_start_once(&deadline_timer, GPIO_INPUT_PORT_SCAN_PERIOD_US);
+#else
+    ESP_RETURN_ON_ERROR(gpio_install_isr_service(GPIO_INPUT_INTR_FLAGS), TAG, "Cannot install ISR service.");
+
+    for (int i = 0; i < gpio_count; i++)
+    {
+        // Add gpio isr handlers with
+        int gpio_num = internal_config[i].gpio_num;
         ESP_RETURN_ON_ERROR(
             gpio_isr_handler_add(gpio_num, gpio_interrupt_handler, (void *)&(internal_config[i])),
             TAG,
             "Cannot add isr handler for gpio %i", gpio_num);
+#if GPIO_INPUT_SLEEP_WAKEUP
+        // sets the level interrupt type and marks the pin as wakeup source
+        int level = gpio_input_port_get_level(gpio_num);
+        ESP_RETURN_ON_ERROR(gpio_wakeup_enable(gpio_num, level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL), TAG,
+                            "Cannot enable wakeup for gpio %i", gpio_num);
+        ESP_RETURN_ON_ERROR(gpio_intr_enable(gpio_num), TAG, "Cannot enable interrupt for gpio %i", gpio_num);
+#endif
     }
+#if GPIO_INPUT_SLEEP_WAKEUP
+    ESP_RETURN_ON_ERROR(esp_sleep_enable_gpio_wakeup(), TAG, "Cannot enable gpio wakeup");
+#endif
+#endif
 
     return ESP_OK;
 }
 
-/**
- * Reads all configured inputs once and triggers a callback on each.
- * The value in the callback is poentially a snapshot that needs debouncing.
- */
-void gpio_read_once()
+void gpio_input_get_snapshot(gpio_input_snapshot_t *snapshot)
+{
+    unsigned int generation = atomic_load_explicit(&snapshot_generation, memory_order_acquire);
+    for (;;)
+    {
+        snapshot->levels = snapshot_levels[generation & 1];
+        // the app loop only writes the buffer that isn't published, retry if it published meanwhile.
+        // The fence keeps the 64 bit read, two loads on this chip, before the check.
+        atomic_thread_fence(memory_order_acquire);
+        unsigned int check = atomic_load_explicit(&snapshot_generation, memory_order_relaxed);
+        if (check == generation)
+        {
+            break;
+        }
+        generation = check;
+    }
+    snapshot->generation = generation;
+}
+
+void gpio_input_set_tick_hook(gpio_input_tick_hook hook)
+{
+    tick_hook = hook;
+}
+
+esp_err_t gpio_input_get_stats(int gpio_num, gpio_input_stats_t *stats)
 {
     for (int i = 0; i < gpio_count; i++)
     {
-        // Add gpio isr handlers with
-        int gpio_num = internal_config[i].gpio_num;
-        gpio_input_state_t last_state = gpio_get_level(gpio_num);
+        if (internal_config[i].gpio_num == gpio_num)
+        {
+            // fields are updated by the app loop, each one is read atomically
+            *stats = internal_config[i].stats;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
 
-        // trigger callback with initial value
-        callback(gpio_num, last_state);
+void gpio_input_request_tick()
+{
+    if (inputs_initialized)
+    {
+        app_loop_signal(APP_LOOP_SIGNAL_INPUTS);
     }
 }
+
+void gpio_input_set_settled_callback(gpio_input_settled_callback cb)
+{
+    settled_callback = cb;
+}
+
+void gpio_input_set_edge_callback(gpio_input_edge_callback cb)
+{
+    edge_callback = cb;
+}
+
+uint32_t gpio_input_get_edge_overflow_count()
+{
+    return edge_ring_overflow_count(&edge_ring);
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "driver/gpio.h"
+#include "debounce_fsm.h"
+#include "edge_storm.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -10,32 +12,117 @@ extern "C"
 #define CONFIG_FREERTOS_HZ 100     /* see sdkconfig, default is 100 */
 #define CONFIG_LOG_MAXIMUM_LEVEL 3 /* maximum log verbosity, default is 3 */
 
-#define ESP_INTR_FLAG_DEFAULT 0
+/* the gpio ISR service and gpio_interrupt_handler stay active while the flash cache is disabled */
+#define GPIO_INPUT_INTR_FLAGS ESP_INTR_FLAG_IRAM
+
+/* Set to 1 to sample all inputs as one word from a periodic app loop timer and debounce them bit-parallel
+ * instead of registering one interrupt per pin. The per-pin debounce_us is not used in this mode,
+ * a level is accepted after VERTICAL_DEBOUNCE_SAMPLES equal samples. Inputs must be below GPIO 32. */
+#ifndef GPIO_INPUT_PORT_SCAN
+#define GPIO_INPUT_PORT_SCAN 0
+#endif
+#define GPIO_INPUT_PORT_SCAN_PERIOD_US (5 * 1000)
+
+/* Inputs wake the chip from light sleep, on by default when automatic light sleep is configured.
+ * Light sleep only wakes up on levels, so every pin waits for the level opposite to its current one
+ * and the ISR re-arms it after every edge. Debounce deadlines are app loop timers, whose esp_timer wakes the chip as well. */
+#ifndef GPIO_INPUT_SLEEP_WAKEUP
+#if defined(CONFIG_PM_ENABLE) && defined(CONFIG_FREERTOS_USE_TICKLESS_IDLE)
+#define GPIO_INPUT_SLEEP_WAKEUP 1
+#else
+#define GPIO_INPUT_SLEEP_WAKEUP 0
+#endif
+#endif
+#if GPIO_INPUT_SLEEP_WAKEUP && GPIO_INPUT_PORT_SCAN
+#error "the periodic port scan keeps the chip awake, light sleep needs the interrupt driven inputs"
+#endif
+
+/* stack the input path takes on the app loop, which replaced its debounce task: draining edges, debouncing and the
+ * input callbacks, which log (a printing ESP-IDF task needs about 2 KB). The loop stack is checked against it at
+ * compile time, the free stack is logged after every pass that reported a state, see app_loop_log_stack() */
+#ifndef GPIO_INPUT_STACK_SIZE
+#define GPIO_INPUT_STACK_SIZE 2048
+#endif
 
 #define COUNT_ARRAY_ELEMENTS(ARRAY_TYPE) (sizeof(ARRAY_TYPE) / sizeof(ARRAY_TYPE[0]))
-#define DEBOUNCE_TICKS 25
-#define LONG_PRESS_TICKS 400
 
-    typedef enum gpio_input_state_enum
-    {
-        ON = 0,
-        OFF = 1,
-        ON_LONG = 2,
-        OFF_LONG = 3
-    } gpio_input_state_t;
+/* timing profile for mechanical buttons */
+#define GPIO_INPUT_PROFILE_BUTTON() \
+    {                               \
+        .debounce_us = 30 * 1000,   \
+        .long_press_us = 2000000,   \
+        .repeat_us = 0,             \
+    }
+
+/* timing profile for the previous global defaults (25 / 400 ticks) */
+#define GPIO_INPUT_PROFILE_DEFAULT() \
+    {                                \
+        .debounce_us = 250 * 1000,   \
+        .long_press_us = 4000000,    \
+        .repeat_us = 0,              \
+    }
 
     typedef void (*debounced_input_callback)(int gpio_num, gpio_input_state_t value);
+    /* runs on the app loop after every pass over the inputs, returns the next time (esp_timer_get_time) it needs to run or INT64_MAX */
+    typedef int64_t (*gpio_input_tick_hook)(int64_t now_us);
+    /* runs on the app loop once no input is settling anymore after one or more ON / OFF states were reported */
+    typedef void (*gpio_input_settled_callback)(void);
+    /* runs on the app loop for every raw edge before it is debounced, timestamp is taken in the ISR */
+    typedef void (*gpio_input_edge_callback)(int gpio_num, uint8_t level, int64_t timestamp_us);
+
+    typedef struct gpio_input_pin_config_t
+    {
+        gpio_num_t gpio_num;
+        gpio_input_timing_profile_t profile;
+    } gpio_input_pin_config_t;
+
+    /** per-pin counters to judge debounce quality */
+    typedef struct gpio_input_stats_t
+    {
+        uint32_t edges;           /* edges seen (changes accepted by the port scan in port scan mode) */
+        uint32_t events;          /* debounced ON / OFF states reported */
+        uint32_t glitches;        /* edge bursts that settled back to the reported level */
+        uint32_t last_latency_us; /* final edge to callback of the last reported state */
+        uint32_t max_latency_us;
+        uint32_t storms;          /* times the interrupt was masked because of too many edges */
+        bool storm_polling;       /* the pin is currently polled instead of interrupt driven */
+    } gpio_input_stats_t;
+
+    /** last debounced level of all inputs */
+    typedef struct gpio_input_snapshot_t
+    {
+        uint32_t generation; /* incremented whenever one or more debounced levels changed */
+        uint64_t levels;     /* bit n is the level of gpio n */
+    } gpio_input_snapshot_t;
+
+    static inline gpio_input_state_t gpio_input_snapshot_state(const gpio_input_snapshot_t *snapshot, int gpio_num)
+    {
+        return (snapshot->levels >> gpio_num) & 1 ? OFF : ON;
+    }
 
     typedef struct gpio_input_debounce_config_t
     {
         gpio_num_t gpio_num;
-        bool last_state;
-        uint32_t interrupt_cnt;
-        uint32_t debounce_timeout;
+        debounce_fsm_t fsm;
+        gpio_input_stats_t stats;
+        edge_storm_t storm;
     } gpio_input_debounce_config_t;
 
-    esp_err_t gpio_debounce_input_init(const int gpio_debounce_inputs[], int number_of_inputs, debounced_input_callback cb);
-    void gpio_read_once();
+    /* configures the inputs of GPIO_INPUT_PINS (input_pins.h), can only be called once after app_loop_init */
+    esp_err_t gpio_debounce_input_init(debounced_input_callback cb);
+    /* consistent copy of the debounced levels, safe to call from any task once the inputs are initialized */
+    void gpio_input_get_snapshot(gpio_input_snapshot_t *snapshot);
+    /* lets layers on top of the inputs (e.g. gestures) run their timing on the app loop, set before init */
+    void gpio_input_set_tick_hook(gpio_input_tick_hook hook);
+    /* runs the inputs (and with them the tick hook) on the app loop as soon as possible, e.g. after the hook got new work */
+    void gpio_input_request_tick();
+    /* lets the application apply the combined result of changes that happen together, set before init */
+    void gpio_input_set_settled_callback(gpio_input_settled_callback cb);
+    /* lets the application observe raw edges, e.g. for latency measurements, set before init */
+    void gpio_input_set_edge_callback(gpio_input_edge_callback cb);
+    esp_err_t gpio_input_get_stats(int gpio_num, gpio_input_stats_t *stats);
+    /* number of edges dropped because the app loop couldn't keep up with the interrupt handler */
+    uint32_t gpio_input_get_edge_overflow_count();
 #ifdef __cplusplus
 } // extern "C"
 #endif
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+/*
+ * Thin shim between the input driver and the hardware.
+ * Everything gpio_input.c needs from the chip goes through here, so the driver logic can be
+ * built on the host against simulated registers and replay edge traces (test/host/input_replay.c).
+ */
+
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "hal/gpio_ll.h"
+#include "soc/gpio_struct.h"
+
+/* The functions used by the ISR are forced inline and only touch registers,
+ * so the ISR keeps running from IRAM while the flash cache is disabled (OTA writes). */
+
+FORCE_INLINE_ATTR int gpio_input_port_get_level(gpio_num_t gpio_num)
+{
+    return gpio_ll_get_level(&GPIO, gpio_num);
+}
+
+/* esp_timer_get_time() is placed in IRAM by ESP-IDF and reads the systimer directly */
+FORCE_INLINE_ATTR int64_t gpio_input_port_now_us(void)
+{
+    return esp_timer_get_time();
+}
+
+static inline void gpio_input_port_intr_enable(gpio_num_t gpio_num)
+{
+    gpio_intr_enable(gpio_num);
+}
+
+/* ISR safe, waits for the level opposite to @p level. Light sleep only wakes up on levels,
+ * so with GPIO_INPUT_SLEEP_WAKEUP the pins use level interrupts that are flipped after every edge. */
+FORCE_INLINE_ATTR void gpio_input_port_arm_level(gpio_num_t gpio_num, int level)
+{
+    gpio_ll_set_intr_type(&GPIO, gpio_num, level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+}
+
+/* ISR safe, masks the pin in its register without going through the driver */
+FORCE_INLINE_ATTR void gpio_input_port_intr_disable(gpio_num_t gpio_num)
+{
+    gpio_ll_intr_disable(&GPIO, gpio_num);
+}
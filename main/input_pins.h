@@ -0,0 +1,38 @@
+#pragma once
+
+/*
+ * Declarative map of all debounced inputs, expanded by gpio_input.c into statically sized tables.
+ * One X(gpio_num, timing_profile) entry per input, the order defines the internal input index.
+ */
+
+#include "gpio_input.h"
+#include "usb_switch_channels.h"
+
+/* the switch LEDs are driven cleanly through the optocouplers, a short debounce is enough */
+#define GPIO_INPUT_PROFILE_LED_SENSE() \
+    {                                  \
+        .debounce_us = 50 * 1000,      \
+        .long_press_us = 4000000,      \
+        .repeat_us = 0,                \
+    }
+
+// Note: On my board GPIO_NUM_21 is soldered as input to the external button.
+// That experiment didn't work out but I'm too lazy to desolder the IC...
+// You don't need to configure GPIO_NUM_21 if it is not connected.
+#define GPIO_INPUT_PINS(X)                                 \
+    X(GPIO_NUM_9, GPIO_INPUT_PROFILE_BUTTON())             \
+    GPIO_INPUT_LED_PINS(X)                                 \
+    X(GPIO_NUM_21, GPIO_INPUT_PROFILE_DEFAULT())
+
+/* one LED sense input per channel */
+#if USB_SWITCH_CHANNELS == 2
+#define GPIO_INPUT_LED_PINS(X)                             \
+    X(USB_SWITCH_LED_CH_1, GPIO_INPUT_PROFILE_LED_SENSE()) \
+    X(USB_SWITCH_LED_CH_2, GPIO_INPUT_PROFILE_LED_SENSE())
+#elif USB_SWITCH_CHANNELS == 4
+#define GPIO_INPUT_LED_PINS(X)                             \
+    X(USB_SWITCH_LED_CH_1, GPIO_INPUT_PROFILE_LED_SENSE()) \
+    X(USB_SWITCH_LED_CH_2, GPIO_INPUT_PROFILE_LED_SENSE()) \
+    X(USB_SWITCH_LED_CH_3, GPIO_INPUT_PROFILE_LED_SENSE()) \
+    X(USB_SWITCH_LED_CH_4, GPIO_INPUT_PROFILE_LED_SENSE())
+#endif
@@ -0,0 +1,61 @@
+#include "latency_hist.h"
+
+void latency_hist_reset(latency_hist_t *hist)
+{
+    for (int i = 0; i < LATENCY_HIST_BUCKETS; ++i)
+    {
+        atomic_store_explicit(&hist->buckets[i], 0, memory_order_relaxed);
+    }
+}
+
+uint8_t latency_hist_bucket(uint32_t latency_us)
+{
+    if (latency_us < 2)
+    {
+        return 0;
+    }
+    uint8_t bucket = 31 - __builtin_clz(latency_us);
+    return bucket < LATENCY_HIST_BUCKETS ? bucket : LATENCY_HIST_BUCKETS - 1;
+}
+
+void latency_hist_record(latency_hist_t *hist, uint32_t latency_us)
+{
+    atomic_fetch_add_explicit(&hist->buckets[latency_hist_bucket(latency_us)], 1, memory_order_relaxed);
+}
+
+uint32_t latency_hist_count(const latency_hist_t *hist)
+{
+    uint32_t count = 0;
+    for (int i = 0; i < LATENCY_HIST_BUCKETS; ++i)
+    {
+        count += atomic_load_explicit(&hist->buckets[i], memory_order_relaxed);
+    }
+    return count;
+}
+
+uint32_t latency_hist_percentile(const latency_hist_t *hist, uint8_t percent)
+{
+    uint32_t count = latency_hist_count(hist);
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    // rank of the percentile, rounded up so p99 of a few samples is the slowest one
+    uint64_t rank = ((uint64_t)count * percent + 99) / 100;
+    if (rank == 0)
+    {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_HIST_BUCKETS; ++i)
+    {
+        seen += atomic_load_explicit(&hist->buckets[i], memory_order_relaxed);
+        if (seen >= rank)
+        {
+            return 1UL << (i + 1);
+        }
+    }
+    // buckets changed while they were summed up
+    return 1UL << LATENCY_HIST_BUCKETS;
+}
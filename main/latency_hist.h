@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* bucket n counts latencies in [2^n, 2^(n+1)) us (bucket 0 also counts 0), the last one everything from ~8 s */
+#define LATENCY_HIST_BUCKETS 24
+
+    /**
+     * Fixed size log2 histogram of latencies in microseconds.
+     * Recording is lock free and can happen from any task, nothing is allocated.
+     */
+    typedef struct latency_hist_t
+    {
+        _Atomic uint32_t buckets[LATENCY_HIST_BUCKETS];
+    } latency_hist_t;
+
+    void latency_hist_reset(latency_hist_t *hist);
+
+    void latency_hist_record(latency_hist_t *hist, uint32_t latency_us);
+
+    /**
+     * @brief Bucket @p latency_us is counted in.
+     */
+    uint8_t latency_hist_bucket(uint32_t latency_us);
+
+    /**
+     * @brief Number of recorded latencies.
+     */
+    uint32_t latency_hist_count(const latency_hist_t *hist);
+
+    /**
+     * @brief Upper bound of the bucket that contains the @p percent percentile, 0 if nothing was recorded.
+     */
+    uint32_t latency_hist_percentile(const latency_hist_t *hist, uint8_t percent);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
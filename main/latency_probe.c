@@ -0,0 +1,68 @@
+#include "latency_probe.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "esp_log.h"
+
+static const char *TAG = "LATENCY";
+
+#define LATENCY_PROBE_LABEL(name, label) label,
+static const char *const stage_labels[LATENCY_PROBE_STAGE_COUNT] = {LATENCY_PROBE_STAGES(LATENCY_PROBE_LABEL)};
+#undef LATENCY_PROBE_LABEL
+
+static latency_hist_t stage_hists[LATENCY_PROBE_STAGE_COUNT];
+/* 32 bit microseconds are enough for differences and keep the probes lock free */
+static _Atomic uint32_t trace_start_us;
+/* stages the running trace didn't reach yet, 0 when no trace is running */
+static _Atomic uint32_t trace_pending;
+
+void latency_probe_start(int64_t now_us)
+{
+    atomic_store_explicit(&trace_start_us, (uint32_t)now_us, memory_order_relaxed);
+    atomic_store_explicit(&trace_pending, (1UL << LATENCY_PROBE_STAGE_COUNT) - 1, memory_order_release);
+}
+
+void latency_probe_mark(latency_probe_stage_t stage, int64_t now_us)
+{
+    uint32_t bit = 1UL << stage;
+    if ((atomic_fetch_and_explicit(&trace_pending, ~bit, memory_order_acquire) & bit) == 0)
+    {
+        return;
+    }
+
+    uint32_t latency_us = (uint32_t)now_us - atomic_load_explicit(&trace_start_us, memory_order_relaxed);
+    if (latency_us > LATENCY_PROBE_MAX_US)
+    {
+        atomic_store_explicit(&trace_pending, 0, memory_order_relaxed);
+        return;
+    }
+    latency_hist_record(&stage_hists[stage], latency_us);
+    if (stage == LATENCY_PROBE_STAGE_COUNT - 1)
+    {
+        atomic_store_explicit(&trace_pending, 0, memory_order_relaxed);
+    }
+}
+
+const latency_hist_t *latency_probe_hist(latency_probe_stage_t stage)
+{
+    return &stage_hists[stage];
+}
+
+void latency_probe_dump(void)
+{
+    for (int i = 0; i < LATENCY_PROBE_STAGE_COUNT; ++i)
+    {
+        const latency_hist_t *hist = &stage_hists[i];
+        char buckets[LATENCY_HIST_BUCKETS * 11 + 1];
+        int len = 0;
+        for (int b = 0; b < LATENCY_HIST_BUCKETS; ++b)
+        {
+            len += snprintf(buckets + len, sizeof(buckets) - len, " %lu",
+                            (unsigned long)atomic_load_explicit(&hist->buckets[b], memory_order_relaxed));
+        }
+        ESP_LOGI(TAG, "%-14s n=%lu p50<%lu us p99<%lu us buckets:%s", stage_labels[i],
+                 (unsigned long)latency_hist_count(hist), (unsigned long)latency_hist_percentile(hist, 50),
+                 (unsigned long)latency_hist_percentile(hist, 99), buckets);
+    }
+}
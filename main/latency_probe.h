@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "latency_hist.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* stages of a remote channel change, each one is measured from the received PresentValue write: X(name, label) */
+#define LATENCY_PROBE_STAGES(X)            \
+    X(PULSE_START, "pulse start")          \
+    X(PULSE_END, "pulse end")              \
+    X(FIRST_EDGE, "first LED edge")        \
+    X(DEBOUNCED, "LED debounced")          \
+    X(ATTRIBUTE_SET, "attribute set")      \
+    X(REPORT_SENT, "report sent")
+
+/* traces that take longer than this are dropped, the switch didn't react or the write changed nothing */
+#define LATENCY_PROBE_MAX_US (10 * 1000 * 1000)
+
+    typedef enum latency_probe_stage_enum
+    {
+#define LATENCY_PROBE_ENUM(name, label) LATENCY_PROBE_##name,
+        LATENCY_PROBE_STAGES(LATENCY_PROBE_ENUM)
+#undef LATENCY_PROBE_ENUM
+            LATENCY_PROBE_STAGE_COUNT
+    } latency_probe_stage_t;
+
+    /**
+     * @brief Start a trace, a PresentValue write was received at @p now_us.
+     */
+    void latency_probe_start(int64_t now_us);
+
+    /**
+     * @brief Record the first time the running trace reaches @p stage. Lock free, callable from any task.
+     */
+    void latency_probe_mark(latency_probe_stage_t stage, int64_t now_us);
+
+    /**
+     * @brief Histogram of the time from the write to @p stage.
+     */
+    const latency_hist_t *latency_probe_hist(latency_probe_stage_t stage);
+
+    /**
+     * @brief Log count, p50, p99 and the buckets of every stage.
+     */
+    void latency_probe_dump(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -1,13 +1,15 @@
 #include "ota.h"
 
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_ota_ops.h"
 #include "esp_system.h"
 #include "esp_zigbee_ota.h"
 #include "zcl/esp_zigbee_zcl_ota.h"
 #include "zigbee_usb_switch.h"
+#include "diag_counters.h"
+#include "tlog.h"
+#include "zb_cmd_queue.h"
+#include "app_loop.h"
 
 static const char *TAG = "OTA";
 
@@ -102,8 +104,11 @@ static const char *ota_status_to_str(esp_zb_zcl_ota_upgrade_status_t status)
 /* Zigbee OTA sub-element header: 2-byte tag + 4-byte length (Zigbee spec 11.4.2) */
 #define OTA_ELEMENT_HEADER_LEN 6
 #define OTA_ELEMENT_TAG_UPGRADE_IMAGE 0x0000
+/* delay between FINISH and the restart, lets the stack send the upgrade end response */
+#define OTA_REBOOT_DELAY_US (500 * 1000)
 
 static bool s_ota_reboot_scheduled = false;
+static app_loop_timer_t s_ota_reboot_timer;
 static esp_ota_handle_t s_ota_handle = 0;
 static const esp_partition_t *s_ota_update_partition = NULL;
 static uint32_t s_ota_total_size = 0;
@@ -157,16 +162,13 @@ static void ota_log_boot_selection(const char *prefix)
     ota_log_partition_details("  ota_1", ota_1);
 }
 
-static void ota_finish_reboot_task(void *arg)
+/* app loop timer started on FINISH */
+static void ota_finish_reboot_callback(void *arg)
 {
     (void)arg;
-    ESP_LOGI(TAG, "finish: rebooting in 500 ms");
     ota_log_boot_selection("boot selection before restart");
-    vTaskDelay(pdMS_TO_TICKS(500));
+    app_loop_log_stack("OTA finish");
     esp_restart();
-
-    /* esp_restart() should not return, but keep task contract explicit. */
-    vTaskDelete(NULL);
 }
 
 /* --- Public API -------------------------------------------------------------*/
@@ -191,11 +193,10 @@ void ota_log_partition_state(const char *prefix)
              prefix, running->label, running->subtype, ota_img_state_to_str(state));
 }
 
-void ota_configure_query_interval(uint8_t endpoint)
+/* zigbee task, posted by ota_configure_query_interval */
+static void ota_query_interval_handler(uint32_t endpoint)
 {
-    esp_zb_lock_acquire(portMAX_DELAY);
     esp_err_t err = esp_zb_ota_upgrade_client_query_interval_set(endpoint, ESP_OTA_QUERY_INTERVAL_MIN);
-    esp_zb_lock_release();
     if (err != ESP_OK)
     {
         ESP_LOGW(TAG, "failed to set OTA query interval: %s", esp_err_to_name(err));
@@ -206,6 +207,11 @@ void ota_configure_query_interval(uint8_t endpoint)
     }
 }
 
+void ota_configure_query_interval(uint8_t endpoint)
+{
+    zb_cmd_queue_post(ota_query_interval_handler, endpoint);
+}
+
 void ota_confirm_image_if_pending(void)
 {
     ota_log_boot_selection("boot selection at confirm");
@@ -299,12 +305,15 @@ void ota_handle_upgrade_value(const void *message)
     const esp_zb_zcl_ota_upgrade_value_message_t *msg =
         (const esp_zb_zcl_ota_upgrade_value_message_t *)message;
 
-    ESP_LOGI(TAG, "status=%s (0x%04x) version=0x%08lx image_type=0x%04x payload=%u B",
-             ota_status_to_str(msg->upgrade_status),
-             msg->upgrade_status,
-             (unsigned long)msg->ota_header.file_version,
-             msg->ota_header.image_type,
-             (unsigned int)msg->payload_size);
+    // called for every block, the status name is only logged when it changes
+    static int last_status = -1;
+    if (msg->upgrade_status != last_status)
+    {
+        ESP_LOGI(TAG, "status=%s", ota_status_to_str(msg->upgrade_status));
+        last_status = msg->upgrade_status;
+    }
+    TLOGD(OTA_UPGRADE_VALUE, msg->upgrade_status, (unsigned long)msg->ota_header.file_version, msg->ota_header.image_type,
+          (unsigned int)msg->payload_size);
 
     switch (msg->upgrade_status)
     {
@@ -347,6 +356,7 @@ void ota_handle_upgrade_value(const void *message)
             }
 
             s_ota_offset += msg->payload_size;
+            diag_counter_add(DIAG_OTA_BYTES, msg->payload_size);
 
             void *write_buf = NULL;
             uint16_t write_len = 0;
@@ -425,16 +435,9 @@ void ota_handle_upgrade_value(const void *message)
         if (!s_ota_reboot_scheduled)
         {
             s_ota_reboot_scheduled = true;
-            BaseType_t ret = xTaskCreate(ota_finish_reboot_task, "ota_reboot", 2048, NULL, 5, NULL);
-            if (ret != pdPASS)
-            {
-                ESP_LOGE(TAG, "failed to create reboot task");
-                s_ota_reboot_scheduled = false;
-            }
-            else
-            {
-                ESP_LOGI(TAG, "reboot task scheduled");
-            }
+            app_loop_timer_init(&s_ota_reboot_timer, ota_finish_reboot_callback, NULL);
+            app_loop_timer_start_once(&s_ota_reboot_timer, OTA_REBOOT_DELAY_US);
+            ESP_LOGI(TAG, "finish: rebooting in %lu ms", (unsigned long)(OTA_REBOOT_DELAY_US / 1000));
         }
         break;
 
@@ -448,6 +451,7 @@ void ota_handle_upgrade_value(const void *message)
         s_ota_offset = 0;
         s_ota_total_size = 0;
         s_ota_element_header_received = false;
+        diag_counter_add(DIAG_OTA_ABORTS, 1);
         ESP_LOGW(TAG, "OTA aborted");
         break;
 
@@ -12,7 +12,7 @@ void ota_log_partition_state(const char *prefix);
 
 /**
  * @brief Set the OTA query interval on the device's Zigbee endpoint.
- *        Call this after joining or rejoining the network.
+ *        Call this after joining or rejoining the network, the update runs later on the zigbee task.
  *
  * @param endpoint  Zigbee endpoint ID that hosts the OTA upgrade client cluster.
  */
@@ -27,7 +27,7 @@ void ota_confirm_image_if_pending(void);
 
 /**
  * @brief Handle the ESP_ZB_CORE_OTA_UPGRADE_VALUE_CB_ID action callback.
- *        Logs the status and, on FINISH, schedules the reboot task.
+ *        Logs the status and, on FINISH, schedules the reboot on the app loop.
  *
  * @param message  Pointer to esp_zb_zcl_ota_upgrade_value_message_t.
  */
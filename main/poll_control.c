@@ -0,0 +1,212 @@
+#include "poll_control.h"
+
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "poll_policy.h"
+
+static const char *TAG = "POLL_CONTROL";
+
+#define QS_TO_MS(qs) ((uint32_t)(qs) * 250)
+
+/* client to server commands */
+#define POLL_CONTROL_CMD_CHECK_IN 0x00 /* server to client */
+#define POLL_CONTROL_CMD_CHECK_IN_RESPONSE 0x00
+#define POLL_CONTROL_CMD_FAST_POLL_STOP 0x01
+#define POLL_CONTROL_CMD_SET_LONG_POLL_INTERVAL 0x02
+#define POLL_CONTROL_CMD_SET_SHORT_POLL_INTERVAL 0x03
+
+/* only accessed with the zigbee lock held */
+static poll_policy_t poll_policy;
+static uint8_t poll_endpoint;
+static bool poll_started = false;
+
+esp_err_t poll_control_add_cluster(esp_zb_cluster_list_t *cluster_list)
+{
+    esp_zb_poll_control_cluster_cfg_t poll_cfg = {
+        .check_in_interval = POLL_CONTROL_CHECK_IN_INTERVAL_QS,
+        .long_poll_interval = POLL_CONTROL_LONG_POLL_INTERVAL_QS,
+        .short_poll_interval = POLL_CONTROL_SHORT_POLL_INTERVAL_QS,
+        .fast_poll_timeout = POLL_CONTROL_FAST_POLL_TIMEOUT_QS,
+        .check_in_interval_min = POLL_CONTROL_CHECK_IN_INTERVAL_MIN_QS,
+        .long_poll_interval_min = POLL_CONTROL_LONG_POLL_INTERVAL_MIN_QS,
+        .fast_poll_timeout_max = POLL_CONTROL_FAST_POLL_TIMEOUT_MAX_QS,
+    };
+    esp_zb_attribute_list_t *poll_cluster = esp_zb_poll_control_cluster_create(&poll_cfg);
+    ESP_RETURN_ON_FALSE(poll_cluster, ESP_ERR_NO_MEM, TAG, "Failed to create poll control cluster");
+    return esp_zb_cluster_list_add_poll_control_cluster(cluster_list, poll_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+}
+
+static void send_check_in(void)
+{
+    esp_zb_zcl_custom_cluster_cmd_req_t check_in = {
+        .zcl_basic_cmd.src_endpoint = poll_endpoint,
+        .address_mode = ESP_ZB_APS_ADDR_MODE_DST_ADDR_ENDP_NOT_PRESENT,
+        .profile_id = ESP_ZB_AF_HA_PROFILE_ID,
+        .cluster_id = ESP_ZB_ZCL_CLUSTER_ID_POLL_CONTROL,
+        .direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_CLI,
+        .custom_cmd_id = POLL_CONTROL_CMD_CHECK_IN,
+        .data = {
+            .type = ESP_ZB_ZCL_ATTR_TYPE_NULL,
+        },
+    };
+    esp_zb_zcl_custom_cluster_cmd_req(&check_in);
+}
+
+/* scheduler alarm, runs on the zigbee task */
+static void poll_control_update(uint8_t param)
+{
+    int64_t now_us = esp_timer_get_time();
+    uint32_t interval_ms = 0;
+    uint8_t actions = poll_policy_update(&poll_policy, now_us, &interval_ms);
+    if (actions & POLL_POLICY_CHECK_IN)
+    {
+        ESP_LOGI(TAG, "Check-in #%lu", (unsigned long)poll_policy.check_ins);
+        send_check_in();
+    }
+    if (actions & POLL_POLICY_SET_INTERVAL)
+    {
+        ESP_LOGD(TAG, "Polling every %lu ms", (unsigned long)interval_ms);
+#if defined ZB_ED_ROLE
+        // only end devices poll, router builds never start poll control
+        esp_zb_zdo_pim_set_long_poll_interval(interval_ms);
+#endif
+    }
+
+    esp_zb_scheduler_alarm_cancel(poll_control_update, 0);
+    int64_t deadline_us = poll_policy_next_deadline(&poll_policy, now_us);
+    if (deadline_us != POLL_POLICY_NO_DEADLINE)
+    {
+        // round up, the window has to be over when the alarm fires
+        int64_t delay_ms = (deadline_us - now_us + 999) / 1000;
+        esp_zb_scheduler_alarm(poll_control_update, 0, delay_ms > 0 ? (uint32_t)delay_ms : 1);
+    }
+}
+
+void poll_control_start(uint8_t endpoint)
+{
+    const poll_policy_config_t config = {
+        .long_poll_ms = QS_TO_MS(POLL_CONTROL_LONG_POLL_INTERVAL_QS),
+        .short_poll_ms = QS_TO_MS(POLL_CONTROL_SHORT_POLL_INTERVAL_QS),
+        .fast_poll_timeout_ms = QS_TO_MS(POLL_CONTROL_FAST_POLL_TIMEOUT_QS),
+        .fast_poll_timeout_max_ms = QS_TO_MS(POLL_CONTROL_FAST_POLL_TIMEOUT_MAX_QS),
+        .check_in_interval_ms = QS_TO_MS(POLL_CONTROL_CHECK_IN_INTERVAL_QS),
+    };
+    poll_endpoint = endpoint;
+    poll_policy_init(&poll_policy, &config, esp_timer_get_time());
+    poll_started = true;
+    poll_control_update(0);
+}
+
+void poll_control_activity(void)
+{
+    if (!poll_started)
+    {
+        return;
+    }
+    poll_policy_activity(&poll_policy, esp_timer_get_time());
+    poll_control_update(0);
+}
+
+bool poll_control_handle_attribute(const esp_zb_zcl_set_attr_value_message_t *message)
+{
+    if (message->info.cluster != ESP_ZB_ZCL_CLUSTER_ID_POLL_CONTROL || !poll_started)
+    {
+        return false;
+    }
+    if (message->attribute.id == ESP_ZB_ZCL_ATTR_POLL_CONTROL_CHECK_IN_INTERVAL_ID &&
+        message->attribute.data.type == ESP_ZB_ZCL_ATTR_TYPE_U32)
+    {
+        uint32_t interval_qs = *(uint32_t *)message->attribute.data.value;
+        poll_policy_set_check_in_interval(&poll_policy, QS_TO_MS(interval_qs), esp_timer_get_time());
+        ESP_LOGI(TAG, "Check-in interval set to %lu qs", (unsigned long)interval_qs);
+    }
+    else if (message->attribute.id == ESP_ZB_ZCL_ATTR_POLL_CONTROL_FAST_POLL_TIMEOUT_ID &&
+             message->attribute.data.type == ESP_ZB_ZCL_ATTR_TYPE_U16)
+    {
+        uint16_t timeout_qs = *(uint16_t *)message->attribute.data.value;
+        if (!poll_policy_set_fast_poll_timeout(&poll_policy, QS_TO_MS(timeout_qs)))
+        {
+            ESP_LOGW(TAG, "Ignoring fast poll timeout of %u qs", timeout_qs);
+        }
+    }
+    poll_control_update(0);
+    return true;
+}
+
+/* keeps the read-only interval attributes in line with the policy */
+static void set_interval_attribute(uint16_t attr_id, void *value)
+{
+    esp_zb_zcl_set_attribute_val(poll_endpoint, ESP_ZB_ZCL_CLUSTER_ID_POLL_CONTROL, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 attr_id, value, false);
+}
+
+esp_err_t poll_control_handle_command(const esp_zb_zcl_custom_cluster_command_message_t *message)
+{
+    ESP_RETURN_ON_FALSE(message->info.cluster == ESP_ZB_ZCL_CLUSTER_ID_POLL_CONTROL, ESP_ERR_NOT_SUPPORTED, TAG,
+                        "Unexpected cluster 0x%04x", message->info.cluster);
+    ESP_RETURN_ON_FALSE(poll_started, ESP_ERR_INVALID_STATE, TAG, "Poll control isn't started");
+    const uint8_t *payload = (const uint8_t *)message->data.value;
+    uint16_t size = payload ? message->data.size : 0;
+    int64_t now_us = esp_timer_get_time();
+    esp_err_t ret = ESP_OK;
+
+    switch (message->info.command.id)
+    {
+    case POLL_CONTROL_CMD_CHECK_IN_RESPONSE:
+        ESP_RETURN_ON_FALSE(size >= 3, ESP_ERR_INVALID_SIZE, TAG, "Check-in response too short");
+        if (payload[0])
+        {
+            uint16_t timeout_qs = payload[1] | (payload[2] << 8);
+            poll_policy_fast_poll(&poll_policy, now_us, QS_TO_MS(timeout_qs));
+            ESP_LOGI(TAG, "Fast poll requested for %u qs", timeout_qs);
+        }
+        else
+        {
+            poll_policy_stop_fast_poll(&poll_policy);
+        }
+        break;
+    case POLL_CONTROL_CMD_FAST_POLL_STOP:
+        poll_policy_stop_fast_poll(&poll_policy);
+        break;
+    case POLL_CONTROL_CMD_SET_LONG_POLL_INTERVAL:
+    {
+        ESP_RETURN_ON_FALSE(size >= 4, ESP_ERR_INVALID_SIZE, TAG, "Set long poll interval too short");
+        uint32_t interval_qs = payload[0] | (payload[1] << 8) | (payload[2] << 16) | ((uint32_t)payload[3] << 24);
+        if (interval_qs >= POLL_CONTROL_LONG_POLL_INTERVAL_MIN_QS &&
+            poll_policy_set_long_poll(&poll_policy, QS_TO_MS(interval_qs)))
+        {
+            set_interval_attribute(ESP_ZB_ZCL_ATTR_POLL_CONTROL_LONG_POLL_INTERVAL_ID, &interval_qs);
+        }
+        else
+        {
+            ret = ESP_ERR_INVALID_ARG;
+        }
+        break;
+    }
+    case POLL_CONTROL_CMD_SET_SHORT_POLL_INTERVAL:
+    {
+        ESP_RETURN_ON_FALSE(size >= 2, ESP_ERR_INVALID_SIZE, TAG, "Set short poll interval too short");
+        uint16_t interval_qs = payload[0] | (payload[1] << 8);
+        if (poll_policy_set_short_poll(&poll_policy, QS_TO_MS(interval_qs)))
+        {
+            set_interval_attribute(ESP_ZB_ZCL_ATTR_POLL_CONTROL_SHORT_POLL_INTERVAL_ID, &interval_qs);
+        }
+        else
+        {
+            ret = ESP_ERR_INVALID_ARG;
+        }
+        break;
+    }
+    default:
+        ret = ESP_ERR_NOT_SUPPORTED;
+        break;
+    }
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Poll control command 0x%02x rejected (%s)", message->info.command.id, esp_err_to_name(ret));
+    }
+
+    poll_control_update(0);
+    return ret;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_zigbee_core.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* defaults of the poll control attributes, in quarter seconds like the attributes */
+#define POLL_CONTROL_CHECK_IN_INTERVAL_QS (60 * 60 * 4) /* check-in once an hour */
+#define POLL_CONTROL_LONG_POLL_INTERVAL_QS (3 * 4)      /* idle polling, the former fixed ED_KEEP_ALIVE */
+#define POLL_CONTROL_SHORT_POLL_INTERVAL_QS 1           /* polling during a fast poll window */
+#define POLL_CONTROL_FAST_POLL_TIMEOUT_QS (10 * 4)      /* fast poll window after activity and check-ins */
+#define POLL_CONTROL_FAST_POLL_TIMEOUT_MAX_QS (60 * 4)  /* longest window a check-in response can ask for */
+#define POLL_CONTROL_CHECK_IN_INTERVAL_MIN_QS (5 * 60 * 4)
+#define POLL_CONTROL_LONG_POLL_INTERVAL_MIN_QS 4
+
+    /**
+     * @brief Create the poll control cluster (0x0020) with the defaults above and add it to @p cluster_list as server.
+     */
+    esp_err_t poll_control_add_cluster(esp_zb_cluster_list_t *cluster_list);
+
+    /**
+     * @brief Start driving the poll interval of the stack and the check-ins of @p endpoint.
+     *        Call from the zigbee task once the stack is running.
+     */
+    void poll_control_start(uint8_t endpoint);
+
+    /**
+     * @brief Local or remote activity, opens a fast poll window. Call with the zigbee lock held or from the zigbee task.
+     */
+    void poll_control_activity(void);
+
+    /**
+     * @brief Apply writes of the check-in interval and fast poll timeout attributes.
+     * @return true if the message belonged to the poll control cluster
+     */
+    bool poll_control_handle_attribute(const esp_zb_zcl_set_attr_value_message_t *message);
+
+    /**
+     * @brief Handle the client commands (check-in response, fast poll stop, set long / short poll interval).
+     */
+    esp_err_t poll_control_handle_command(const esp_zb_zcl_custom_cluster_command_message_t *message);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,126 @@
+#include "poll_policy.h"
+
+void poll_policy_init(poll_policy_t *policy, const poll_policy_config_t *config, int64_t now_us)
+{
+    *policy = (poll_policy_t){
+        .config = *config,
+    };
+    poll_policy_set_check_in_interval(policy, config->check_in_interval_ms, now_us);
+}
+
+bool poll_policy_is_fast(const poll_policy_t *policy, int64_t now_us)
+{
+    return now_us < policy->activity_until_us || now_us < policy->check_in_until_us;
+}
+
+/* moves the end of a window to now + timeout_ms unless it already ends later */
+static void extend_window(poll_policy_t *policy, int64_t *until_us, int64_t now_us, uint32_t timeout_ms)
+{
+    if (!poll_policy_is_fast(policy, now_us))
+    {
+        policy->fast_windows++;
+    }
+    int64_t end_us = now_us + (int64_t)timeout_ms * 1000;
+    if (end_us > *until_us)
+    {
+        *until_us = end_us;
+    }
+}
+
+void poll_policy_activity(poll_policy_t *policy, int64_t now_us)
+{
+    extend_window(policy, &policy->activity_until_us, now_us, policy->config.fast_poll_timeout_ms);
+}
+
+void poll_policy_fast_poll(poll_policy_t *policy, int64_t now_us, uint32_t timeout_ms)
+{
+    if (timeout_ms == 0)
+    {
+        timeout_ms = policy->config.fast_poll_timeout_ms;
+    }
+    if (timeout_ms > policy->config.fast_poll_timeout_max_ms)
+    {
+        timeout_ms = policy->config.fast_poll_timeout_max_ms;
+    }
+    // the response replaces the window opened by the check-in
+    policy->check_in_until_us = 0;
+    extend_window(policy, &policy->check_in_until_us, now_us, timeout_ms);
+}
+
+void poll_policy_stop_fast_poll(poll_policy_t *policy)
+{
+    policy->check_in_until_us = 0;
+}
+
+bool poll_policy_set_long_poll(poll_policy_t *policy, uint32_t interval_ms)
+{
+    if (interval_ms < policy->config.short_poll_ms)
+    {
+        return false;
+    }
+    policy->config.long_poll_ms = interval_ms;
+    return true;
+}
+
+bool poll_policy_set_short_poll(poll_policy_t *policy, uint32_t interval_ms)
+{
+    if (interval_ms == 0 || interval_ms > policy->config.long_poll_ms)
+    {
+        return false;
+    }
+    policy->config.short_poll_ms = interval_ms;
+    return true;
+}
+
+bool poll_policy_set_fast_poll_timeout(poll_policy_t *policy, uint32_t timeout_ms)
+{
+    if (timeout_ms == 0 || timeout_ms > policy->config.fast_poll_timeout_max_ms)
+    {
+        return false;
+    }
+    policy->config.fast_poll_timeout_ms = timeout_ms;
+    return true;
+}
+
+void poll_policy_set_check_in_interval(poll_policy_t *policy, uint32_t interval_ms, int64_t now_us)
+{
+    policy->config.check_in_interval_ms = interval_ms;
+    policy->check_in_due_us = interval_ms ? now_us + (int64_t)interval_ms * 1000 : POLL_POLICY_NO_DEADLINE;
+}
+
+uint8_t poll_policy_update(poll_policy_t *policy, int64_t now_us, uint32_t *interval_ms)
+{
+    uint8_t actions = 0;
+
+    if (now_us >= policy->check_in_due_us)
+    {
+        actions |= POLL_POLICY_CHECK_IN;
+        policy->check_ins++;
+        policy->check_in_due_us = now_us + (int64_t)policy->config.check_in_interval_ms * 1000;
+        // the client answers the check-in through our parent
+        extend_window(policy, &policy->check_in_until_us, now_us, policy->config.fast_poll_timeout_ms);
+    }
+
+    uint32_t interval = poll_policy_is_fast(policy, now_us) ? policy->config.short_poll_ms : policy->config.long_poll_ms;
+    if (interval != policy->applied_ms)
+    {
+        actions |= POLL_POLICY_SET_INTERVAL;
+        policy->applied_ms = interval;
+        *interval_ms = interval;
+    }
+    return actions;
+}
+
+int64_t poll_policy_next_deadline(const poll_policy_t *policy, int64_t now_us)
+{
+    int64_t deadline = policy->check_in_due_us;
+    if (now_us < policy->activity_until_us && policy->activity_until_us < deadline)
+    {
+        deadline = policy->activity_until_us;
+    }
+    if (now_us < policy->check_in_until_us && policy->check_in_until_us < deadline)
+    {
+        deadline = policy->check_in_until_us;
+    }
+    return deadline;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define POLL_POLICY_NO_DEADLINE INT64_MAX
+
+/* actions returned by poll_policy_update() */
+#define POLL_POLICY_SET_INTERVAL (1 << 0) /* apply the returned poll interval */
+#define POLL_POLICY_CHECK_IN (1 << 1)     /* send a check-in to the poll control client */
+
+    typedef struct poll_policy_config_t
+    {
+        uint32_t long_poll_ms;             /* poll interval while idle */
+        uint32_t short_poll_ms;            /* poll interval during a fast poll window */
+        uint32_t fast_poll_timeout_ms;     /* length of a fast poll window */
+        uint32_t fast_poll_timeout_max_ms; /* upper bound of the timeout requested by a check-in response */
+        uint32_t check_in_interval_ms;     /* time between check-ins, 0 disables them */
+    } poll_policy_config_t;
+
+    /**
+     * Decides how often the end device polls its parent, following the ZCL poll control cluster.
+     * The device polls every long_poll_ms while idle and every short_poll_ms during a fast poll window.
+     * A window opens after local or remote activity, after a check-in (to receive the response)
+     * and when the check-in response asks for it. Stopping fast poll only ends the check-in window,
+     * a window opened by activity runs until its own end.
+     * Pure logic without any hardware or OS dependency, time is passed in by the caller.
+     * Not thread safe, the caller serializes all calls.
+     */
+    typedef struct poll_policy_t
+    {
+        poll_policy_config_t config;
+        int64_t activity_until_us; /* end of the window opened by activity */
+        int64_t check_in_until_us; /* end of the window opened by a check-in or its response */
+        int64_t check_in_due_us;   /* POLL_POLICY_NO_DEADLINE if check-ins are disabled */
+        uint32_t applied_ms;       /* interval last returned with POLL_POLICY_SET_INTERVAL, 0 before the first */
+        uint32_t check_ins;
+        uint32_t fast_windows; /* windows opened while polling slowly */
+    } poll_policy_t;
+
+    void poll_policy_init(poll_policy_t *policy, const poll_policy_config_t *config, int64_t now_us);
+
+    /**
+     * @brief Local or remote activity, more commands are likely to follow.
+     */
+    void poll_policy_activity(poll_policy_t *policy, int64_t now_us);
+
+    /**
+     * @brief Check-in response asking for fast poll, a @p timeout_ms of 0 uses fast_poll_timeout_ms.
+     */
+    void poll_policy_fast_poll(poll_policy_t *policy, int64_t now_us, uint32_t timeout_ms);
+
+    /**
+     * @brief Check-in response without fast poll or a fast poll stop command.
+     */
+    void poll_policy_stop_fast_poll(poll_policy_t *policy);
+
+    /**
+     * @return false if the interval is shorter than the short poll interval
+     */
+    bool poll_policy_set_long_poll(poll_policy_t *policy, uint32_t interval_ms);
+
+    /**
+     * @return false if the interval is 0 or longer than the long poll interval
+     */
+    bool poll_policy_set_short_poll(poll_policy_t *policy, uint32_t interval_ms);
+
+    /**
+     * @return false if the timeout is 0 or above fast_poll_timeout_max_ms
+     */
+    bool poll_policy_set_fast_poll_timeout(poll_policy_t *policy, uint32_t timeout_ms);
+
+    /**
+     * @brief Restart the check-in period, 0 disables check-ins.
+     */
+    void poll_policy_set_check_in_interval(poll_policy_t *policy, uint32_t interval_ms, int64_t now_us);
+
+    /**
+     * @brief Handle window ends and due check-ins at @p now_us.
+     *
+     * @param[out] interval_ms  the poll interval, valid when POLL_POLICY_SET_INTERVAL is returned
+     * @return POLL_POLICY_* actions the caller has to take
+     */
+    uint8_t poll_policy_update(poll_policy_t *policy, int64_t now_us, uint32_t *interval_ms);
+
+    /**
+     * @brief Time at which poll_policy_update() needs to be called next, POLL_POLICY_NO_DEADLINE if nothing is pending.
+     */
+    int64_t poll_policy_next_deadline(const poll_policy_t *policy, int64_t now_us);
+
+    bool poll_policy_is_fast(const poll_policy_t *policy, int64_t now_us);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
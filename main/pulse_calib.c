@@ -0,0 +1,187 @@
+#include "pulse_calib.h"
+
+void pulse_calib_init(pulse_calib_t *calib, const pulse_calib_config_t *config, pulse_calib_pulse_callback pulse,
+                      pulse_calib_done_callback done)
+{
+    *calib = (pulse_calib_t){
+        .config = *config,
+        .pulse = pulse,
+        .done = done,
+        .phase = PULSE_CALIB_IDLE,
+        .channel = -1,
+    };
+}
+
+static uint16_t with_margin(const pulse_calib_t *calib, uint16_t value)
+{
+    return value + (uint16_t)((uint32_t)value * calib->config.margin_percent / 100);
+}
+
+static void begin_search(pulse_calib_t *calib, pulse_calib_phase_t phase, uint16_t lo, uint16_t hi)
+{
+    calib->phase = phase;
+    calib->lo = lo;
+    calib->hi = hi;
+    calib->candidate = lo + (hi - lo) / 2;
+    calib->passed = 0;
+    calib->any_passed = false;
+}
+
+static void finish(pulse_calib_t *calib, bool success, uint16_t gap_ms)
+{
+    calib->phase = PULSE_CALIB_IDLE;
+    calib->done(success, calib->pulse_ms, gap_ms);
+}
+
+/* the search range collapsed, hi is the shortest reliable value */
+static void end_search(pulse_calib_t *calib)
+{
+    if (!calib->any_passed)
+    {
+        // not a single trial succeeded, the switch or its LEDs aren't connected
+        finish(calib, false, 0);
+        return;
+    }
+
+    if (calib->phase == PULSE_CALIB_PULSE_SEARCH)
+    {
+        calib->pulse_ms = with_margin(calib, calib->hi);
+        begin_search(calib, PULSE_CALIB_GAP_SEARCH, calib->config.min_gap_ms, calib->config.max_gap_ms);
+    }
+    else
+    {
+        finish(calib, true, with_margin(calib, calib->hi));
+    }
+}
+
+static void trial_result(pulse_calib_t *calib, bool success, int64_t now_us)
+{
+    calib->in_trial = false;
+    calib->next_trial_us = now_us + calib->config.rest_us;
+
+    if (success)
+    {
+        calib->any_passed = true;
+        if (++calib->passed < calib->config.trials)
+        {
+            // repeat the same candidate
+            return;
+        }
+        calib->hi = calib->candidate;
+    }
+    else
+    {
+        calib->lo = calib->candidate + 1;
+    }
+
+    if (calib->lo >= calib->hi)
+    {
+        end_search(calib);
+        return;
+    }
+    calib->candidate = calib->lo + (calib->hi - calib->lo) / 2;
+    calib->passed = 0;
+}
+
+static void start_trial(pulse_calib_t *calib, int64_t now_us)
+{
+    calib->in_trial = true;
+    calib->changes_seen = 0;
+
+    if (calib->phase == PULSE_CALIB_PULSE_SEARCH)
+    {
+        calib->changes_expected = 1;
+        calib->second_pulse_us = PULSE_CALIB_NO_DEADLINE;
+        calib->deadline_us = now_us + calib->candidate * 1000LL + calib->config.confirm_timeout_us;
+        calib->pulse(calib->candidate);
+    }
+    else
+    {
+        calib->changes_expected = 2;
+        calib->second_pulse_us = now_us + (calib->pulse_ms + calib->candidate) * 1000LL;
+        calib->deadline_us = calib->second_pulse_us + calib->pulse_ms * 1000LL + calib->config.confirm_timeout_us;
+        calib->pulse(calib->pulse_ms);
+    }
+}
+
+void pulse_calib_start(pulse_calib_t *calib, int64_t now_us)
+{
+    calib->in_trial = false;
+    calib->next_trial_us = now_us;
+    begin_search(calib, PULSE_CALIB_PULSE_SEARCH, calib->config.min_pulse_ms, calib->config.max_pulse_ms);
+}
+
+bool pulse_calib_is_running(const pulse_calib_t *calib)
+{
+    return calib->phase != PULSE_CALIB_IDLE;
+}
+
+void pulse_calib_observe(pulse_calib_t *calib, int channel, int64_t now_us)
+{
+    if (channel == calib->channel)
+    {
+        return;
+    }
+    calib->channel = channel;
+    if (!calib->in_trial)
+    {
+        // a late reaction or a press of the switch button, the switch has to be idle when a trial starts
+        if (calib->phase != PULSE_CALIB_IDLE && calib->next_trial_us < now_us + calib->config.rest_us)
+        {
+            calib->next_trial_us = now_us + calib->config.rest_us;
+        }
+        return;
+    }
+    if (calib->changes_seen < UINT8_MAX)
+    {
+        calib->changes_seen++;
+    }
+}
+
+int64_t pulse_calib_update(pulse_calib_t *calib, int64_t now_us)
+{
+    if (calib->phase == PULSE_CALIB_IDLE)
+    {
+        return PULSE_CALIB_NO_DEADLINE;
+    }
+
+    if (!calib->in_trial)
+    {
+        if (now_us < calib->next_trial_us)
+        {
+            return calib->next_trial_us;
+        }
+        start_trial(calib, now_us);
+    }
+
+    if (calib->second_pulse_us != PULSE_CALIB_NO_DEADLINE)
+    {
+        if (now_us < calib->second_pulse_us)
+        {
+            return calib->second_pulse_us;
+        }
+        calib->second_pulse_us = PULSE_CALIB_NO_DEADLINE;
+        calib->pulse(calib->pulse_ms);
+        // changes of the first pulse alone don't decide the trial
+        return calib->deadline_us;
+    }
+
+    if (calib->changes_seen >= calib->changes_expected)
+    {
+        trial_result(calib, true, now_us);
+    }
+    else if (now_us >= calib->deadline_us)
+    {
+        trial_result(calib, false, now_us);
+    }
+    else
+    {
+        return calib->deadline_us;
+    }
+
+    if (calib->phase == PULSE_CALIB_IDLE)
+    {
+        return PULSE_CALIB_NO_DEADLINE;
+    }
+    return calib->next_trial_us;
+}
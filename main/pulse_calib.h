@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define PULSE_CALIB_NO_DEADLINE INT64_MAX
+
+    typedef struct pulse_calib_config_t
+    {
+        uint16_t min_pulse_ms;       /* search range of the pulse width, max_pulse_ms is assumed to work */
+        uint16_t max_pulse_ms;
+        uint16_t min_gap_ms;         /* search range of the gap between two pulses, max_gap_ms is assumed to work */
+        uint16_t max_gap_ms;
+        uint8_t trials;              /* consecutive successful trials for a value to count as reliable */
+        uint8_t margin_percent;      /* added to the shortest reliable values */
+        uint32_t confirm_timeout_us; /* time after the last pulse of a trial until the LEDs have to show the change */
+        uint32_t rest_us;            /* pause between two trials and after any LED change outside of a trial */
+    } pulse_calib_config_t;
+
+    /* issues one toggle pulse */
+    typedef void (*pulse_calib_pulse_callback)(uint16_t pulse_ms);
+    /* calibration finished, the values are only valid on success */
+    typedef void (*pulse_calib_done_callback)(bool success, uint16_t pulse_ms, uint16_t gap_ms);
+
+    typedef enum pulse_calib_phase_enum
+    {
+        PULSE_CALIB_IDLE = 0,
+        PULSE_CALIB_PULSE_SEARCH, /* single pulses, does the channel change? */
+        PULSE_CALIB_GAP_SEARCH,   /* two pulses, does the channel change twice? */
+    } pulse_calib_phase_t;
+
+    /**
+     * Finds the shortest pulse width and gap the switch reliably reacts to, using the channel LEDs as feedback.
+     * Both values are searched with a binary search, a candidate has to pass several trials in a row.
+     * Pure logic without any hardware or OS dependency, time is passed in by the caller.
+     */
+    typedef struct pulse_calib_t
+    {
+        pulse_calib_config_t config;
+        pulse_calib_pulse_callback pulse;
+        pulse_calib_done_callback done;
+        pulse_calib_phase_t phase;
+        uint16_t lo;               /* shortest value that may still work */
+        uint16_t hi;               /* shortest value known to work */
+        uint16_t candidate;        /* value under test */
+        uint8_t passed;            /* trials passed by the candidate */
+        bool any_passed;           /* at least one trial of the phase succeeded, the switch is responding */
+        bool in_trial;
+        uint8_t changes_seen;      /* channel changes observed during the trial */
+        uint8_t changes_expected;
+        int channel;               /* last observed channel */
+        uint16_t pulse_ms;         /* result of the pulse search */
+        int64_t next_trial_us;
+        int64_t second_pulse_us;   /* gap trial: time of the second pulse, PULSE_CALIB_NO_DEADLINE once issued */
+        int64_t deadline_us;
+    } pulse_calib_t;
+
+    void pulse_calib_init(pulse_calib_t *calib, const pulse_calib_config_t *config, pulse_calib_pulse_callback pulse,
+                          pulse_calib_done_callback done);
+
+    /**
+     * @brief Start a calibration run, the first trial is issued by the next pulse_calib_update().
+     */
+    void pulse_calib_start(pulse_calib_t *calib, int64_t now_us);
+
+    bool pulse_calib_is_running(const pulse_calib_t *calib);
+
+    /**
+     * @brief Feed the channel shown by the LEDs, repeated observations of the same channel are ignored.
+     *        A change between two trials delays the next trial until the LEDs were stable for rest_us.
+     */
+    void pulse_calib_observe(pulse_calib_t *calib, int channel, int64_t now_us);
+
+    /**
+     * @brief Issue due pulses and evaluate trials at @p now_us.
+     *
+     * @return time at which this needs to be called again, PULSE_CALIB_NO_DEADLINE if idle
+     */
+    int64_t pulse_calib_update(pulse_calib_t *calib, int64_t now_us);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
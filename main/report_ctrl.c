@@ -0,0 +1,142 @@
+#include "report_ctrl.h"
+
+void report_ctrl_init(report_ctrl_t *ctrl, const report_ctrl_config_t *config)
+{
+    *ctrl = (report_ctrl_t){
+        .config = *config,
+    };
+}
+
+/* latest value is neither acknowledged nor given up on */
+static bool report_pending(const report_ctrl_t *ctrl)
+{
+    if (!ctrl->has_value || (ctrl->has_acked && ctrl->acked_value == ctrl->value))
+    {
+        return false;
+    }
+    return ctrl->retries <= ctrl->config.max_retries;
+}
+
+/* the newest report carries the latest value, only a resend of it waits for the response */
+static bool latest_in_flight(const report_ctrl_t *ctrl)
+{
+    return ctrl->in_flight > 0 && ctrl->sent_value == ctrl->value;
+}
+
+void report_ctrl_set(report_ctrl_t *ctrl, uint16_t value)
+{
+    if (ctrl->has_value && value == ctrl->value)
+    {
+        return;
+    }
+    if (report_pending(ctrl) && !latest_in_flight(ctrl))
+    {
+        ctrl->collapsed++;
+    }
+    ctrl->has_value = true;
+    ctrl->value = value;
+    ctrl->retries = 0;
+}
+
+void report_ctrl_invalidate(report_ctrl_t *ctrl)
+{
+    ctrl->has_acked = false;
+    ctrl->retries = 0;
+}
+
+/* removes the oldest report in flight and returns its value */
+static uint16_t pop_flight(report_ctrl_t *ctrl)
+{
+    uint16_t value = ctrl->flights[0].value;
+    ctrl->in_flight--;
+    for (uint8_t i = 0; i < ctrl->in_flight; ++i)
+    {
+        ctrl->flights[i] = ctrl->flights[i + 1];
+    }
+    return value;
+}
+
+static void report_failed(report_ctrl_t *ctrl, uint16_t value)
+{
+    ctrl->failed++;
+    if (value == ctrl->value)
+    {
+        ctrl->retries++;
+    }
+}
+
+void report_ctrl_ack(report_ctrl_t *ctrl, bool success)
+{
+    if (ctrl->in_flight == 0)
+    {
+        // late response to a report that already timed out
+        return;
+    }
+    uint16_t value = pop_flight(ctrl);
+    if (!success)
+    {
+        report_failed(ctrl, value);
+        return;
+    }
+
+    ctrl->acked++;
+    ctrl->has_acked = true;
+    ctrl->acked_value = value;
+    if (value == ctrl->value)
+    {
+        ctrl->retries = 0;
+    }
+}
+
+/* earliest time of the next report */
+static int64_t next_report_us(const report_ctrl_t *ctrl)
+{
+    if (ctrl->sent == 0)
+    {
+        return 0;
+    }
+    return ctrl->last_report_us + ctrl->config.min_interval_us;
+}
+
+/* a report of the latest value is due once the minimum interval passed */
+static bool report_wanted(const report_ctrl_t *ctrl)
+{
+    return report_pending(ctrl) && !latest_in_flight(ctrl) && ctrl->in_flight < REPORT_CTRL_MAX_IN_FLIGHT;
+}
+
+bool report_ctrl_update(report_ctrl_t *ctrl, int64_t now_us, uint16_t *value)
+{
+    // reports are sent with the same timeout, the oldest one times out first
+    while (ctrl->in_flight > 0 && now_us >= ctrl->flights[0].ack_deadline_us)
+    {
+        report_failed(ctrl, pop_flight(ctrl));
+    }
+    if (!report_wanted(ctrl) || now_us < next_report_us(ctrl))
+    {
+        return false;
+    }
+
+    if (ctrl->in_flight > 0)
+    {
+        ctrl->superseded++;
+    }
+    ctrl->flights[ctrl->in_flight++] = (report_ctrl_flight_t){
+        .value = ctrl->value,
+        .ack_deadline_us = now_us + ctrl->config.ack_timeout_us,
+    };
+    ctrl->sent_value = ctrl->value;
+    ctrl->last_report_us = now_us;
+    ctrl->sent++;
+    *value = ctrl->value;
+    return true;
+}
+
+int64_t report_ctrl_next_deadline(const report_ctrl_t *ctrl)
+{
+    int64_t deadline_us = ctrl->in_flight > 0 ? ctrl->flights[0].ack_deadline_us : REPORT_CTRL_NO_DEADLINE;
+    if (report_wanted(ctrl) && next_report_us(ctrl) < deadline_us)
+    {
+        deadline_us = next_report_us(ctrl);
+    }
+    return deadline_us;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define REPORT_CTRL_NO_DEADLINE INT64_MAX
+#define REPORT_CTRL_MAX_IN_FLIGHT 4 /* reports waiting for their default response, newer values wait when full */
+
+    typedef struct report_ctrl_config_t
+    {
+        uint32_t min_interval_us; /* minimum time between two reports, changes in between collapse to the latest value */
+        uint32_t ack_timeout_us;  /* a report without default response after this long counts as failed */
+        uint8_t max_retries;      /* resends of a value that wasn't acknowledged, until the value changes again */
+    } report_ctrl_config_t;
+
+    /** a report whose default response is outstanding */
+    typedef struct report_ctrl_flight_t
+    {
+        uint16_t value;
+        int64_t ack_deadline_us;
+    } report_ctrl_flight_t;
+
+    /**
+     * Decides when the value of a single attribute is reported.
+     * A change is reported right away unless the last report was sent less than min_interval_us ago,
+     * values the coordinator already acknowledged are not reported again. A new value doesn't wait for the
+     * response to the previous report, it supersedes it once the minimum interval passed. Only a resend of the
+     * same value waits for the response or its timeout. Default responses carry no value, they are matched to
+     * the reports in the order these were sent: a response credited to an older report than it belongs to
+     * can only cause a resend, never a lost value.
+     * Pure logic without any hardware or OS dependency, time is passed in by the caller.
+     * Not thread safe, the caller serializes all calls.
+     */
+    typedef struct report_ctrl_t
+    {
+        report_ctrl_config_t config;
+        bool has_value;         /* a value was set */
+        bool has_acked;         /* acked_value is valid */
+        uint8_t in_flight;      /* used entries of flights, oldest first */
+        uint16_t value;         /* latest value */
+        uint16_t acked_value;   /* value of the last acknowledged report */
+        uint16_t sent_value;    /* value of the last report */
+        uint8_t retries;        /* failed reports of the latest value */
+        int64_t last_report_us; /* time of the last report, valid if sent > 0 */
+        report_ctrl_flight_t flights[REPORT_CTRL_MAX_IN_FLIGHT];
+        uint32_t sent;
+        uint32_t acked;
+        uint32_t failed;     /* negative default responses and timeouts */
+        uint32_t collapsed;  /* values replaced before they were reported */
+        uint32_t superseded; /* reports sent while an older one waited for its response */
+    } report_ctrl_t;
+
+    void report_ctrl_init(report_ctrl_t *ctrl, const report_ctrl_config_t *config);
+
+    /**
+     * @brief Set the latest value of the attribute.
+     */
+    void report_ctrl_set(report_ctrl_t *ctrl, uint16_t value);
+
+    /**
+     * @brief Forget the acknowledged value, e.g. after joining or when the coordinator wrote the attribute.
+     * The latest value is reported again.
+     */
+    void report_ctrl_invalidate(report_ctrl_t *ctrl);
+
+    /**
+     * @brief Feed the default response to the oldest report in flight.
+     */
+    void report_ctrl_ack(report_ctrl_t *ctrl, bool success);
+
+    /**
+     * @brief Handle timeouts and decide whether a report is sent at @p now_us.
+     *
+     * @param[out] value  the value to report, valid when true is returned
+     * @return true if the caller has to send a report now
+     */
+    bool report_ctrl_update(report_ctrl_t *ctrl, int64_t now_us, uint16_t *value);
+
+    /**
+     * @brief Time at which report_ctrl_update() needs to be called next, REPORT_CTRL_NO_DEADLINE if nothing is pending.
+     */
+    int64_t report_ctrl_next_deadline(const report_ctrl_t *ctrl);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,174 @@
+#include "switch_ctrl.h"
+
+void switch_ctrl_init(switch_ctrl_t *ctrl, const switch_ctrl_config_t *config, switch_ctrl_pulse_callback pulse,
+                      switch_ctrl_done_callback done)
+{
+    *ctrl = (switch_ctrl_t){
+        .config = *config,
+        .pulse = pulse,
+        .done = done,
+        .phase = SWITCH_CTRL_IDLE,
+        .current = SWITCH_CTRL_UNKNOWN,
+        .target = SWITCH_CTRL_UNKNOWN,
+        .expected = SWITCH_CTRL_UNKNOWN,
+    };
+}
+
+void switch_ctrl_set_timing(switch_ctrl_t *ctrl, uint16_t pulse_ms, uint16_t pulse_gap_ms)
+{
+    ctrl->config.pulse_ms = pulse_ms;
+    ctrl->config.pulse_gap_ms = pulse_gap_ms;
+}
+
+uint8_t switch_ctrl_pulses_between(const switch_ctrl_t *ctrl, int from, int to)
+{
+    if (from == SWITCH_CTRL_UNKNOWN)
+    {
+        // one pulse makes an LED light up, the next train starts from there
+        return 1;
+    }
+    int channels = ctrl->config.channels;
+    return (uint8_t)((to - from + channels) % channels);
+}
+
+static void finish(switch_ctrl_t *ctrl, bool success, int64_t now_us)
+{
+    ctrl->phase = SWITCH_CTRL_IDLE;
+    ctrl->pulses_left = 0;
+    if (success)
+    {
+        ctrl->successes++;
+    }
+    else
+    {
+        ctrl->failures++;
+    }
+    ctrl->done(ctrl->target, success, (uint32_t)(now_us - ctrl->request_us), ctrl->attempts);
+}
+
+/* issues the next pulse of the train if it is due */
+static void step_train(switch_ctrl_t *ctrl, int64_t now_us)
+{
+    if (ctrl->pulses_left == 0 || now_us < ctrl->next_pulse_us)
+    {
+        return;
+    }
+
+    ctrl->pulses_left--;
+    if (ctrl->expected != SWITCH_CTRL_UNKNOWN)
+    {
+        ctrl->expected = (ctrl->expected + 1) % ctrl->config.channels;
+    }
+    ctrl->next_pulse_us = now_us + (ctrl->config.pulse_ms + ctrl->config.pulse_gap_ms) * 1000LL;
+    ctrl->deadline_us = now_us + ctrl->config.pulse_ms * 1000LL + ctrl->config.confirm_timeout_us;
+    ctrl->pulse(ctrl->config.pulse_ms);
+}
+
+static void start_train(switch_ctrl_t *ctrl, int64_t now_us)
+{
+    ctrl->expected = ctrl->current;
+    ctrl->pulses_left = switch_ctrl_pulses_between(ctrl, ctrl->current, ctrl->target);
+    if (ctrl->pulses_left == 0)
+    {
+        finish(ctrl, true, now_us);
+        return;
+    }
+
+    ctrl->attempts++;
+    ctrl->next_pulse_us = now_us;
+    step_train(ctrl, now_us);
+}
+
+void switch_ctrl_request(switch_ctrl_t *ctrl, int target, int64_t now_us)
+{
+    if (target < 0 || target >= ctrl->config.channels)
+    {
+        // no number of pulses gets there
+        ctrl->rejected++;
+        return;
+    }
+    ctrl->target = target;
+    if (ctrl->phase == SWITCH_CTRL_WAITING)
+    {
+        // continue the running train towards the new target, attempts and deadline carry over.
+        // Pulses already issued are accounted for by expected, only the difference is added or dropped.
+        ctrl->coalesced++;
+        if (ctrl->expected != SWITCH_CTRL_UNKNOWN)
+        {
+            ctrl->pulses_left = switch_ctrl_pulses_between(ctrl, ctrl->expected, target);
+        }
+        if (ctrl->pulses_left == 0 && ctrl->current == target)
+        {
+            // the LEDs already show the new target between two pulses, no further change will confirm it
+            finish(ctrl, true, now_us);
+        }
+        return;
+    }
+    if (target == ctrl->current)
+    {
+        return;
+    }
+
+    ctrl->phase = SWITCH_CTRL_WAITING;
+    ctrl->attempts = 0;
+    ctrl->request_us = now_us;
+    start_train(ctrl, now_us);
+}
+
+void switch_ctrl_observe(switch_ctrl_t *ctrl, int channel, int64_t now_us)
+{
+    if (channel == ctrl->current)
+    {
+        return;
+    }
+    ctrl->current = channel;
+
+    // channels passed while the train is running are not a confirmation
+    if (ctrl->phase != SWITCH_CTRL_WAITING || ctrl->pulses_left > 0)
+    {
+        return;
+    }
+    if (channel == ctrl->target)
+    {
+        finish(ctrl, true, now_us);
+    }
+    else if (ctrl->expected == SWITCH_CTRL_UNKNOWN)
+    {
+        // the pulse from an unknown channel landed somewhere, continue towards the latest target from there
+        // instead of waiting for the confirmation timeout. The gap to the previous pulse is still kept.
+        ctrl->expected = channel;
+        ctrl->pulses_left = switch_ctrl_pulses_between(ctrl, channel, ctrl->target);
+    }
+}
+
+int64_t switch_ctrl_update(switch_ctrl_t *ctrl, int64_t now_us)
+{
+    if (ctrl->phase != SWITCH_CTRL_WAITING)
+    {
+        return SWITCH_CTRL_NO_DEADLINE;
+    }
+
+    step_train(ctrl, now_us);
+    if (ctrl->pulses_left > 0)
+    {
+        return ctrl->next_pulse_us;
+    }
+    if (now_us < ctrl->deadline_us)
+    {
+        return ctrl->deadline_us;
+    }
+
+    // not confirmed in time: the switch missed a pulse or a pulse was too short, start over from what the LEDs show
+    if (ctrl->attempts >= ctrl->config.max_attempts)
+    {
+        finish(ctrl, false, now_us);
+        return SWITCH_CTRL_NO_DEADLINE;
+    }
+    ctrl->retries++;
+    start_train(ctrl, now_us);
+    if (ctrl->phase != SWITCH_CTRL_WAITING)
+    {
+        return SWITCH_CTRL_NO_DEADLINE;
+    }
+    return ctrl->pulses_left > 0 ? ctrl->next_pulse_us : ctrl->deadline_us;
+}
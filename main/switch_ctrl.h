@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SWITCH_CTRL_UNKNOWN (-1)
+#define SWITCH_CTRL_NO_DEADLINE INT64_MAX
+
+    typedef struct switch_ctrl_config_t
+    {
+        uint8_t channels;            /* every pulse advances the switch by one channel, wrapping after the last */
+        uint16_t pulse_ms;           /* length of one toggle pulse */
+        uint16_t pulse_gap_ms;       /* pause between two pulses of a train */
+        uint32_t confirm_timeout_us; /* time after the last pulse until the LEDs have to show the target */
+        uint8_t max_attempts;        /* pulse trains without confirmation before the request fails */
+    } switch_ctrl_config_t;
+
+    /* issues one toggle pulse */
+    typedef void (*switch_ctrl_pulse_callback)(uint16_t pulse_ms);
+    /* a request finished, latency is measured from the request to the confirming LED change */
+    typedef void (*switch_ctrl_done_callback)(int target, bool success, uint32_t latency_us, uint8_t attempts);
+
+    typedef enum switch_ctrl_phase_enum
+    {
+        SWITCH_CTRL_IDLE = 0, /* current channel is the target */
+        SWITCH_CTRL_WAITING,  /* pulses issued, waiting for the LEDs to confirm */
+    } switch_ctrl_phase_t;
+
+    /**
+     * Closed-loop channel switching: pulses the toggle output until the observed channel is the target.
+     * The minimum number of pulses is sent as a timed train, one pulse per update at most.
+     * Requests only set the target, a burst of requests is reconciled into a single train towards the latest one.
+     * Pure logic without any hardware or OS dependency, time is passed in by the caller.
+     * Not thread safe, the caller serializes all calls.
+     */
+    typedef struct switch_ctrl_t
+    {
+        switch_ctrl_config_t config;
+        switch_ctrl_pulse_callback pulse;
+        switch_ctrl_done_callback done;
+        switch_ctrl_phase_t phase;
+        int current;           /* last observed channel, SWITCH_CTRL_UNKNOWN before the first observation */
+        int target;            /* channel requested last, newer requests replace older ones */
+        int expected;          /* channel the switch ends up on after the pulses issued so far */
+        uint8_t pulses_left;   /* pulses of the current train that still have to be issued */
+        uint8_t attempts;      /* pulse trains issued for the request */
+        int64_t request_us;    /* time of the request that is being served */
+        int64_t next_pulse_us; /* earliest time of the next pulse of the train */
+        int64_t deadline_us;   /* confirmation deadline of the last pulse */
+        uint32_t successes;
+        uint32_t failures;
+        uint32_t retries;      /* trains repeated because the LEDs didn't confirm in time */
+        uint32_t coalesced;    /* requests that replaced the target of a running request */
+        uint32_t rejected;     /* requests for a channel the switch doesn't have */
+    } switch_ctrl_t;
+
+    void switch_ctrl_init(switch_ctrl_t *ctrl, const switch_ctrl_config_t *config, switch_ctrl_pulse_callback pulse,
+                          switch_ctrl_done_callback done);
+
+    /**
+     * @brief Change pulse width and gap, e.g. after a calibration. Applies to the next pulse.
+     */
+    void switch_ctrl_set_timing(switch_ctrl_t *ctrl, uint16_t pulse_ms, uint16_t pulse_gap_ms);
+
+    /**
+     * @brief Pulses needed to get from channel @p from to @p to, 1 if @p from is unknown.
+     */
+    uint8_t switch_ctrl_pulses_between(const switch_ctrl_t *ctrl, int from, int to);
+
+    /**
+     * @brief Request a channel. A request that arrives while another one is running replaces its target,
+     *        one outside of 0 .. channels - 1 is ignored.
+     */
+    void switch_ctrl_request(switch_ctrl_t *ctrl, int target, int64_t now_us);
+
+    /**
+     * @brief Feed the channel shown by the LEDs, repeated observations of the same channel are ignored.
+     */
+    void switch_ctrl_observe(switch_ctrl_t *ctrl, int channel, int64_t now_us);
+
+    /**
+     * @brief Issue due pulses and handle confirmation timeouts at @p now_us.
+     *
+     * @return time at which this needs to be called again, SWITCH_CTRL_NO_DEADLINE if nothing is pending
+     */
+    int64_t switch_ctrl_update(switch_ctrl_t *ctrl, int64_t now_us);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
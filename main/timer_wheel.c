@@ -0,0 +1,148 @@
+#include "timer_wheel.h"
+
+#include <stddef.h>
+
+void timer_wheel_init(timer_wheel_t *wheel, uint32_t tick_us)
+{
+    *wheel = (timer_wheel_t){
+        .tick_us = tick_us > 0 ? tick_us : 1,
+    };
+}
+
+static uint64_t tick_of(const timer_wheel_t *wheel, int64_t deadline_us)
+{
+    // negative deadlines share tick 0, they are due anyway
+    return deadline_us > 0 ? (uint64_t)deadline_us / wheel->tick_us : 0;
+}
+
+static timer_wheel_entry_t **slot_of(timer_wheel_t *wheel, uint64_t tick)
+{
+    return &wheel->slots[tick & TIMER_WHEEL_SLOT_MASK];
+}
+
+static bool runs_before(const timer_wheel_entry_t *a, const timer_wheel_entry_t *b)
+{
+    if (a->deadline_us != b->deadline_us)
+    {
+        return a->deadline_us < b->deadline_us;
+    }
+    // the sequence wraps after 2^32 starts, compare the distance
+    return (int32_t)(a->sequence - b->sequence) < 0;
+}
+
+void timer_wheel_stop(timer_wheel_t *wheel, timer_wheel_entry_t *entry)
+{
+    if (!entry->active)
+    {
+        return;
+    }
+    timer_wheel_entry_t **link = slot_of(wheel, tick_of(wheel, entry->deadline_us));
+    while (*link != NULL && *link != entry)
+    {
+        link = &(*link)->next;
+    }
+    if (*link == entry)
+    {
+        *link = entry->next;
+    }
+    entry->next = NULL;
+    entry->active = false;
+    wheel->active--;
+    // the cursor stays valid, removing a timer never makes an earlier one appear
+    if (wheel->earliest == entry)
+    {
+        wheel->earliest = NULL;
+    }
+}
+
+void timer_wheel_start(timer_wheel_t *wheel, timer_wheel_entry_t *entry, int64_t deadline_us)
+{
+    timer_wheel_stop(wheel, entry);
+    entry->deadline_us = deadline_us;
+    entry->sequence = wheel->sequence++;
+    entry->active = true;
+    wheel->active++;
+
+    uint64_t tick = tick_of(wheel, deadline_us);
+    timer_wheel_entry_t **link = slot_of(wheel, tick);
+    while (*link != NULL && runs_before(*link, entry))
+    {
+        link = &(*link)->next;
+    }
+    entry->next = *link;
+    *link = entry;
+
+    if (wheel->active == 1)
+    {
+        wheel->cursor_tick = tick;
+        wheel->earliest = entry;
+        return;
+    }
+    if (tick < wheel->cursor_tick)
+    {
+        wheel->cursor_tick = tick;
+    }
+    if (wheel->earliest != NULL && runs_before(entry, wheel->earliest))
+    {
+        wheel->earliest = entry;
+    }
+}
+
+/*
+ * Timer that runs first, NULL if the wheel is empty. A slot only holds ticks that are congruent modulo
+ * TIMER_WHEEL_SLOTS, so within one revolution from the cursor the first slot whose head expires in the tick
+ * being looked at holds the earliest timer. Only if every timer is further away than that are all heads compared.
+ */
+static timer_wheel_entry_t *find_earliest(timer_wheel_t *wheel)
+{
+    if (wheel->earliest != NULL || wheel->active == 0)
+    {
+        return wheel->earliest;
+    }
+
+    for (uint64_t tick = wheel->cursor_tick; tick < wheel->cursor_tick + TIMER_WHEEL_SLOTS; ++tick)
+    {
+        timer_wheel_entry_t *head = *slot_of(wheel, tick);
+        if (head != NULL && tick_of(wheel, head->deadline_us) == tick)
+        {
+            wheel->cursor_tick = tick;
+            wheel->earliest = head;
+            return head;
+        }
+    }
+
+    timer_wheel_entry_t *earliest = NULL;
+    for (int i = 0; i < TIMER_WHEEL_SLOTS; ++i)
+    {
+        timer_wheel_entry_t *head = wheel->slots[i];
+        if (head != NULL && (earliest == NULL || runs_before(head, earliest)))
+        {
+            earliest = head;
+        }
+    }
+    wheel->cursor_tick = tick_of(wheel, earliest->deadline_us);
+    wheel->earliest = earliest;
+    return earliest;
+}
+
+timer_wheel_entry_t *timer_wheel_pop_expired(timer_wheel_t *wheel, int64_t now_us)
+{
+    timer_wheel_entry_t *entry = find_earliest(wheel);
+    if (entry == NULL || entry->deadline_us > now_us)
+    {
+        return NULL;
+    }
+    // the earliest timer is the head of its slot
+    *slot_of(wheel, tick_of(wheel, entry->deadline_us)) = entry->next;
+    entry->next = NULL;
+    entry->active = false;
+    wheel->active--;
+    wheel->earliest = NULL;
+    return entry;
+}
+
+int64_t timer_wheel_next_deadline(timer_wheel_t *wheel)
+{
+    timer_wheel_entry_t *entry = find_earliest(wheel);
+    return entry != NULL ? entry->deadline_us : TIMER_WHEEL_NO_DEADLINE;
+}
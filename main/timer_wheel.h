@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define TIMER_WHEEL_NO_DEADLINE INT64_MAX
+/* number of slots, must be a power of two */
+#define TIMER_WHEEL_SLOTS 64
+#define TIMER_WHEEL_SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+    _Static_assert((TIMER_WHEEL_SLOTS & TIMER_WHEEL_SLOT_MASK) == 0, "TIMER_WHEEL_SLOTS must be a power of two");
+
+    /** a single timer, embedded in the struct of its owner */
+    typedef struct timer_wheel_entry_t
+    {
+        struct timer_wheel_entry_t *next;
+        int64_t deadline_us;
+        uint32_t sequence; /* start order, breaks ties between equal deadlines */
+        bool active;
+    } timer_wheel_entry_t;
+
+    /**
+     * Hashed timer wheel: timers are bucketed by deadline tick into TIMER_WHEEL_SLOTS slots, every slot is a
+     * list sorted by (deadline, sequence). Deadlines further away than one revolution stay in their slot
+     * until their turn comes. The earliest timer is searched from a cursor tick that no timer expires before,
+     * so a search only walks the slots between two deadlines, and is cached until it is stopped or popped.
+     * Expired timers are popped strictly in (deadline, start order), so the same
+     * sequence of starts, stops and pops gives the same order on the target and on the host.
+     * Pure logic without any hardware or OS dependency, time is passed in by the caller.
+     * Not thread safe, the caller serializes all calls.
+     */
+    typedef struct timer_wheel_t
+    {
+        timer_wheel_entry_t *slots[TIMER_WHEEL_SLOTS];
+        uint32_t tick_us;              /* width of a slot */
+        uint32_t sequence;             /* sequence of the next start */
+        uint16_t active;               /* timers currently in the wheel */
+        uint64_t cursor_tick;          /* no active timer expires in an earlier tick */
+        timer_wheel_entry_t *earliest; /* cached first timer, NULL if it has to be searched */
+    } timer_wheel_t;
+
+    void timer_wheel_init(timer_wheel_t *wheel, uint32_t tick_us);
+
+    /**
+     * @brief Start @p entry, or restart it if it is already active. Deadlines in the past expire on the next pop.
+     */
+    void timer_wheel_start(timer_wheel_t *wheel, timer_wheel_entry_t *entry, int64_t deadline_us);
+
+    /**
+     * @brief Stop @p entry, nothing happens if it isn't active.
+     */
+    void timer_wheel_stop(timer_wheel_t *wheel, timer_wheel_entry_t *entry);
+
+    /**
+     * @brief Remove and return the earliest timer that expired at @p now_us, NULL if none did.
+     * Call repeatedly until it returns NULL to collect all expired timers in order.
+     */
+    timer_wheel_entry_t *timer_wheel_pop_expired(timer_wheel_t *wheel, int64_t now_us);
+
+    /**
+     * @brief Deadline of the earliest timer, TIMER_WHEEL_NO_DEADLINE if no timer is active.
+     */
+    int64_t timer_wheel_next_deadline(timer_wheel_t *wheel);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
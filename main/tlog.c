@@ -0,0 +1,222 @@
+#include "tlog.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_check.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#if TLOG_TOKENIZED
+
+static const char *TAG = "TLOG";
+
+typedef struct tlog_entry_t
+{
+    uint32_t timestamp_ms;
+    uint16_t token;
+    uint8_t level;
+    uint8_t count;
+    uint32_t args[TLOG_MAX_ARGS];
+} tlog_entry_t;
+
+/* written by any task under ring_lock, read by the drain task */
+static tlog_entry_t ring[TLOG_RING_ENTRIES];
+static uint32_t ring_head = 0; /* next entry to write */
+static uint32_t ring_tail = 0; /* next entry to print */
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+static atomic_uint dropped;
+
+static StackType_t drain_task_stack[TLOG_TASK_STACK_SIZE];
+static StaticTask_t drain_task_buffer;
+static TaskHandle_t drain_task_handle = NULL;
+
+void tlog_write(esp_log_level_t level, tlog_token_t token, const uint32_t *args, uint8_t count)
+{
+    uint32_t timestamp_ms = esp_log_timestamp();
+    bool wake = false;
+
+    taskENTER_CRITICAL(&ring_lock);
+    uint32_t used = ring_head - ring_tail;
+    if (used >= TLOG_RING_ENTRIES)
+    {
+        taskEXIT_CRITICAL(&ring_lock);
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        return;
+    }
+    tlog_entry_t *entry = &ring[ring_head % TLOG_RING_ENTRIES];
+    entry->timestamp_ms = timestamp_ms;
+    entry->token = token;
+    entry->level = level;
+    entry->count = count;
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        entry->args[i] = args[i];
+    }
+    ring_head++;
+    // the drain task empties the ring before it blocks again, only the first message needs to wake it
+    wake = used == 0;
+    taskEXIT_CRITICAL(&ring_lock);
+
+    if (wake && drain_task_handle != NULL)
+    {
+        xTaskNotifyGive(drain_task_handle);
+    }
+}
+
+static bool ring_pop(tlog_entry_t *entry)
+{
+    bool available;
+    taskENTER_CRITICAL(&ring_lock);
+    available = ring_head != ring_tail;
+    if (available)
+    {
+        *entry = ring[ring_tail % TLOG_RING_ENTRIES];
+        ring_tail++;
+    }
+    taskEXIT_CRITICAL(&ring_lock);
+    return available;
+}
+
+/* "$TL <timestamp ms> <level> <token> <args...>", all hex, decoded by tools/tlog.py */
+static void print_entry(const tlog_entry_t *entry)
+{
+    _Static_assert(TLOG_LINE_SIZE >= sizeof("$TL ffffffff ff ffff\n") + TLOG_MAX_ARGS * sizeof(" ffffffff"),
+                   "a record always fits into a line");
+
+    // formatted as a whole and written once, like a text mode line
+    char line[TLOG_LINE_SIZE];
+    int length = snprintf(line, sizeof(line), "$TL %lx %x %x", (unsigned long)entry->timestamp_ms, entry->level,
+                          entry->token);
+    for (uint8_t i = 0; i < entry->count; ++i)
+    {
+        length += snprintf(line + length, sizeof(line) - length, " %lx", (unsigned long)entry->args[i]);
+    }
+    line[length] = '\n';
+    line[length + 1] = '\0';
+    esp_log_write(entry->level, "tlog", "%s", line);
+}
+
+void tlog_flush(void)
+{
+    tlog_entry_t entry;
+    while (ring_pop(&entry))
+    {
+        print_entry(&entry);
+    }
+}
+
+static void tlog_drain_task(void *arg)
+{
+    (void)arg;
+    uint32_t reported_dropped = 0;
+    for (;;)
+    {
+        // no timeout, an idle ring must not wake the chip
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        tlog_flush();
+
+        uint32_t dropped_now = atomic_load_explicit(&dropped, memory_order_relaxed);
+        if (dropped_now != reported_dropped)
+        {
+            ESP_LOGW(TAG, "%lu messages dropped, the ring was full", (unsigned long)(dropped_now - reported_dropped));
+            reported_dropped = dropped_now;
+        }
+    }
+}
+
+esp_err_t tlog_init(void)
+{
+    ESP_RETURN_ON_FALSE(drain_task_handle == NULL, ESP_ERR_INVALID_STATE, TAG, "Already initialized");
+    drain_task_handle = xTaskCreateStatic(tlog_drain_task, "tlog", TLOG_TASK_STACK_SIZE, NULL, TLOG_TASK_PRIORITY,
+                                          drain_task_stack, &drain_task_buffer);
+    ESP_RETURN_ON_FALSE(drain_task_handle != NULL, ESP_FAIL, TAG, "Failed to create drain task");
+    ESP_LOGI(TAG, "Tokenized logging, decode with tools/tlog.py and build/log_tokens.json");
+    return ESP_OK;
+}
+
+uint32_t tlog_get_dropped(void)
+{
+    return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
+
+#else
+
+#define LOG_TOKEN(name, format) tlog_format_##name,
+static const char *const formats[TLOG_TOKEN_COUNT] = {
+#include "log_tokens.def"
+};
+#undef LOG_TOKEN
+
+/* formats the whole line first, esp_log_write() calls of other tasks can't end up in the middle of it */
+static void print_linev(esp_log_level_t level, const char *tag, const char *format, va_list args)
+{
+    static const char level_letters[] = {'N', 'E', 'W', 'I', 'D', 'V'};
+
+    char line[TLOG_LINE_SIZE];
+    int prefix = snprintf(line, sizeof(line), "%c (%lu) %s: ", level_letters[level],
+                          (unsigned long)esp_log_timestamp(), tag);
+    if (prefix < 0)
+    {
+        return;
+    }
+    if ((size_t)prefix < sizeof(line))
+    {
+        vsnprintf(line + prefix, sizeof(line) - prefix, format, args);
+    }
+    size_t length = strlen(line);
+    if (length > sizeof(line) - 2)
+    {
+        length = sizeof(line) - 2;
+    }
+    line[length] = '\n';
+    line[length + 1] = '\0';
+    esp_log_write(level, tag, "%s", line);
+}
+
+static void print_line(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    print_linev(level, tag, format, args);
+    va_end(args);
+}
+
+void tlog_write(esp_log_level_t level, tlog_token_t token, const uint32_t *args, uint8_t count)
+{
+    // same tag as the lines decoded by tools/tlog.py, unused trailing arguments are ignored by the format
+    _Static_assert(TLOG_MAX_ARGS == 4, "pass every argument to print_line");
+    uint32_t padded[TLOG_MAX_ARGS] = {0};
+    for (uint8_t i = 0; i < count && i < TLOG_MAX_ARGS; ++i)
+    {
+        padded[i] = args[i];
+    }
+    print_line(level, "tlog", formats[token], padded[0], padded[1], padded[2], padded[3]);
+}
+
+void tlog_printf(esp_log_level_t level, const char *tag, tlog_token_t token, ...)
+{
+    va_list args;
+    va_start(args, token);
+    print_linev(level, tag, formats[token], args);
+    va_end(args);
+}
+
+esp_err_t tlog_init(void)
+{
+    return ESP_OK;
+}
+
+void tlog_flush(void)
+{
+}
+
+uint32_t tlog_get_dropped(void)
+{
+    return 0;
+}
+
+#endif
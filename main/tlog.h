@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ * Logging for hot paths (input events, attribute writes, OTA blocks).
+ * With TLOG_TOKENIZED the caller only copies the token of the message and its arguments into a RAM ring,
+ * a low priority task prints them as "$TL ..." lines and tools/tlog.py decodes them with the token database
+ * from the build. The format strings aren't part of the image then.
+ * Without it the messages are printed right away like ESP_LOGx, using the formats from log_tokens.def.
+ * Messages are declared in log_tokens.def, call sites need a TAG like for ESP_LOGx.
+ */
+#ifndef TLOG_TOKENIZED
+#define TLOG_TOKENIZED 0
+#endif
+
+#define TLOG_MAX_ARGS 4               /* arguments per message */
+#define TLOG_RING_ENTRIES 64          /* messages waiting to be printed, newer ones are dropped when full */
+#define TLOG_TASK_STACK_SIZE 2560
+#define TLOG_TASK_PRIORITY 1          /* below everything else, printing can wait */
+#define TLOG_LINE_SIZE 128            /* text mode: longer lines are cut */
+
+    typedef enum tlog_token_enum
+    {
+#define LOG_TOKEN(name, format) TLOG_##name,
+#include "log_tokens.def"
+#undef LOG_TOKEN
+        TLOG_TOKEN_COUNT
+    } tlog_token_t;
+
+    /* formats of the messages. Only the compile time check and the text mode refer to them, a tokenized image
+     * doesn't contain them */
+#define LOG_TOKEN(name, format) static const char tlog_format_##name[] __attribute__((unused)) = format;
+#include "log_tokens.def"
+#undef LOG_TOKEN
+
+    /* never called, lets the compiler check the arguments of a message against its format like ESP_LOGx */
+    __attribute__((format(printf, 1, 2))) static inline void tlog_check_format(const char *format, ...)
+    {
+        (void)format;
+    }
+
+#if TLOG_TOKENIZED
+#define TLOG_WRITE(level, name, ...)                                                                      \
+    do                                                                                                    \
+    {                                                                                                     \
+        if (0)                                                                                            \
+        {                                                                                                 \
+            tlog_check_format(tlog_format_##name, ##__VA_ARGS__);                                         \
+        }                                                                                                 \
+        if ((level) <= LOG_LOCAL_LEVEL)                                                                   \
+        {                                                                                                 \
+            const uint32_t tlog_args_[] = {0, ##__VA_ARGS__};                                             \
+            _Static_assert(sizeof(tlog_args_) / sizeof(uint32_t) - 1 <= TLOG_MAX_ARGS, "too many arguments"); \
+            tlog_write((level), TLOG_##name, tlog_args_ + 1, sizeof(tlog_args_) / sizeof(uint32_t) - 1);  \
+        }                                                                                                 \
+    } while (0)
+#else
+#define TLOG_WRITE(level, name, ...)                               \
+    do                                                             \
+    {                                                              \
+        if (0)                                                     \
+        {                                                          \
+            tlog_check_format(tlog_format_##name, ##__VA_ARGS__);  \
+        }                                                          \
+        if ((level) <= LOG_LOCAL_LEVEL)                            \
+        {                                                          \
+            tlog_printf((level), TAG, TLOG_##name, ##__VA_ARGS__); \
+        }                                                          \
+    } while (0)
+#endif
+
+#define TLOGE(name, ...) TLOG_WRITE(ESP_LOG_ERROR, name, ##__VA_ARGS__)
+#define TLOGW(name, ...) TLOG_WRITE(ESP_LOG_WARN, name, ##__VA_ARGS__)
+#define TLOGI(name, ...) TLOG_WRITE(ESP_LOG_INFO, name, ##__VA_ARGS__)
+#define TLOGD(name, ...) TLOG_WRITE(ESP_LOG_DEBUG, name, ##__VA_ARGS__)
+
+    /* stores a message in the ring, safe to call from any task. Without TLOG_TOKENIZED it is printed right away */
+    void tlog_write(esp_log_level_t level, tlog_token_t token, const uint32_t *args, uint8_t count);
+    /* prints a message right away as a single line */
+    void tlog_printf(esp_log_level_t level, const char *tag, tlog_token_t token, ...);
+    /* starts the task that prints the ring in tokenized mode, does nothing otherwise */
+    esp_err_t tlog_init(void);
+    /* prints the messages waiting in the ring on the calling task, e.g. before a restart. Nothing waits without TLOG_TOKENIZED */
+    void tlog_flush(void);
+    /* messages lost because the ring was full */
+    uint32_t tlog_get_dropped(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -1,19 +1,140 @@
-#include "freertos/FreeRTOS.h"
 #include "esp_check.h"
 #include "esp_err.h"
-#include "esp_timer.h"
 #include "esp_log.h"
+#include "nvs.h"
+#include "app_loop.h"
 #include "toggle.h"
+#if CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#endif
 
 static const char *TAG = "TOGGLE_DRIVER";
 
+typedef enum toggle_phase_enum
+{
+    TOGGLE_IDLE = 0, /* output off, nothing scheduled */
+    TOGGLE_PULSE,    /* output on, timer ends the pulse */
+    TOGGLE_GAP,      /* output off, timer ends the minimum gap */
+} toggle_phase_t;
+
 /**
- * @brief init GPIO configuration as well as isr
+ * Pulse engine of a single output. The app loop timer is set up once in toggle_driver_gpio_init and
+ * reused for every pulse and gap, pulses requested meanwhile wait in a small ring.
+ * The gap comes from the (calibrated) timing, the pulse width from the caller.
+ */
+typedef struct toggle_output_t
+{
+    uint8_t gpio_pin;
+    app_loop_timer_t timer;
+    toggle_phase_t phase;
+    uint16_t queue[TOGGLE_QUEUE_DEPTH]; /* durations of waiting pulses in ms */
+    uint8_t queue_head;
+    toggle_stats_t stats;
+} toggle_output_t;
+
+static toggle_output_t outputs[TOGGLE_MAX_OUTPUTS];
+static uint8_t output_count = 0;
+static toggle_timing_t timing = {
+    .pulse_ms = TOGGLE_DEFAULT_PULSE_MS,
+    .gap_ms = TOGGLE_MIN_GAP_MS,
+};
+/* all of the driver runs on the app loop, except for toggle_driver_gpio_init and toggle_load_timing,
+ * which are called before the first pulse */
+static toggle_pulse_callback pulse_callback = NULL;
+#if CONFIG_PM_ENABLE
+/* held by every output that isn't idle, light sleep would let the output float mid pulse */
+static esp_pm_lock_handle_t no_sleep_lock = NULL;
+#endif
+
+static toggle_output_t *find_output(uint8_t gpio_pin)
+{
+    for (int i = 0; i < output_count; ++i)
+    {
+        if (outputs[i].gpio_pin == gpio_pin)
+        {
+            return &outputs[i];
+        }
+    }
+    return NULL;
+}
+
+/* a pulse that can't be started is dropped, the queue continues after the gap */
+static esp_err_t start_pulse(toggle_output_t *output, uint16_t durationMs)
+{
+    esp_err_t ret = gpio_set_level(output->gpio_pin, GPIO_OUTPUT_LEVEL_ON);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Unable to start a pulse on gpio %i: %s", output->gpio_pin, esp_err_to_name(ret));
+        output->stats.failed++;
+        output->phase = TOGGLE_GAP;
+        app_loop_timer_start_once(&output->timer, timing.gap_ms * 1000);
+        return ret;
+    }
+
+    output->phase = TOGGLE_PULSE;
+    output->stats.pulses++;
+    app_loop_timer_start_once(&output->timer, durationMs * 1000);
+    if (pulse_callback != NULL)
+    {
+        pulse_callback(output->gpio_pin, true);
+    }
+    return ESP_OK;
+}
+
+static void pulse_timer_callback(void *arg)
+{
+    toggle_output_t *output = arg;
+
+    if (output->phase == TOGGLE_PULSE)
+    {
+        esp_err_t ret = gpio_set_level(output->gpio_pin, GPIO_OUTPUT_LEVEL_OFF);
+        if (ret != ESP_OK)
+        {
+            // the output is still on, the pulse ends with the next attempt
+            ESP_LOGE(TAG, "Unable to end the pulse on gpio %i: %s", output->gpio_pin, esp_err_to_name(ret));
+            output->stats.failed++;
+            app_loop_timer_start_once(&output->timer, timing.gap_ms * 1000);
+            return;
+        }
+        ESP_LOGD(TAG, "Pulse on gpio %i done", output->gpio_pin);
+        if (pulse_callback != NULL)
+        {
+            pulse_callback(output->gpio_pin, false);
+        }
+        output->phase = TOGGLE_GAP;
+        app_loop_timer_start_once(&output->timer, timing.gap_ms * 1000);
+    }
+    else if (output->stats.queue_depth > 0)
+    {
+        uint16_t durationMs = output->queue[output->queue_head];
+        output->queue_head = (output->queue_head + 1) % TOGGLE_QUEUE_DEPTH;
+        output->stats.queue_depth--;
+        start_pulse(output, durationMs);
+    }
+    else
+    {
+        output->phase = TOGGLE_IDLE;
+#if CONFIG_PM_ENABLE
+        esp_pm_lock_release(no_sleep_lock);
+#endif
+    }
+}
+
+/**
+ * @brief init GPIO configuration and the pulse timer of the pin
  *
- * @param button_num            number of button pair.
+ * @param gpio_pin            output pin, can be initialized more than once
  */
 esp_err_t toggle_driver_gpio_init(uint8_t gpio_pin)
 {
+#if CONFIG_PM_ENABLE
+    if (no_sleep_lock == NULL)
+    {
+        ESP_RETURN_ON_ERROR(esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "toggle", &no_sleep_lock), TAG,
+                            "Unable to create power management lock");
+    }
+#endif
+
     uint64_t pin_bit_mask = 0;
     pin_bit_mask |= (1ULL << gpio_pin);
 
@@ -27,37 +148,112 @@ esp_err_t toggle_driver_gpio_init(uint8_t gpio_pin)
     ESP_RETURN_ON_ERROR(gpio_config(&io_conf), TAG, "Unable to configure pin %i", gpio_pin);
     ESP_RETURN_ON_ERROR(gpio_set_level(gpio_pin, GPIO_OUTPUT_LEVEL_OFF), TAG, "Unable to set gpio value for pin %i", gpio_pin);
 
+    if (find_output(gpio_pin) != NULL)
+    {
+        return ESP_OK;
+    }
+    ESP_RETURN_ON_FALSE(output_count < TOGGLE_MAX_OUTPUTS, ESP_ERR_NO_MEM, TAG, "No free output for pin %i, increase TOGGLE_MAX_OUTPUTS", gpio_pin);
+
+    toggle_output_t *output = &outputs[output_count];
+    *output = (toggle_output_t){.gpio_pin = gpio_pin, .phase = TOGGLE_IDLE};
+    app_loop_timer_init(&output->timer, pulse_timer_callback, output);
+    output_count++;
+
     return ESP_OK;
 }
 
-static void oneshot_timer_callback(void *arg)
+void toggle_set_pulse_callback(toggle_pulse_callback cb)
 {
-    uint8_t gpio_pin = (uint32_t)arg;
-    ESP_LOGI(TAG, "Oneshot timer callback");
-    ESP_ERROR_CHECK(gpio_set_level(gpio_pin, GPIO_OUTPUT_LEVEL_OFF));
+    pulse_callback = cb;
 }
 
-static esp_err_t schedule_off(uint8_t gpio_pin, uint16_t durationMs)
+esp_err_t toggle_gpio(uint8_t gpio_pin, uint16_t durationMs)
 {
-    uint32_t gpio_pin32 = gpio_pin;
-    const esp_timer_create_args_t oneshot_timer_args = {
-        .callback = &oneshot_timer_callback,
-        /* argument specified here will be passed to timer callback function */
-        .arg = (void *)gpio_pin32,
-        .name = "one-shot"};
-    esp_timer_handle_t oneshot_timer;
-    // TODO: check esp_timer_is_active, then esp_timer_restart
-    // might need to put the timer for each GPIO into a structure
-    ESP_RETURN_ON_ERROR(esp_timer_create(&oneshot_timer_args, &oneshot_timer), TAG, "Unable to create timer");
+    toggle_output_t *output = find_output(gpio_pin);
+    ESP_RETURN_ON_FALSE(output != NULL, ESP_ERR_INVALID_STATE, TAG, "Pin %i isn't initialized", gpio_pin);
 
-    /* Start the timers */
-    return esp_timer_start_once(oneshot_timer, durationMs * 1000);
+    esp_err_t ret = ESP_OK;
+    if (output->phase == TOGGLE_IDLE)
+    {
+#if CONFIG_PM_ENABLE
+        esp_pm_lock_acquire(no_sleep_lock);
+#endif
+        ret = start_pulse(output, durationMs);
+    }
+    else if (output->stats.queue_depth < TOGGLE_QUEUE_DEPTH)
+    {
+        // runs after the current pulse and the minimum gap
+        output->queue[(output->queue_head + output->stats.queue_depth) % TOGGLE_QUEUE_DEPTH] = durationMs;
+        output->stats.queue_depth++;
+        output->stats.queued++;
+        if (output->stats.queue_depth > output->stats.max_queue_depth)
+        {
+            output->stats.max_queue_depth = output->stats.queue_depth;
+        }
+    }
+    else
+    {
+        output->stats.dropped++;
+        ESP_LOGW(TAG, "Pulse queue of pin %i is full, dropping pulse", gpio_pin);
+        ret = ESP_ERR_NO_MEM;
+    }
+    return ret;
 }
 
-esp_err_t toggle_gpio(uint8_t gpio_pin, uint16_t durationMs)
+esp_err_t toggle_get_stats(uint8_t gpio_pin, toggle_stats_t *stats)
+{
+    toggle_output_t *output = find_output(gpio_pin);
+    ESP_RETURN_ON_FALSE(output != NULL, ESP_ERR_NOT_FOUND, TAG, "Pin %i isn't initialized", gpio_pin);
+
+    *stats = output->stats;
+    return ESP_OK;
+}
+
+void toggle_get_timing(toggle_timing_t *current)
+{
+    *current = timing;
+}
+
+void toggle_set_timing(const toggle_timing_t *new_timing)
 {
-    ESP_RETURN_ON_ERROR(gpio_set_level(gpio_pin, GPIO_OUTPUT_LEVEL_ON), TAG, "Unable to set gpio value for pin %i", gpio_pin);
-    ESP_RETURN_ON_ERROR(schedule_off(gpio_pin, durationMs), TAG, "Cannot schedule gpio toggle reversal");
+    timing = *new_timing;
+    ESP_LOGI(TAG, "Pulse %u ms, gap %u ms", timing.pulse_ms, timing.gap_ms);
+}
+
+esp_err_t toggle_load_timing()
+{
+    nvs_handle_t handle;
+    ESP_RETURN_ON_ERROR(nvs_open(TOGGLE_NVS_NAMESPACE, NVS_READONLY, &handle), TAG, "No stored pulse timing");
+
+    toggle_timing_t stored;
+    esp_err_t ret = nvs_get_u16(handle, "pulse_ms", &stored.pulse_ms);
+    if (ret == ESP_OK)
+    {
+        ret = nvs_get_u16(handle, "gap_ms", &stored.gap_ms);
+    }
+    nvs_close(handle);
+
+    ESP_RETURN_ON_ERROR(ret, TAG, "No stored pulse timing");
+    toggle_set_timing(&stored);
+    return ESP_OK;
+}
+
+esp_err_t toggle_save_timing()
+{
+    nvs_handle_t handle;
+    ESP_RETURN_ON_ERROR(nvs_open(TOGGLE_NVS_NAMESPACE, NVS_READWRITE, &handle), TAG, "Unable to open NVS");
+
+    esp_err_t ret = nvs_set_u16(handle, "pulse_ms", timing.pulse_ms);
+    if (ret == ESP_OK)
+    {
+        ret = nvs_set_u16(handle, "gap_ms", timing.gap_ms);
+    }
+    if (ret == ESP_OK)
+    {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
 
+    ESP_RETURN_ON_ERROR(ret, TAG, "Unable to store pulse timing");
     return ESP_OK;
 }
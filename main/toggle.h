@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdbool.h>
+
 #include "driver/gpio.h"
 
 #ifdef __cplusplus
@@ -12,9 +14,53 @@ extern "C"
 #define GPIO_OUTPUT_LEVEL_ON 0
 #define GPIO_OUTPUT_LEVEL_OFF 1
 
+/* number of output pins that can be initialized, each one owns an app loop timer */
+#define TOGGLE_MAX_OUTPUTS 2
+/* pulses that can wait while another pulse on the same pin is running */
+#define TOGGLE_QUEUE_DEPTH 4
+/* timing used until a calibration was stored in NVS */
+#define TOGGLE_DEFAULT_PULSE_MS 200
+/* minimum time the output stays off between two queued pulses */
+#ifndef TOGGLE_MIN_GAP_MS
+#define TOGGLE_MIN_GAP_MS 100
+#endif
+#define TOGGLE_NVS_NAMESPACE "toggle"
+
+    /** pulse timing the switch reacts to reliably */
+    typedef struct toggle_timing_t
+    {
+        uint16_t pulse_ms; /* shortest pulse that is recognized as a press */
+        uint16_t gap_ms;   /* time the output stays off before the next pulse is accepted */
+    } toggle_timing_t;
+
+    /** per-pin pulse counters */
+    typedef struct toggle_stats_t
+    {
+        uint32_t pulses;          /* pulses started */
+        uint32_t failed;          /* gpio_set_level errors while starting or ending a pulse */
+        uint32_t queued;          /* pulses that had to wait for a running one */
+        uint32_t dropped;         /* pulses rejected because the queue was full */
+        uint8_t queue_depth;      /* pulses currently waiting */
+        uint8_t max_queue_depth;  /* highest number of waiting pulses seen */
+    } toggle_stats_t;
+
+    /* called when a pulse starts (on, from toggle_gpio or the app loop) and ends (on the app loop) */
+    typedef void (*toggle_pulse_callback)(uint8_t gpio_pin, bool on);
+
     esp_err_t toggle_driver_gpio_init(uint8_t gpio_pin);
-    esp_err_t toggle_gpio(uint8_t gpio_pin, uint16_t durationTicksMs);
+    /* e.g. for latency measurements, set before the first pulse */
+    void toggle_set_pulse_callback(toggle_pulse_callback cb);
+    /* pulses the pin for durationMs, queued behind a running pulse. Returns ESP_ERR_NO_MEM if the queue is full
+     * and the error of gpio_set_level if an immediate pulse can't be started. Call from the app loop. */
+    esp_err_t toggle_gpio(uint8_t gpio_pin, uint16_t durationMs);
+    esp_err_t toggle_get_stats(uint8_t gpio_pin, toggle_stats_t *stats);
+    void toggle_get_timing(toggle_timing_t *timing);
+    /* applies to all outputs right away, isn't stored */
+    void toggle_set_timing(const toggle_timing_t *timing);
+    /* restores the timing stored by toggle_save_timing(), keeps the defaults if there is none */
+    esp_err_t toggle_load_timing();
+    esp_err_t toggle_save_timing();
 
 #ifdef __cplusplus
 } // extern "C"
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,29 @@
+#pragma once
+
+/*
+ * Channel layout of the USB switch. Every press of the switch button advances it by one channel
+ * and wraps around after the last one, every channel has an LED that is sensed by one input.
+ * Set USB_SWITCH_CHANNELS through the CMake cache (idf.py -D USB_SWITCH_CHANNELS=4 build).
+ */
+
+#include "driver/gpio.h"
+
+#ifndef USB_SWITCH_CHANNELS
+#define USB_SWITCH_CHANNELS 2
+#endif
+
+/* LED sense input of every channel */
+#define USB_SWITCH_LED_CH_1 GPIO_NUM_19
+#define USB_SWITCH_LED_CH_2 GPIO_NUM_18
+#if USB_SWITCH_CHANNELS == 2
+#define USB_SWITCH_CHANNEL_LEDS {USB_SWITCH_LED_CH_1, USB_SWITCH_LED_CH_2}
+#define USB_SWITCH_CHANNEL_LED_MASK ((1ULL << USB_SWITCH_LED_CH_1) | (1ULL << USB_SWITCH_LED_CH_2))
+#elif USB_SWITCH_CHANNELS == 4
+#define USB_SWITCH_LED_CH_3 GPIO_NUM_22
+#define USB_SWITCH_LED_CH_4 GPIO_NUM_23
+#define USB_SWITCH_CHANNEL_LEDS {USB_SWITCH_LED_CH_1, USB_SWITCH_LED_CH_2, USB_SWITCH_LED_CH_3, USB_SWITCH_LED_CH_4}
+#define USB_SWITCH_CHANNEL_LED_MASK ((1ULL << USB_SWITCH_LED_CH_1) | (1ULL << USB_SWITCH_LED_CH_2) | \
+                                     (1ULL << USB_SWITCH_LED_CH_3) | (1ULL << USB_SWITCH_LED_CH_4))
+#else
+#error "USB_SWITCH_CHANNELS must be 2 or 4, add the LED inputs of other layouts here"
+#endif
@@ -0,0 +1,24 @@
+#include "vertical_debounce.h"
+
+void vertical_debounce_init(vertical_debounce_t *vd, uint32_t levels)
+{
+    vd->state = levels;
+    vd->cnt0 = 0;
+    vd->cnt1 = 0;
+}
+
+uint32_t vertical_debounce_sample(vertical_debounce_t *vd, uint32_t sample)
+{
+    // bits that currently differ from the debounced state, counters of all other bits are cleared
+    uint32_t delta = sample ^ vd->state;
+
+    // count up (0 -> 1 -> 2 -> 3 -> 0) where delta is set
+    vd->cnt1 = (vd->cnt1 ^ vd->cnt0) & delta;
+    vd->cnt0 = ~vd->cnt0 & delta;
+
+    // a counter that wrapped back to 0 while still differing has seen enough samples
+    uint32_t changed = delta & ~(vd->cnt0 | vd->cnt1);
+    vd->state ^= changed;
+
+    return changed;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * Bit-parallel debouncer for up to 32 inputs sampled as one word.
+     *
+     * Every bit owns a 2-bit counter that is spread over cnt0/cnt1 ("vertical counter").
+     * A bit only flips in state after it differed from it in 4 consecutive samples,
+     * the cost per sample is a handful of bitwise operations no matter how many inputs are used.
+     */
+    typedef struct vertical_debounce_t
+    {
+        uint32_t state; /* debounced levels */
+        uint32_t cnt0;  /* low bit of each counter */
+        uint32_t cnt1;  /* high bit of each counter */
+    } vertical_debounce_t;
+
+/* number of consecutive samples a level has to be seen before it is accepted */
+#define VERTICAL_DEBOUNCE_SAMPLES 4
+
+    /**
+     * @brief Initialize the debouncer with already stable levels.
+     */
+    void vertical_debounce_init(vertical_debounce_t *vd, uint32_t levels);
+
+    /**
+     * @brief Feed one sample of all inputs.
+     *
+     * @return mask of the bits whose debounced state changed with this sample
+     */
+    uint32_t vertical_debounce_sample(vertical_debounce_t *vd, uint32_t sample);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,116 @@
+#include "zb_cmd_queue.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_zigbee_core.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "app_loop.h"
+#include "diag_counters.h"
+
+static const char *TAG = "ZB_CMD_QUEUE";
+
+typedef struct zb_cmd_t
+{
+    zb_cmd_handler handler;
+    uint32_t arg;
+} zb_cmd_t;
+
+/* written by any task under ring_lock, read by the zigbee task */
+static zb_cmd_t ring[ZB_CMD_QUEUE_DEPTH];
+static uint32_t ring_head = 0; /* next entry to write */
+static uint32_t ring_tail = 0; /* next entry to run */
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+/* a drain alarm is scheduled and hasn't started yet */
+static atomic_bool drain_scheduled;
+static app_loop_timer_t retry_timer;
+static bool initialized = false;
+
+static bool ring_pop(zb_cmd_t *cmd)
+{
+    bool available;
+    taskENTER_CRITICAL(&ring_lock);
+    available = ring_head != ring_tail;
+    if (available)
+    {
+        *cmd = ring[ring_tail % ZB_CMD_QUEUE_DEPTH];
+        ring_tail++;
+    }
+    taskEXIT_CRITICAL(&ring_lock);
+    return available;
+}
+
+/* scheduler alarm, runs on the zigbee task */
+static void zb_cmd_queue_drain(uint8_t param)
+{
+    // commands posted from now on need another alarm
+    atomic_store(&drain_scheduled, false);
+
+    zb_cmd_t cmd;
+    while (ring_pop(&cmd))
+    {
+        cmd.handler(cmd.arg);
+    }
+}
+
+static void schedule_drain(void)
+{
+    if (atomic_exchange(&drain_scheduled, true))
+    {
+        return;
+    }
+    // the zigbee task may be in the middle of a long callback, don't wait for it
+    if (esp_zb_lock_acquire(0))
+    {
+        esp_zb_scheduler_alarm(zb_cmd_queue_drain, 0, 0);
+        esp_zb_lock_release();
+        return;
+    }
+    atomic_store(&drain_scheduled, false);
+    diag_counter_add(DIAG_ZB_CMD_DEFERRED, 1);
+    // a retry that is already pending covers this command as well
+    if (!app_loop_timer_is_active(&retry_timer))
+    {
+        app_loop_timer_start_once(&retry_timer, ZB_CMD_QUEUE_RETRY_US);
+    }
+}
+
+/* app loop timer */
+static void retry_timer_callback(void *arg)
+{
+    schedule_drain();
+}
+
+esp_err_t zb_cmd_queue_init(void)
+{
+    ESP_RETURN_ON_FALSE(!initialized, ESP_ERR_INVALID_STATE, TAG, "Command queue already initialized");
+    app_loop_timer_init(&retry_timer, retry_timer_callback, NULL);
+    initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t zb_cmd_queue_post(zb_cmd_handler handler, uint32_t arg)
+{
+    taskENTER_CRITICAL(&ring_lock);
+    uint32_t used = ring_head - ring_tail;
+    if (used >= ZB_CMD_QUEUE_DEPTH)
+    {
+        taskEXIT_CRITICAL(&ring_lock);
+        diag_counter_add(DIAG_ZB_CMD_DROPS, 1);
+        ESP_LOGW(TAG, "Queue full, dropping command");
+        return ESP_ERR_NO_MEM;
+    }
+    ring[ring_head % ZB_CMD_QUEUE_DEPTH] = (zb_cmd_t){
+        .handler = handler,
+        .arg = arg,
+    };
+    ring_head++;
+    taskEXIT_CRITICAL(&ring_lock);
+
+    diag_counter_max(DIAG_ZB_CMD_HIGH_WATER, used + 1);
+    schedule_drain();
+    return ESP_OK;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define ZB_CMD_QUEUE_DEPTH 16                /* commands waiting for the zigbee task, newer ones are dropped when full */
+#define ZB_CMD_QUEUE_RETRY_US (5 * 1000)     /* retry scheduling the drain while another task holds the zigbee lock */
+
+    /* runs on the zigbee task, the stack may be used without taking the zigbee lock */
+    typedef void (*zb_cmd_handler)(uint32_t arg);
+
+    /**
+     * Hands work that needs the zigbee stack (attribute updates, reports) from other tasks to the zigbee task.
+     * Posting never blocks: the command is copied into a small ring and the zigbee task drains it from a
+     * scheduler alarm. The alarm is scheduled with a try-lock, if the zigbee lock is busy an app loop timer retries
+     * shortly after. Commands run in the order they were posted.
+     * Drops, the high water mark and deferred drains are counted in the diagnostics cluster.
+     */
+    esp_err_t zb_cmd_queue_init(void);
+
+    /**
+     * @brief Run @p handler with @p arg on the zigbee task. Safe to call from any task, not from ISRs.
+     * @return ESP_ERR_NO_MEM if the queue is full and the command was dropped
+     */
+    esp_err_t zb_cmd_queue_post(zb_cmd_handler handler, uint32_t arg);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -8,15 +8,25 @@
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "ha/esp_zigbee_ha_standard.h"
 #include "esp_zigbee_attribute.h"
 #include "ota.h"
-
-#if !defined ZB_ED_ROLE
-#error Define ZB_ED_ROLE in idf.py menuconfig to compile light (End Device) source code.
+#include "gesture.h"
+#include "switch_ctrl.h"
+#include "pulse_calib.h"
+#include "report_ctrl.h"
+#include "diag_counters.h"
+#include "latency_probe.h"
+#include "tlog.h"
+#include "poll_control.h"
+#include "zb_cmd_queue.h"
+#include "app_loop.h"
+#if USB_SWITCH_SLEEPY
+#include "esp_pm.h"
 #endif
 
 static const char *TAG = "ESP_ZB_USB_SWITCH";
@@ -65,6 +75,7 @@ static const char *TAG = "ESP_ZB_USB_SWITCH";
 #endif
 
 static uint8_t s_steering_retry_attempt = 0;
+static app_loop_timer_t s_steering_retry_timer;
 static const char s_build_date_code[] = BUILD_DATE_YYYYMMDD;
 static const char s_sw_build_id[] = ESP_SW_BUILD_ID;
 
@@ -94,106 +105,480 @@ static void build_basic_cluster_version_strings(uint32_t file_version, uint8_t *
     fill_zcl_string(date_code, date_code_size, s_build_date_code);
 }
 
-// Note: On my board GPIO_NUM_21 is soldered as input to the external button.
-// That experiment didn't work out but I'm too lazy to desolder the IC...
-// You don't need to configure GPIO_NUM_21 if it is not connected.
-const int gpio_inputs[] = {GPIO_NUM_9, GPIO_NUM_18, GPIO_NUM_19, GPIO_NUM_21};
-
-// this only works as long as gpio_inputs is const
-#define INPUT_GPIO_LEN sizeof(gpio_inputs) / sizeof(int)
-
 typedef enum usb_switch_state_enum
 {
     CH_1 = 0,
     CH_2 = 1,
-    UNKNOWN = 2
+    /* further channels follow up to USB_SWITCH_CHANNELS - 1 */
+    UNKNOWN = USB_SWITCH_CHANNELS
 } usb_switch_state_t;
 
+/* LED input of every channel, indexed by usb_switch_state_t */
+static const gpio_num_t channel_leds[USB_SWITCH_CHANNELS] = USB_SWITCH_CHANNEL_LEDS;
+
 static usb_switch_state_t usb_switch_state = UNKNOWN;
-static uint8_t reset_counter = 0;
 
-void reset_by_toggle(int gpio_num, gpio_input_state_t value)
+static const gesture_def_t gestures[] = {
+    {
+        .id = ACTION_BUTTON_SINGLE,
+        .type = GESTURE_MULTI_PRESS,
+        .input_mask = GESTURE_INPUT(GPIO_NUM_9),
+        .presses = 1,
+        .wait_release = true,
+        .gap_us = GESTURE_BUTTON_GAP_US,
+    },
+    {
+        .id = ACTION_BUTTON_DOUBLE,
+        .type = GESTURE_MULTI_PRESS,
+        .input_mask = GESTURE_INPUT(GPIO_NUM_9),
+        .presses = 2,
+        .wait_release = true,
+        .gap_us = GESTURE_BUTTON_GAP_US,
+    },
+    {
+        // two taps and a held press, a triple tap meant as something else must not start a calibration
+        .id = ACTION_CALIBRATE,
+        .type = GESTURE_TAP_HOLD,
+        .input_mask = GESTURE_INPUT(GPIO_NUM_9),
+        .presses = 3,
+        .gap_us = GESTURE_BUTTON_GAP_US,
+        .hold_us = GESTURE_CALIBRATE_HOLD_US,
+    },
+    {
+        .id = ACTION_BUTTON_HOLD,
+        .type = GESTURE_HOLD,
+        .input_mask = GESTURE_INPUT(GPIO_NUM_9),
+        .hold_us = GESTURE_FACTORY_RESET_HOLD_US,
+    },
+    {
+        // every press of the switch button turns on one of the channel LEDs
+        .id = ACTION_TOGGLE_RESET,
+        .type = GESTURE_MULTI_PRESS,
+        .input_mask = USB_SWITCH_CHANNEL_LED_MASK,
+        .presses = GESTURE_TOGGLE_RESET_PRESSES,
+        .at_least = true,
+        .gap_us = GESTURE_TOGGLE_RESET_GAP_US,
+    },
+};
+
+static gesture_slot_t gesture_slots[COUNT_ARRAY_ELEMENTS(gestures)];
+static gesture_engine_t gesture_engine;
+
+static void start_calibration(void);
+
+/* zigbee task, posted by publish_action */
+static void publish_action_handler(uint32_t arg)
+{
+    uint16_t action = arg;
+    esp_zb_zcl_report_attr_cmd_t report_attr_cmd = {
+        .address_mode = ESP_ZB_APS_ADDR_MODE_DST_ADDR_ENDP_NOT_PRESENT,
+        .clusterID = ESP_ZB_ZCL_CLUSTER_ID_MULTI_VALUE,
+        .attributeID = ESP_ZB_ZCL_ATTR_MULTI_VALUE_PRESENT_VALUE_ID,
+        .direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_CLI,
+        .zcl_basic_cmd.src_endpoint = HA_ESP_ACTION_ENDPOINT,
+    };
+
+    esp_zb_zcl_status_t status = esp_zb_zcl_set_attribute_val(HA_ESP_ACTION_ENDPOINT,
+                                                              ESP_ZB_ZCL_CLUSTER_ID_MULTI_VALUE,
+                                                              ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                                              ESP_ZB_ZCL_ATTR_MULTI_VALUE_PRESENT_VALUE_ID,
+                                                              &action,
+                                                              false);
+    // report explicitly, repeating the same gesture doesn't change the attribute value
+    esp_zb_zcl_report_attr_cmd_req(&report_attr_cmd);
+    // automations may answer with commands
+    poll_control_activity();
+    ESP_LOGI(TAG, "Action %u published, status %i", action, status);
+}
+
+static void publish_action(uint16_t action)
+{
+    zb_cmd_queue_post(publish_action_handler, action);
+}
+
+static void gesture_handler(uint8_t gesture_id, int gpio_num)
+{
+    ESP_LOGI(TAG, "Gesture %u recognized on GPIO %i", gesture_id, gpio_num);
+
+    switch (gesture_id)
+    {
+    case ACTION_BUTTON_HOLD:
+    case ACTION_TOGGLE_RESET:
+        ESP_LOGI(TAG, "Resetting device.");
+        esp_zb_factory_reset();
+        break;
+    case ACTION_CALIBRATE:
+        start_calibration();
+        break;
+    default:
+        publish_action(gesture_id);
+        break;
+    }
+}
+
+/* zigbee task, posted by set_switch_state_attribute */
+static void switch_state_attribute_handler(uint32_t arg)
+{
+    uint16_t value = arg;
+    esp_zb_zcl_status_t status = esp_zb_zcl_set_attribute_val(HA_ESP_LIGHT_ENDPOINT,
+                                                              ESP_ZB_ZCL_CLUSTER_ID_MULTI_VALUE,
+                                                              ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                                              ESP_ZB_ZCL_ATTR_MULTI_VALUE_PRESENT_VALUE_ID,
+                                                              &value,
+                                                              false);
+    TLOGI(SWITCH_ATTRIBUTE_UPDATED, value, status);
+}
+
+/* zigbee task, the attribute update of a channel change ends the latency measurement */
+static void measured_switch_state_attribute_handler(uint32_t arg)
+{
+    switch_state_attribute_handler(arg);
+    latency_probe_mark(LATENCY_PROBE_ATTRIBUTE_SET, esp_timer_get_time());
+}
+
+static void set_switch_state_attribute(usb_switch_state_t new_value);
+/* a request failed, the attribute has to be reset to the observed channel */
+static bool switch_revert_pending = false;
+
+static void switch_pulse(uint16_t pulse_ms)
+{
+    diag_counter_add(DIAG_TOGGLES, 1);
+    toggle_gpio(GPIO_OUTPUT_IO_TOGGLE_SWITCH, pulse_ms);
+}
+
+static void latency_pulse_handler(uint8_t gpio_pin, bool on)
+{
+    latency_probe_mark(on ? LATENCY_PROBE_PULSE_START : LATENCY_PROBE_PULSE_END, esp_timer_get_time());
+}
+
+static void switch_done(int target, bool success, uint32_t latency_us, uint8_t attempts)
+{
+    if (success)
+    {
+        ESP_LOGI(TAG, "Switched to channel %i in %lu ms (%u pulses)", target, (unsigned long)(latency_us / 1000), attempts);
+        diag_counter_set(DIAG_ACTUATION_LATENCY_MS, latency_us / 1000);
+    }
+    else
+    {
+        // the coordinator already wrote the target, the attribute is put back to what the LEDs show
+        // on the next input tick, together with a new report.
+        ESP_LOGW(TAG, "Switching to channel %i failed after %u pulses", target, attempts);
+        switch_revert_pending = true;
+    }
+}
+
+static switch_ctrl_t switch_ctrl;
+static pulse_calib_t pulse_calib;
+/* toggle timing of regular operation, restored if a calibration fails */
+static toggle_timing_t calib_previous_timing;
+/* switch_ctrl, pulse_calib and state_report are only touched on the app loop,
+ * requests and default responses of the zigbee task are posted to it */
+
+/**
+ * Pulses of a channel switch or a calibration light the LEDs just like presses of the switch button,
+ * ACTION_TOGGLE_RESET must not count them. Call whenever switch_ctrl or pulse_calib may have started or finished.
+ */
+static void update_toggle_reset_suspension(void)
+{
+    bool output_busy = switch_ctrl.phase != SWITCH_CTRL_IDLE || pulse_calib_is_running(&pulse_calib);
+    gesture_engine_suspend(&gesture_engine, USB_SWITCH_CHANNEL_LED_MASK, output_busy);
+}
+
+static void calib_done(bool success, uint16_t pulse_ms, uint16_t gap_ms)
+{
+    if (!success)
+    {
+        ESP_LOGW(TAG, "Pulse calibration failed, the switch didn't react");
+        toggle_set_timing(&calib_previous_timing);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Pulse calibration done: pulse %u ms, gap %u ms", pulse_ms, gap_ms);
+    toggle_timing_t calibrated = {.pulse_ms = pulse_ms, .gap_ms = gap_ms};
+    toggle_set_timing(&calibrated);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(toggle_save_timing());
+    switch_ctrl_set_timing(&switch_ctrl, pulse_ms, gap_ms);
+    app_loop_log_stack("calibration");
+}
+
+static void start_calibration(void)
 {
-    if (gpio_num == GPIO_NUM_18 || gpio_num == GPIO_NUM_19)
+    if (switch_ctrl.phase == SWITCH_CTRL_IDLE && !pulse_calib_is_running(&pulse_calib))
     {
-        if (value == ON_LONG)
+        ESP_LOGI(TAG, "Starting pulse calibration");
+        // the calibration controls the gap itself, the output must not delay its pulses
+        toggle_get_timing(&calib_previous_timing);
+        toggle_timing_t no_gap = {.pulse_ms = calib_previous_timing.pulse_ms, .gap_ms = 0};
+        toggle_set_timing(&no_gap);
+        pulse_calib_observe(&pulse_calib, usb_switch_state, esp_timer_get_time());
+        pulse_calib_start(&pulse_calib, esp_timer_get_time());
+        update_toggle_reset_suspension();
+    }
+    else
+    {
+        ESP_LOGW(TAG, "Switch is busy, not starting the pulse calibration");
+    }
+    gpio_input_request_tick();
+}
+
+/* app loop, posted by request_switch_state */
+static void request_switch_state_handler(uint32_t arg)
+{
+    usb_switch_state_t target = arg;
+    if (pulse_calib_is_running(&pulse_calib))
+    {
+        ESP_LOGW(TAG, "Pulse calibration is running, ignoring request for channel %i", target);
+    }
+    else
+    {
+        int64_t now_us = esp_timer_get_time();
+        if (target != usb_switch_state && switch_ctrl.phase == SWITCH_CTRL_IDLE)
         {
-            // reset counter
-            reset_counter = 0;
+            latency_probe_start(now_us);
         }
-        else if (value == ON)
-        {
-            // increase reset counter
-            ++reset_counter;
+        switch_ctrl_request(&switch_ctrl, target, now_us);
+        update_toggle_reset_suspension();
+    }
+    // let the next input pass pick up the new confirmation deadline
+    gpio_input_request_tick();
+}
 
-            if (reset_counter > 10)
-            {
-                ESP_LOGI(TAG, "Resetting device.");
-                esp_zb_factory_reset();
-                reset_counter = 0;
-            }
+static void request_switch_state(usb_switch_state_t target)
+{
+    app_loop_post(request_switch_state_handler, target);
+}
+
+/* app loop, posted for a channel that doesn't exist: the coordinator may have written it already */
+static void reject_switch_state_handler(uint32_t arg)
+{
+    switch_revert_pending = true;
+    gpio_input_request_tick();
+}
+
+/* zigbee task, channels written by the coordinator or recalled from a scene */
+static esp_err_t request_received_switch_state(uint16_t desired_state)
+{
+    if (desired_state >= USB_SWITCH_CHANNELS)
+    {
+        ESP_LOGW(TAG, "Channel %u doesn't exist, the switch has %d channels", desired_state, USB_SWITCH_CHANNELS);
+        app_loop_post(reject_switch_state_handler, desired_state);
+        return ESP_ERR_INVALID_ARG;
+    }
+    request_switch_state(desired_state);
+    return ESP_OK;
+}
+
+static report_ctrl_t state_report;
+
+/* zigbee task, posted by send_state_report */
+static void send_state_report_handler(uint32_t arg)
+{
+    uint16_t value = arg;
+    esp_zb_zcl_report_attr_cmd_t report_attr_cmd = {
+        .address_mode = ESP_ZB_APS_ADDR_MODE_DST_ADDR_ENDP_NOT_PRESENT,
+        .clusterID = ESP_ZB_ZCL_CLUSTER_ID_MULTI_VALUE,
+        .attributeID = ESP_ZB_ZCL_ATTR_MULTI_VALUE_PRESENT_VALUE_ID,
+        .direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_CLI,
+        .zcl_basic_cmd.src_endpoint = HA_ESP_LIGHT_ENDPOINT,
+    };
+
+    // the report carries the attribute, a write of the coordinator may have changed it since the value was set
+    esp_zb_zcl_set_attribute_val(HA_ESP_LIGHT_ENDPOINT,
+                                 ESP_ZB_ZCL_CLUSTER_ID_MULTI_VALUE,
+                                 ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 ESP_ZB_ZCL_ATTR_MULTI_VALUE_PRESENT_VALUE_ID,
+                                 &value,
+                                 false);
+    esp_zb_zcl_report_attr_cmd_req(&report_attr_cmd);
+    poll_control_activity();
+    latency_probe_mark(LATENCY_PROBE_REPORT_SENT, esp_timer_get_time());
+    TLOGI(SWITCH_STATE_REPORTED, value);
+}
+
+static void send_state_report(uint16_t value)
+{
+    zb_cmd_queue_post(send_state_report_handler, value);
+}
+
+/* app loop, posted on default responses to the channel reports */
+static void state_report_ack_handler(uint32_t success)
+{
+    report_ctrl_ack(&state_report, success);
+    gpio_input_request_tick();
+}
+
+static int64_t input_tick(int64_t now_us)
+{
+    int64_t next_deadline = gesture_engine_update(&gesture_engine, now_us);
+
+    int64_t switch_deadline = switch_ctrl_update(&switch_ctrl, now_us);
+    int64_t calib_deadline = pulse_calib_update(&pulse_calib, now_us);
+    if (calib_deadline < switch_deadline)
+    {
+        switch_deadline = calib_deadline;
+    }
+    update_toggle_reset_suspension();
+
+    // requests only fail in switch_ctrl_update or are rejected by reject_switch_state_handler,
+    // so this flag is only ever set on the app loop
+    bool revert_report = switch_revert_pending;
+    if (revert_report)
+    {
+        switch_revert_pending = false;
+        set_switch_state_attribute(usb_switch_state);
+    }
+    if (switch_deadline < next_deadline)
+    {
+        next_deadline = switch_deadline;
+    }
+
+    uint16_t report_value;
+    if (revert_report)
+    {
+        // the coordinator still shows the target it wrote, the unchanged channel has to be reported anyway
+        report_ctrl_invalidate(&state_report);
+    }
+    bool send_report = report_ctrl_update(&state_report, now_us, &report_value);
+    int64_t report_deadline = report_ctrl_next_deadline(&state_report);
+    if (send_report)
+    {
+        send_state_report(report_value);
+    }
+
+    return report_deadline < next_deadline ? report_deadline : next_deadline;
+}
+
+/* LED state of every channel, indexed by usb_switch_state_t */
+static bool channel_led_on[USB_SWITCH_CHANNELS] = {false};
+/* channel whose LED turned on last and is still on, applied once all inputs settled */
+static usb_switch_state_t pending_switch_state = UNKNOWN;
+
+static usb_switch_state_t channel_of_led(int gpio_num)
+{
+    for (int i = 0; i < USB_SWITCH_CHANNELS; ++i)
+    {
+        if (channel_leds[i] == gpio_num)
+        {
+            return i;
         }
     }
+    return UNKNOWN;
+}
+
+static void input_edge_handler(int gpio_num, uint8_t level, int64_t timestamp_us)
+{
+    if (channel_of_led(gpio_num) != UNKNOWN)
+    {
+        latency_probe_mark(LATENCY_PROBE_FIRST_EDGE, timestamp_us);
+    }
 }
 
 static void debounced_input_handler(int gpio_num, gpio_input_state_t value)
 {
-    ESP_LOGI(TAG, "GPIO %i is now %i", gpio_num, value);
+    TLOGI(INPUT_CHANGED, gpio_num, value);
+    diag_counter_add(DIAG_DEBOUNCED_EVENTS, 1);
+    if (value == ON_LONG || value == OFF_LONG)
+    {
+        diag_counter_add(DIAG_LONG_PRESSES, 1);
+    }
     // the following line can be enabled, this effectively creates a flip-flop for the inputs (good for testing connections)
     // toggle_gpio(GPIO_OUTPUT_IO_TOGGLE_SWITCH, 200);
 
-    reset_by_toggle(gpio_num, value);
+    gesture_engine_input(&gesture_engine, gpio_num, value, esp_timer_get_time());
 
-    if (value == ON)
+    usb_switch_state_t channel = channel_of_led(gpio_num);
+    if (channel != UNKNOWN && (value == ON || value == OFF))
     {
-        usb_switch_state_t new_value = UNKNOWN;
-        switch (gpio_num)
+        channel_led_on[channel] = value == ON;
+        if (value == ON)
         {
-        case GPIO_NUM_18:
-            new_value = CH_2;
-            break;
-        case GPIO_NUM_19:
-            new_value = CH_1;
-            break;
-        case GPIO_NUM_9:
-            ESP_LOGI(TAG, "Resetting device.");
-            esp_zb_factory_reset();
-            break;
-        default:
-            ESP_LOGW(TAG, "Pressing GPIO %i isn't defined.", gpio_num);
-            break;
+            latency_probe_mark(LATENCY_PROBE_DEBOUNCED, esp_timer_get_time());
+            pending_switch_state = channel;
         }
+        else if (pending_switch_state == channel)
+        {
+            // fall back to any other channel that is still lit
+            pending_switch_state = UNKNOWN;
+            for (int i = 0; i < USB_SWITCH_CHANNELS; ++i)
+            {
+                if (channel_led_on[i])
+                {
+                    pending_switch_state = i;
+                }
+            }
+        }
+    }
+    else if (value == ON && gpio_num != GPIO_NUM_9) // GPIO9 is handled by the gesture engine
+    {
+        ESP_LOGW(TAG, "Pressing GPIO %i isn't defined.", gpio_num);
+    }
+}
+
+static void apply_switch_state(usb_switch_state_t new_value)
+{
+    if (new_value == UNKNOWN || new_value == usb_switch_state)
+    {
+        return;
+    }
+
+    usb_switch_state = new_value;
+    TLOGI(SWITCH_STATE_CHANGED, new_value);
+
+    switch_ctrl_observe(&switch_ctrl, new_value, esp_timer_get_time());
+    pulse_calib_observe(&pulse_calib, new_value, esp_timer_get_time());
+    update_toggle_reset_suspension();
+
+    zb_cmd_queue_post(measured_switch_state_attribute_handler, new_value);
+
+    // reported on the next input tick
+    report_ctrl_set(&state_report, new_value);
+}
+
+static void set_switch_state_attribute(usb_switch_state_t new_value)
+{
+    zb_cmd_queue_post(switch_state_attribute_handler, new_value);
+}
 
-        if (new_value != UNKNOWN)
+/* channel whose LED is lit according to the last debounced input levels */
+static usb_switch_state_t switch_state_from_inputs(void)
+{
+    gpio_input_snapshot_t snapshot;
+    gpio_input_get_snapshot(&snapshot);
+
+    for (int i = 0; i < USB_SWITCH_CHANNELS; ++i)
+    {
+        if (gpio_input_snapshot_state(&snapshot, channel_leds[i]) == ON)
         {
-            usb_switch_state = new_value;
-            ESP_LOGI(TAG, "USB Switch state is now %i", new_value);
-
-            esp_zb_lock_acquire(portMAX_DELAY);
-            esp_zb_zcl_status_t status = esp_zb_zcl_set_attribute_val(HA_ESP_LIGHT_ENDPOINT,
-                                                                      ESP_ZB_ZCL_CLUSTER_ID_MULTI_VALUE,
-                                                                      ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
-                                                                      ESP_ZB_ZCL_ATTR_MULTI_VALUE_PRESENT_VALUE_ID,
-                                                                      &new_value,
-                                                                      false);
-            esp_zb_lock_release();
-            ESP_LOGI(TAG, "Multistate value updated to %i, status %i", new_value, status);
-
-            // manual report of attribute (not necessary)
-            // esp_zb_zcl_report_attr_cmd_t report_attr_cmd = {
-            //     .address_mode = ESP_ZB_APS_ADDR_MODE_DST_ADDR_ENDP_NOT_PRESENT,
-            //     .clusterID = ESP_ZB_ZCL_CLUSTER_ID_MULTI_VALUE,
-            //     .attributeID = ESP_ZB_ZCL_ATTR_MULTI_VALUE_PRESENT_VALUE_ID,
-            //     .direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_SRV, // ESP_ZB_ZCL_CMD_DIRECTION_TO_CLI,
-            //     .zcl_basic_cmd.src_endpoint = HA_ESP_LIGHT_ENDPOINT,
-            // };
-
-            // esp_zb_lock_acquire(portMAX_DELAY);
-            // ESP_ERROR_CHECK_WITHOUT_ABORT(esp_zb_zcl_report_attr_cmd_req(&report_attr_cmd));
-            // esp_zb_lock_release();
-            // ESP_LOGI(TAG, "Multistate value reported");
+            return i;
         }
     }
+    return UNKNOWN;
+}
+
+/**
+ * The LEDs of the old and the new channel change within milliseconds when the switch changes channel.
+ * Applying the result once all inputs settled publishes only the final state with a single attribute update.
+ */
+static void inputs_settled_handler(void)
+{
+    apply_switch_state(pending_switch_state);
+}
+
+/* app loop, posted once the inputs are initialized: the LEDs already show a channel at boot,
+ * the debounced handlers only run on changes */
+static void initial_switch_state_handler(uint32_t arg)
+{
+    apply_switch_state(switch_state_from_inputs());
+}
+
+/* app loop, posted after joining or restoring the network on reboot: the coordinator doesn't know the channel yet */
+static void network_joined_handler(uint32_t arg)
+{
+    // publish the channel from the debounced inputs, the handlers only run on changes
+    apply_switch_state(switch_state_from_inputs());
+    report_ctrl_invalidate(&state_report);
+    gpio_input_request_tick();
+    app_loop_log_stack("network join");
 }
 
 static esp_err_t deferred_driver_init(void)
@@ -205,16 +590,59 @@ static esp_err_t deferred_driver_init(void)
     light_driver_init(LIGHT_DEFAULT_OFF);
     // ESP_RETURN_ON_FALSE(switch_driver_init(button_func_pair, PAIR_SIZE(button_func_pair), zb_buttons_handler), ESP_FAIL, TAG,
     //                     "Failed to initialize switch driver");
-    ESP_LOGI(TAG, "Configuring %i pins for input", INPUT_GPIO_LEN);
-    ESP_RETURN_ON_ERROR(gpio_debounce_input_init(gpio_inputs, INPUT_GPIO_LEN, debounced_input_handler), TAG, "Failed to initialize debounced inputs.");
+    gesture_engine_init(&gesture_engine, gestures, gesture_slots, COUNT_ARRAY_ELEMENTS(gestures), gesture_handler);
     ESP_RETURN_ON_ERROR(toggle_driver_gpio_init(GPIO_OUTPUT_IO_TOGGLE_SWITCH), TAG,
                         "Failed to initialize toggle driver");
+    if (toggle_load_timing() != ESP_OK)
+    {
+        ESP_LOGI(TAG, "Switch isn't calibrated, using default pulse timing");
+    }
+
+    toggle_timing_t timing;
+    toggle_get_timing(&timing);
+    const switch_ctrl_config_t switch_ctrl_config = {
+        .channels = USB_SWITCH_CHANNELS,
+        .pulse_ms = timing.pulse_ms,
+        .pulse_gap_ms = timing.gap_ms,
+        .confirm_timeout_us = SWITCH_CONFIRM_TIMEOUT_US,
+        .max_attempts = SWITCH_MAX_ATTEMPTS,
+    };
+    const pulse_calib_config_t pulse_calib_config = {
+        .min_pulse_ms = CALIB_MIN_PULSE_MS,
+        .max_pulse_ms = CALIB_MAX_PULSE_MS,
+        .min_gap_ms = CALIB_MIN_GAP_MS,
+        .max_gap_ms = CALIB_MAX_GAP_MS,
+        .trials = CALIB_TRIALS,
+        .margin_percent = CALIB_MARGIN_PERCENT,
+        .confirm_timeout_us = CALIB_CONFIRM_TIMEOUT_US,
+        .rest_us = CALIB_REST_US,
+    };
+    const report_ctrl_config_t report_config = {
+        .min_interval_us = REPORT_MIN_INTERVAL_US,
+        .ack_timeout_us = REPORT_ACK_TIMEOUT_US,
+        .max_retries = REPORT_MAX_RETRIES,
+    };
+    report_ctrl_init(&state_report, &report_config);
+    switch_ctrl_init(&switch_ctrl, &switch_ctrl_config, switch_pulse, switch_done);
+    pulse_calib_init(&pulse_calib, &pulse_calib_config, switch_pulse, calib_done);
+
+    gpio_input_set_tick_hook(input_tick);
+    gpio_input_set_settled_callback(inputs_settled_handler);
+    gpio_input_set_edge_callback(input_edge_handler);
+    toggle_set_pulse_callback(latency_pulse_handler);
+    ESP_RETURN_ON_ERROR(gpio_debounce_input_init(debounced_input_handler), TAG, "Failed to initialize debounced inputs.");
+    app_loop_post(initial_switch_state_handler, 0);
+    diag_start_publishing(HA_ESP_LIGHT_ENDPOINT);
+#if !USB_SWITCH_ROUTER
+    poll_control_start(HA_ESP_LIGHT_ENDPOINT);
+#endif
     is_inited = true;
 
     return ESP_OK;
 }
 
-static void bdb_start_top_level_commissioning_cb(uint8_t mode_mask)
+/* zigbee task, posted by the steering retry timer */
+static void bdb_start_top_level_commissioning_handler(uint32_t mode_mask)
 {
     esp_err_t err = esp_zb_bdb_start_top_level_commissioning(mode_mask);
     if (err != ESP_OK)
@@ -223,6 +651,14 @@ static void bdb_start_top_level_commissioning_cb(uint8_t mode_mask)
     }
 }
 
+/* app loop timer, the commissioning itself has to run on the zigbee task */
+static void steering_retry_timer_callback(void *arg)
+{
+    (void)arg;
+    zb_cmd_queue_post(bdb_start_top_level_commissioning_handler, ESP_ZB_BDB_MODE_NETWORK_STEERING);
+    app_loop_log_stack("steering retry");
+}
+
 static void schedule_steering_retry(const char *reason)
 {
     uint32_t backoff_step = s_steering_retry_attempt;
@@ -241,14 +677,14 @@ static void schedule_steering_retry(const char *reason)
              (unsigned int)(s_steering_retry_attempt + 1), (unsigned long)delay_ms,
              reason ? reason : "no reason");
 
-    esp_zb_scheduler_alarm((esp_zb_callback_t)bdb_start_top_level_commissioning_cb,
-                           ESP_ZB_BDB_MODE_NETWORK_STEERING,
-                           delay_ms);
+    app_loop_timer_start_once(&s_steering_retry_timer, (uint64_t)delay_ms * 1000);
 
     if (s_steering_retry_attempt < 255)
     {
         s_steering_retry_attempt++;
     }
+    diag_counter_add(DIAG_STEERING_RETRIES, 1);
+    diag_counter_max(DIAG_STEERING_MAX_ATTEMPT, s_steering_retry_attempt);
 }
 
 void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
@@ -288,6 +724,7 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
                     ESP_LOGI(TAG, "Device rebooted and restored network (PAN ID: 0x%04hx, Channel:%d, Short Address: 0x%04hx)",
                              esp_zb_get_pan_id(), esp_zb_get_current_channel(), short_addr);
                     ota_configure_query_interval(HA_ESP_LIGHT_ENDPOINT);
+                    app_loop_post(network_joined_handler, 0);
                 }
             }
         }
@@ -311,8 +748,9 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
 
             ota_configure_query_interval(HA_ESP_LIGHT_ENDPOINT);
 
-            // read values once after zigbee initialization
-            gpio_read_once();
+            app_loop_post(network_joined_handler, 0);
+            // the coordinator configures bindings and reporting right after the join
+            poll_control_activity();
         }
         else
         {
@@ -329,6 +767,18 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
         }
         break;
     }
+    case ESP_ZB_ZDO_SIGNAL_LEAVE:
+    {
+        const esp_zb_zdo_signal_leave_params_t *leave = (const esp_zb_zdo_signal_leave_params_t *)esp_zb_app_signal_get_params(p_sg_p);
+        if (leave && leave->leave_type == ESP_ZB_NWK_LEAVE_TYPE_RESET)
+        {
+            // removed by the coordinator, look for a network again like after a factory reset
+            ESP_LOGI(TAG, "Left the network");
+            s_steering_retry_attempt = 0;
+            schedule_steering_retry("left the network");
+        }
+        break;
+    }
     case ESP_ZB_NWK_SIGNAL_PERMIT_JOIN_STATUS:
     {
         const uint8_t *duration = (const uint8_t *)esp_zb_app_signal_get_params(p_sg_p);
@@ -342,6 +792,21 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
         }
         break;
     }
+#if USB_SWITCH_ROUTER
+    case ESP_ZB_ZDO_SIGNAL_DEVICE_AUTHORIZED:
+    case ESP_ZB_ZDO_SIGNAL_DEVICE_UPDATE:
+    case ESP_ZB_NLME_STATUS_INDICATION:
+        // routed traffic and children of other routers, frequent and not interesting for the switch
+        ESP_LOGD(TAG, "ZDO signal: %s (0x%x), status: %s", esp_zb_zdo_signal_to_string(sig_type), sig_type,
+                 esp_err_to_name(err_status));
+        break;
+#endif
+#if USB_SWITCH_SLEEPY
+    case ESP_ZB_COMMON_SIGNAL_CAN_SLEEP:
+        /* nothing scheduled until the next poll, the stack turns the radio off and enters light sleep */
+        esp_zb_sleep_now();
+        break;
+#endif
     default:
         ESP_LOGI(TAG, "ZDO signal: %s (0x%x), status: %s", esp_zb_zdo_signal_to_string(sig_type), sig_type,
                  esp_err_to_name(err_status));
@@ -357,21 +822,18 @@ static esp_err_t zb_attribute_handler(const esp_zb_zcl_set_attr_value_message_t
     ESP_RETURN_ON_FALSE(message, ESP_FAIL, TAG, "Empty message");
     ESP_RETURN_ON_FALSE(message->info.status == ESP_ZB_ZCL_STATUS_SUCCESS, ESP_ERR_INVALID_ARG, TAG, "Received message: error status(%d)",
                         message->info.status);
-    ESP_LOGI(TAG, "Received message: endpoint(%d), cluster(0x%x), attribute(0x%x), data size(%d)", message->info.dst_endpoint, message->info.cluster,
-             message->attribute.id, message->attribute.data.size);
+    TLOGI(ZB_ATTRIBUTE_RECEIVED, message->info.dst_endpoint, message->info.cluster, message->attribute.id,
+          message->attribute.data.size);
     if (message->info.dst_endpoint == HA_ESP_LIGHT_ENDPOINT)
     {
         if (message->info.cluster == ESP_ZB_ZCL_CLUSTER_ID_MULTI_VALUE && message->attribute.id == ESP_ZB_ZCL_ATTR_MULTI_VALUE_PRESENT_VALUE_ID)
         {
             // determine value
             uint16_t desired_state = *(uint16_t *)message->attribute.data.value;
-            ESP_LOGI(TAG, "Received state change to value %i", desired_state);
-            // check if toggle is required
-            if (desired_state != usb_switch_state)
-            {
-                ESP_LOGI(TAG, "Switch not in desired state. Toggeling");
-                toggle_gpio(GPIO_OUTPUT_IO_TOGGLE_SWITCH, 200);
-            }
+            TLOGI(ZB_STATE_REQUESTED, desired_state);
+            ret = request_received_switch_state(desired_state);
+            // more writes often follow in a batch (scenes, automations)
+            poll_control_activity();
         }
         else if (message->info.cluster == ESP_ZB_ZCL_CLUSTER_ID_ON_OFF)
         {
@@ -382,6 +844,10 @@ static esp_err_t zb_attribute_handler(const esp_zb_zcl_set_attr_value_message_t
                 light_driver_set_power(light_state);
             }
         }
+        else
+        {
+            poll_control_handle_attribute(message);
+        }
     }
 
     return ret;
@@ -398,12 +864,13 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
     case ESP_ZB_CORE_CMD_DEFAULT_RESP_CB_ID:
         esp_zb_zcl_cmd_default_resp_message_t *msg = (esp_zb_zcl_cmd_default_resp_message_t *)message;
         // cmd 10 = report attributes
-        ESP_LOGI(TAG, "Received reponse (0x%02x) to cmd(0x%02x) endpoint(%i) cluster(%i) status(0x%02x)",
-                 ESP_ZB_CORE_CMD_DEFAULT_RESP_CB_ID,
-                 msg->resp_to_cmd,
-                 msg->info.dst_endpoint,
-                 msg->info.cluster,
-                 msg->info.status);
+        TLOGI(ZB_DEFAULT_RESPONSE, msg->resp_to_cmd, msg->info.dst_endpoint, msg->info.cluster, msg->info.status);
+        if (msg->resp_to_cmd == ESP_ZB_ZCL_CMD_REPORT_ATTRIB && msg->info.cluster == ESP_ZB_ZCL_CLUSTER_ID_MULTI_VALUE &&
+            msg->info.dst_endpoint == HA_ESP_LIGHT_ENDPOINT)
+        {
+            // reports configured on the stack are answered the same way, they confirm the value just as well
+            app_loop_post(state_report_ack_handler, msg->status_code == ESP_ZB_ZCL_STATUS_SUCCESS);
+        }
         break;
     case ESP_ZB_CORE_SCENES_STORE_SCENE_CB_ID:
     {
@@ -457,17 +924,16 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
                 uint16_t desired_state = (uint16_t)field->extension_field_attribute_value_list[0] |
                                          ((uint16_t)field->extension_field_attribute_value_list[1] << 8);
                 ESP_LOGI(TAG, "Recall scene %u/%u contains multi-value=%u", scene->group_id, scene->scene_id, desired_state);
-                if ((usb_switch_state_t)desired_state != usb_switch_state)
-                {
-                    ESP_LOGI(TAG, "Applying recalled multi-value state by toggling switch");
-                    toggle_gpio(GPIO_OUTPUT_IO_TOGGLE_SWITCH, 200);
-                }
+                request_received_switch_state(desired_state);
                 break;
             }
             field = field->next;
         }
         break;
     }
+    case ESP_ZB_CORE_CMD_CUSTOM_CLUSTER_REQ_CB_ID:
+        ret = poll_control_handle_command((const esp_zb_zcl_custom_cluster_command_message_t *)message);
+        break;
     case ESP_ZB_CORE_OTA_UPGRADE_VALUE_CB_ID:
         ota_handle_upgrade_value(message);
         break;
@@ -481,10 +947,37 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
     return ret;
 }
 
+static void enable_present_value_reporting(esp_zb_attribute_list_t *multistate_cluster, bool writeable)
+{
+    esp_zb_attribute_list_t *attr = multistate_cluster;
+    ESP_LOGV(TAG, "0: attributeId(0x%02x) access(0x%02x)", multistate_cluster->attribute.id, multistate_cluster->attribute.access);
+
+    while (attr)
+    {
+        if (attr->attribute.id == ESP_ZB_ZCL_ATTR_MULTI_VALUE_PRESENT_VALUE_ID)
+        {
+            ESP_LOGV(TAG, "1: attributeId(0x%02x) access(0x%02x)", attr->attribute.id, attr->attribute.access);
+            // by default the attribute is writeable, use only ESP_ZB_ZCL_ATTR_ACCESS_REPORTING | ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY to disable write
+            attr->attribute.access = writeable ? attr->attribute.access | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING
+                                               : ESP_ZB_ZCL_ATTR_ACCESS_REPORTING | ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY;
+            ESP_LOGV(TAG, "2: attributeId(0x%02x) access(0x%02x)", attr->attribute.id, attr->attribute.access);
+            break;
+        }
+        attr = attr->next;
+    }
+}
+
 static void esp_zb_task(void *pvParameters)
 {
     /* initialize Zigbee stack */
+#if USB_SWITCH_ROUTER
+    esp_zb_cfg_t zb_nwk_cfg = ESP_ZB_ZR_CONFIG();
+#else
     esp_zb_cfg_t zb_nwk_cfg = ESP_ZB_ZED_CONFIG();
+#endif
+#if USB_SWITCH_SLEEPY
+    esp_zb_sleep_enable(true);
+#endif
     esp_zb_init(&zb_nwk_cfg);
 
     // create empty endpoint list
@@ -495,7 +988,7 @@ static void esp_zb_task(void *pvParameters)
     esp_zb_cluster_list_t *cluster_list = esp_zb_on_off_light_clusters_create(&light_cfg);
 
     esp_zb_multistate_value_cluster_cfg_t multistate_config = {
-        .number_of_states = 2,
+        .number_of_states = USB_SWITCH_CHANNELS,
         .out_of_service = false,
         .present_value = 0,
         .status_flags = 0,
@@ -528,26 +1021,17 @@ static void esp_zb_task(void *pvParameters)
     ESP_ERROR_CHECK_WITHOUT_ABORT(esp_zb_ota_cluster_add_attr(ota_cluster,
                                                               ESP_ZB_ZCL_ATTR_OTA_UPGRADE_SERVER_ADDR_ID,
                                                               &ota_server_addr));
-    esp_zb_attribute_list_t *attr = multistate_cluster;
     // enable reporting of present value (see https://github.com/espressif/esp-zigbee-sdk/issues/372#issuecomment-2213952627)
-    ESP_LOGV(TAG, "0: attributeId(0x%02x) access(0x%02x)", multistate_cluster->attribute.id, multistate_cluster->attribute.access);
-
-    while (attr)
-    {
-        if (attr->attribute.id == ESP_ZB_ZCL_ATTR_MULTI_VALUE_PRESENT_VALUE_ID)
-        {
-            ESP_LOGV(TAG, "1: attributeId(0x%02x) access(0x%02x)", attr->attribute.id, attr->attribute.access);
-            // by default the attribute is writeable, use only ESP_ZB_ZCL_ATTR_ACCESS_REPORTING | ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY to disable write
-            attr->attribute.access = attr->attribute.access | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING;
-            ESP_LOGV(TAG, "2: attributeId(0x%02x) access(0x%02x)", attr->attribute.id, attr->attribute.access);
-            break;
-        }
-        attr = attr->next;
-    }
+    enable_present_value_reporting(multistate_cluster, true);
 
     // TODO: might be necessary to add the cluster to a different endpoint
     ESP_ERROR_CHECK_WITHOUT_ABORT(esp_zb_cluster_list_add_multistate_value_cluster(cluster_list, multistate_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
     ESP_ERROR_CHECK_WITHOUT_ABORT(esp_zb_cluster_list_add_ota_cluster(cluster_list, ota_cluster, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(diag_add_cluster(cluster_list, ESP_OTA_MANUFACTURER_CODE));
+#if !USB_SWITCH_ROUTER
+    // routers keep the receiver on, there is nothing to poll
+    ESP_ERROR_CHECK_WITHOUT_ABORT(poll_control_add_cluster(cluster_list));
+#endif
 
     // add endpoint with clusters to list
     esp_zb_endpoint_config_t ep_config = {
@@ -558,6 +1042,25 @@ static void esp_zb_task(void *pvParameters)
     };
     ESP_ERROR_CHECK_WITHOUT_ABORT(esp_zb_ep_list_add_ep(endpoint_list, cluster_list, ep_config));
 
+    // gestures are reported as read-only multistate value on their own endpoint
+    esp_zb_multistate_value_cluster_cfg_t action_config = {
+        .number_of_states = ACTION_COUNT,
+        .out_of_service = false,
+        .present_value = ACTION_NONE,
+        .status_flags = 0,
+    };
+    esp_zb_attribute_list_t *action_cluster = esp_zb_multistate_value_cluster_create(&action_config);
+    enable_present_value_reporting(action_cluster, false);
+    esp_zb_cluster_list_t *action_cluster_list = esp_zb_zcl_cluster_list_create();
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_zb_cluster_list_add_multistate_value_cluster(action_cluster_list, action_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
+    esp_zb_endpoint_config_t action_ep_config = {
+        .endpoint = HA_ESP_ACTION_ENDPOINT,
+        .app_device_id = ESP_ZB_HA_ON_OFF_SWITCH_DEVICE_ID,
+        .app_profile_id = ESP_ZB_AF_HA_PROFILE_ID,
+        .app_device_version = 1,
+    };
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_zb_ep_list_add_ep(endpoint_list, action_cluster_list, action_ep_config));
+
     // add zcl basic cluster
     uint8_t sw_build_id[33] = {0};
     uint8_t date_code[17] = {0};
@@ -575,21 +1078,46 @@ static void esp_zb_task(void *pvParameters)
     esp_zb_core_action_handler_register(zb_action_handler);
     esp_zb_set_primary_network_channel_set(ESP_ZB_PRIMARY_CHANNEL_MASK);
     esp_zb_set_secondary_network_channel_set(ESP_ZB_SECONDARY_CHANNEL_MASK);
+#if USB_SWITCH_SLEEPY
+    /* the parent buffers frames for us, they are fetched with every poll (ED_KEEP_ALIVE) */
+    esp_zb_set_rx_on_when_idle(false);
+#endif
     ESP_ERROR_CHECK(esp_zb_start(false));
     esp_zb_stack_main_loop();
 }
 
+#if USB_SWITCH_SLEEPY
+static esp_err_t esp_zb_power_save_init(void)
+{
+    /* the frequency stays fixed, the power management only adds automatic light sleep */
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .light_sleep_enable = true,
+    };
+    return esp_pm_configure(&pm_config);
+}
+#endif
+
 void app_main(void)
 {
     esp_zb_platform_config_t config = {
         .radio_config = ESP_ZB_DEFAULT_RADIO_CONFIG(),
         .host_config = ESP_ZB_DEFAULT_HOST_CONFIG(),
     };
+    ESP_ERROR_CHECK(tlog_init());
+    ESP_ERROR_CHECK(app_loop_init());
+    ESP_ERROR_CHECK(zb_cmd_queue_init());
+    app_loop_timer_init(&s_steering_retry_timer, steering_retry_timer_callback, NULL);
     ESP_LOGI(TAG, "Reset reason: %d", (int)esp_reset_reason());
     ota_log_partition_state("Boot before confirm");
+    diag_counter_set(DIAG_RESET_REASON, esp_reset_reason());
     ota_confirm_image_if_pending();
     ota_log_partition_state("Boot after confirm");
     ESP_ERROR_CHECK(nvs_flash_init());
+#if USB_SWITCH_SLEEPY
+    ESP_ERROR_CHECK(esp_zb_power_save_init());
+#endif
     ESP_ERROR_CHECK(esp_zb_platform_config(&config));
     xTaskCreate(esp_zb_task, "Zigbee_main", 4096, NULL, 5, NULL);
 }
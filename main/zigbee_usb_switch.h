@@ -8,21 +8,81 @@
 #include "gpio_input.h"
 #include "toggle.h"
 #include "zcl_utility.h"
+#include "usb_switch_channels.h"
+
+/* Zigbee role, end device by default, router with sdkconfig.defaults.router (CONFIG_ZB_ZCZR) */
+#if defined ZB_ED_ROLE
+#define USB_SWITCH_ROUTER 0
+#elif defined ZB_COORDINATOR_ROLE
+#define USB_SWITCH_ROUTER 1
+#else
+#error Select the end device (ZB_ED_ROLE) or router (ZB_COORDINATOR_ROLE) role in idf.py menuconfig.
+#endif
 
 /* Zigbee configuration */
 #define INSTALLCODE_POLICY_ENABLE false /* enable the install code policy for security */
 #define ED_AGING_TIMEOUT ESP_ZB_ED_AGING_TIMEOUT_64MIN
 #define ED_KEEP_ALIVE 3000                                               /* 3000 millisecond */
+#define ZR_MAX_CHILDREN 10                                               /* end devices that can join through the switch */
 #define HA_ESP_LIGHT_ENDPOINT 10                                         /* esp light bulb device endpoint, used to process light controlling commands */
+#define HA_ESP_ACTION_ENDPOINT 11                                        /* reports recognized gestures as multistate value */
 #define ESP_ZB_PRIMARY_CHANNEL_MASK (1U << 13)                           /* Preferred Zigbee primary channel */
 #define ESP_ZB_SECONDARY_CHANNEL_MASK (ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK & (~ESP_ZB_PRIMARY_CHANNEL_MASK))
 
-/* GPIO Inputs configuration */
-/* user should configure which I/O port as toggle switch input, default is GPIO9 */
-#define GPIO_INPUT_IO_TOGGLE_SWITCH_1 GPIO_NUM_18
-#define GPIO_INPUT_IO_TOGGLE_SWITCH_2 GPIO_NUM_19
+/* sleepy end device, the radio is off between polls and the chip enters light sleep when idle,
+ * enabled by sdkconfig.defaults.sleepy */
+#if defined(CONFIG_PM_ENABLE) && defined(CONFIG_FREERTOS_USE_TICKLESS_IDLE)
+#define USB_SWITCH_SLEEPY 1
+#else
+#define USB_SWITCH_SLEEPY 0
+#endif
+#if USB_SWITCH_SLEEPY && USB_SWITCH_ROUTER
+#error "routers keep the receiver on and can't sleep, don't combine sdkconfig.defaults.sleepy and sdkconfig.defaults.router"
+#endif
+
+/* GPIO configuration, the channel LED inputs are defined in usb_switch_channels.h */
 #define GPIO_OUTPUT_IO_TOGGLE_SWITCH GPIO_NUM_20
 
+/* Gestures */
+#define GESTURE_BUTTON_GAP_US (400 * 1000)              /* max pause between taps on the boot button */
+#define GESTURE_FACTORY_RESET_HOLD_US (5 * 1000 * 1000) /* hold the boot button this long to reset */
+#define GESTURE_CALIBRATE_HOLD_US (2 * 1000 * 1000)     /* tap the boot button twice, then hold it this long to calibrate */
+#define GESTURE_TOGGLE_RESET_PRESSES 10                 /* press the switch button at least this often to reset */
+#define GESTURE_TOGGLE_RESET_GAP_US (2 * 1000 * 1000)   /* max pause between presses of the switch button */
+
+/* Channel switching */
+#define SWITCH_CONFIRM_TIMEOUT_US (1000 * 1000)         /* LEDs have to show the new channel this long after the pulse */
+#define SWITCH_MAX_ATTEMPTS 3                           /* pulses without LED confirmation before giving up */
+
+/* Channel reporting, independent of the reporting configuration of the coordinator */
+#ifndef REPORT_MIN_INTERVAL_US
+#define REPORT_MIN_INTERVAL_US (250 * 1000)             /* reports of the channel are at least this far apart */
+#endif
+#define REPORT_ACK_TIMEOUT_US (2 * 1000 * 1000)         /* a report without default response after this long failed */
+#define REPORT_MAX_RETRIES 2                            /* resends of a channel that wasn't acknowledged */
+
+/* Pulse calibration, started by two taps of the boot button and holding it the third time */
+#define CALIB_MIN_PULSE_MS 20                           /* shortest pulse width tried */
+#define CALIB_MAX_PULSE_MS TOGGLE_DEFAULT_PULSE_MS      /* known to work */
+#define CALIB_MIN_GAP_MS 10                             /* shortest gap between two pulses tried */
+#define CALIB_MAX_GAP_MS 500                            /* assumed to work */
+#define CALIB_TRIALS 3                                  /* consecutive successes for a value to count as reliable */
+#define CALIB_MARGIN_PERCENT 25                         /* safety margin added to the shortest reliable values */
+#define CALIB_CONFIRM_TIMEOUT_US (500 * 1000)           /* LEDs have to show the change this long after a trial */
+#define CALIB_REST_US (500 * 1000)                      /* pause between trials */
+
+/* values of the multistate action attribute, only single and double are reported, keep in sync with the z2m converter */
+typedef enum usb_switch_action_enum
+{
+    ACTION_NONE = 0,
+    ACTION_BUTTON_SINGLE = 1,
+    ACTION_BUTTON_DOUBLE = 2,
+    ACTION_BUTTON_HOLD = 3,
+    ACTION_TOGGLE_RESET = 4,
+    ACTION_CALIBRATE = 5,
+    ACTION_COUNT
+} usb_switch_action_t;
+
 /* Basic manufacturer information */
 #define ESP_MANUFACTURER_NAME "\x05" \
                               "KONQI" /* Customized manufacturer name */
@@ -34,9 +94,14 @@
 #define ESP_OTA_MANUFACTURER_CODE 0x131B
 #endif
 
+/* end device and router images must not replace each other */
 #ifndef ESP_OTA_IMAGE_TYPE
+#if USB_SWITCH_ROUTER
+#define ESP_OTA_IMAGE_TYPE 0x0002
+#else
 #define ESP_OTA_IMAGE_TYPE 0x0001
 #endif
+#endif
 
 #ifndef ESP_OTA_FILE_VERSION
 #define ESP_OTA_FILE_VERSION 0x00010000
@@ -54,6 +119,15 @@
         },                                                \
     }
 
+#define ESP_ZB_ZR_CONFIG()                                \
+    {                                                     \
+        .esp_zb_role = ESP_ZB_DEVICE_TYPE_ROUTER,         \
+        .install_code_policy = INSTALLCODE_POLICY_ENABLE, \
+        .nwk_cfg.zczr_cfg = {                             \
+            .max_children = ZR_MAX_CHILDREN,              \
+        },                                                \
+    }
+
 #define ESP_ZB_DEFAULT_RADIO_CONFIG()       \
     {                                       \
         .radio_mode = ZB_RADIO_MODE_NATIVE, \
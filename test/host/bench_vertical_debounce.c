@@ -0,0 +1,101 @@
+/*
+ * Cost per sample of the bit-parallel port scan against the per-pin loop it replaces, for 4, 16 and 32 inputs.
+ * The per-pin loop walks the configured inputs, extracts each level and runs a counter per pin, like the
+ * former scan over internal_config[]. Both debouncers see the same samples and have to agree on every change.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "test.h"
+#include "vertical_debounce.h"
+
+#define BENCH_SAMPLES 2000000
+
+/* rand() leaves the top bit clear */
+static uint32_t random_word(void)
+{
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+typedef struct per_pin_t
+{
+    uint8_t bit;
+    uint8_t state;
+    uint8_t count;
+} per_pin_t;
+
+static uint32_t per_pin_sample(per_pin_t *pins, int count, uint32_t sample)
+{
+    uint32_t changed = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        per_pin_t *pin = &pins[i];
+        uint8_t level = (sample >> pin->bit) & 1;
+        if (level == pin->state)
+        {
+            pin->count = 0;
+        }
+        else if (++pin->count == VERTICAL_DEBOUNCE_SAMPLES)
+        {
+            pin->count = 0;
+            pin->state = level;
+            changed |= 1UL << pin->bit;
+        }
+    }
+    return changed;
+}
+
+static double elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+static void bench(int inputs, const uint32_t *samples, int sample_count)
+{
+    uint32_t mask = inputs == 32 ? UINT32_MAX : (1UL << inputs) - 1;
+    per_pin_t pins[32];
+    for (int i = 0; i < inputs; ++i)
+    {
+        pins[i] = (per_pin_t){.bit = (uint8_t)i};
+    }
+    vertical_debounce_t vd;
+    vertical_debounce_init(&vd, 0);
+
+    // the change masks are folded into a checksum, so neither loop can be optimized away
+    uint32_t per_pin_checksum = 0;
+    uint32_t vertical_checksum = 0;
+    struct timespec t0, t1, t2;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < sample_count; ++i)
+    {
+        per_pin_checksum = per_pin_checksum * 31 + per_pin_sample(pins, inputs, samples[i] & mask);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    for (int i = 0; i < sample_count; ++i)
+    {
+        vertical_checksum = vertical_checksum * 31 + vertical_debounce_sample(&vd, samples[i] & mask);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+
+    CHECK_EQ(vertical_checksum, per_pin_checksum);
+    printf("%2d inputs: per-pin loop %6.2f ns/sample, vertical counter %6.2f ns/sample\n", inputs,
+           elapsed_ns(&t0, &t1) / sample_count, elapsed_ns(&t1, &t2) / sample_count);
+}
+
+int main(void)
+{
+    static uint32_t samples[BENCH_SAMPLES];
+    srand(4);
+    uint32_t levels = 0;
+    for (int i = 0; i < BENCH_SAMPLES; ++i)
+    {
+        levels ^= random_word() & random_word() & random_word();
+        samples[i] = levels ^ (random_word() & random_word() & random_word() & random_word());
+    }
+
+    bench(4, samples, BENCH_SAMPLES);
+    bench(16, samples, BENCH_SAMPLES);
+    bench(32, samples, BENCH_SAMPLES);
+    return TEST_RESULT();
+}
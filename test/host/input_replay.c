@@ -0,0 +1,392 @@
+/*
+ * Replays recorded or synthetic edge traces through gpio_input.c on the host and reports how the debounced
+ * events compare to the presses the trace says really happened.
+ *
+ * Usage: input_replay <trace>
+ *
+ * Trace format, one record per line, '#' starts a comment, times in microseconds from the start of the trace:
+ *
+ *   <time_us> <gpio> <level>        raw level of an input pin from this time on, as the ISR would see it
+ *   press <gpio> <down_us> <up_us>  ground truth: the input really was active (low) in this interval
+ *   expect <metric> <op> <value>    check of the report, op is one of == <= >=
+ *
+ * All inputs start high (released / LED off), level changes have to be in time order.
+ * Each press owns the time from its down edge to the next press of the same pin: within it, exactly one ON and
+ * one OFF are expected. A press without ON is missed, every other ON / OFF is spurious, so is any ON / OFF
+ * outside of all presses. Latency is measured from the final level change of the pin before the event.
+ * The long states (ON_LONG / OFF_LONG) are only counted.
+ *
+ * Metrics: events, long_events, missed, spurious, max_latency_us, isr_calls, storms, glitches.
+ * Exits with 1 if a trace can't be read or one of its expectations fails.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "app_loop.h"
+#include "gpio_input.h"
+#include "host_sim.h"
+#include "input_pins.h"
+
+#define REPLAY_MAX_RECORDS 100000
+#define REPLAY_MAX_PRESSES 1000
+#define REPLAY_MAX_EXPECTS 32
+#define REPLAY_MAX_EVENTS 10000
+#define REPLAY_TAIL_US (10LL * 1000 * 1000) /* time replayed after the last level change */
+
+typedef struct level_change_t
+{
+    int64_t time_us;
+    int gpio_num;
+    int level;
+} level_change_t;
+
+typedef struct press_t
+{
+    int gpio_num;
+    int64_t down_us;
+    int64_t up_us;
+} press_t;
+
+typedef struct expect_t
+{
+    char metric[32];
+    char op[3];
+    long long value;
+    int line;
+} expect_t;
+
+typedef struct event_t
+{
+    int gpio_num;
+    gpio_input_state_t state;
+    int64_t time_us;
+} event_t;
+
+typedef struct report_t
+{
+    long long events;
+    long long long_events;
+    long long missed;
+    long long spurious;
+    long long max_latency_us;
+    long long total_latency_us;
+    long long isr_calls;
+    long long storms;
+    long long glitches;
+} report_t;
+
+static const gpio_input_pin_config_t pins[] = {
+#define REPLAY_PIN(gpio, timing) {.gpio_num = (gpio), .profile = timing},
+    GPIO_INPUT_PINS(REPLAY_PIN)
+#undef REPLAY_PIN
+};
+#define PIN_COUNT ((int)COUNT_ARRAY_ELEMENTS(pins))
+
+static level_change_t changes[REPLAY_MAX_RECORDS];
+static int change_count = 0;
+static press_t presses[REPLAY_MAX_PRESSES];
+static int press_count = 0;
+static expect_t expects[REPLAY_MAX_EXPECTS];
+static int expect_count = 0;
+static event_t events[REPLAY_MAX_EVENTS];
+static int event_count = 0;
+
+static bool is_input(int gpio_num)
+{
+    for (int i = 0; i < PIN_COUNT; ++i)
+    {
+        if (pins[i].gpio_num == gpio_num)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_trace(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+    {
+        fprintf(stderr, "%s: can't open\n", path);
+        return false;
+    }
+
+    char line[256];
+    int line_number = 0;
+    bool ok = true;
+    int64_t last_time_us = 0;
+    while (ok && fgets(line, sizeof(line), f) != NULL)
+    {
+        line_number++;
+        char *comment = strchr(line, '#');
+        if (comment != NULL)
+        {
+            *comment = '\0';
+        }
+
+        char word[32];
+        long long a, b, c;
+        if (sscanf(line, " %31s", word) != 1)
+        {
+            continue;
+        }
+        if (strcmp(word, "press") == 0)
+        {
+            ok = sscanf(line, " press %lld %lld %lld", &a, &b, &c) == 3 && press_count < REPLAY_MAX_PRESSES &&
+                 is_input((int)a) && b < c;
+            if (ok)
+            {
+                presses[press_count++] = (press_t){(int)a, b, c};
+            }
+        }
+        else if (strcmp(word, "expect") == 0)
+        {
+            expect_t *expect = &expects[expect_count];
+            ok = expect_count < REPLAY_MAX_EXPECTS &&
+                 sscanf(line, " expect %31s %2s %lld", expect->metric, expect->op, &expect->value) == 3;
+            if (ok)
+            {
+                expect->line = line_number;
+                expect_count++;
+            }
+        }
+        else
+        {
+            ok = sscanf(line, " %lld %lld %lld", &a, &b, &c) == 3 && change_count < REPLAY_MAX_RECORDS &&
+                 a >= last_time_us && is_input((int)b) && (c == 0 || c == 1);
+            if (ok)
+            {
+                changes[change_count++] = (level_change_t){a, (int)b, (int)c};
+                last_time_us = a;
+            }
+        }
+        if (!ok)
+        {
+            fprintf(stderr, "%s:%d: invalid record\n", path, line_number);
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+static void input_callback(int gpio_num, gpio_input_state_t state)
+{
+    if (event_count < REPLAY_MAX_EVENTS)
+    {
+        events[event_count++] = (event_t){gpio_num, state, host_now_us()};
+    }
+}
+
+/* time of the last level change of @p gpio_num at or before @p time_us */
+static int64_t final_change_before(int gpio_num, int64_t time_us)
+{
+    int64_t final_us = 0;
+    for (int i = 0; i < change_count && changes[i].time_us <= time_us; ++i)
+    {
+        if (changes[i].gpio_num == gpio_num)
+        {
+            final_us = changes[i].time_us;
+        }
+    }
+    return final_us;
+}
+
+/* the press that owns @p time_us on @p gpio_num, -1 if none does */
+static int owning_press(int gpio_num, int64_t time_us)
+{
+    int owner = -1;
+    for (int i = 0; i < press_count; ++i)
+    {
+        if (presses[i].gpio_num == gpio_num && presses[i].down_us <= time_us &&
+            (owner < 0 || presses[i].down_us > presses[owner].down_us))
+        {
+            owner = i;
+        }
+    }
+    return owner;
+}
+
+static void evaluate(report_t *report)
+{
+    static uint32_t on_count[REPLAY_MAX_PRESSES];
+    static uint32_t off_count[REPLAY_MAX_PRESSES];
+    memset(on_count, 0, sizeof(on_count));
+    memset(off_count, 0, sizeof(off_count));
+
+    for (int i = 0; i < event_count; ++i)
+    {
+        const event_t *event = &events[i];
+        if (event->state == ON_LONG || event->state == OFF_LONG)
+        {
+            report->long_events++;
+            continue;
+        }
+        report->events++;
+
+        long long latency_us = event->time_us - final_change_before(event->gpio_num, event->time_us);
+        report->total_latency_us += latency_us;
+        if (latency_us > report->max_latency_us)
+        {
+            report->max_latency_us = latency_us;
+        }
+
+        int press = owning_press(event->gpio_num, event->time_us);
+        if (press < 0)
+        {
+            report->spurious++;
+        }
+        else if (event->state == ON && on_count[press]++ > 0)
+        {
+            report->spurious++;
+        }
+        else if (event->state == OFF && (on_count[press] == 0 || off_count[press]++ > 0))
+        {
+            report->spurious++;
+        }
+    }
+
+    for (int i = 0; i < press_count; ++i)
+    {
+        if (on_count[i] == 0)
+        {
+            report->missed++;
+        }
+    }
+
+    for (int i = 0; i < PIN_COUNT; ++i)
+    {
+        gpio_input_stats_t stats;
+        gpio_input_get_stats(pins[i].gpio_num, &stats);
+        report->isr_calls += host_gpio_isr_calls(pins[i].gpio_num);
+        report->storms += stats.storms;
+        report->glitches += stats.glitches;
+    }
+}
+
+static bool metric_value(const report_t *report, const char *metric, long long *value)
+{
+    const struct
+    {
+        const char *name;
+        long long value;
+    } metrics[] = {
+        {"events", report->events},
+        {"long_events", report->long_events},
+        {"missed", report->missed},
+        {"spurious", report->spurious},
+        {"max_latency_us", report->max_latency_us},
+        {"isr_calls", report->isr_calls},
+        {"storms", report->storms},
+        {"glitches", report->glitches},
+    };
+    for (size_t i = 0; i < sizeof(metrics) / sizeof(metrics[0]); ++i)
+    {
+        if (strcmp(metrics[i].name, metric) == 0)
+        {
+            *value = metrics[i].value;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool check_expectations(const char *path, const report_t *report)
+{
+    bool ok = true;
+    for (int i = 0; i < expect_count; ++i)
+    {
+        const expect_t *expect = &expects[i];
+        long long value;
+        bool passed;
+        if (!metric_value(report, expect->metric, &value))
+        {
+            fprintf(stderr, "%s:%d: unknown metric %s\n", path, expect->line, expect->metric);
+            ok = false;
+            continue;
+        }
+        if (strcmp(expect->op, "==") == 0)
+        {
+            passed = value == expect->value;
+        }
+        else if (strcmp(expect->op, "<=") == 0)
+        {
+            passed = value <= expect->value;
+        }
+        else if (strcmp(expect->op, ">=") == 0)
+        {
+            passed = value >= expect->value;
+        }
+        else
+        {
+            fprintf(stderr, "%s:%d: unknown operator %s\n", path, expect->line, expect->op);
+            ok = false;
+            continue;
+        }
+        if (!passed)
+        {
+            fprintf(stderr, "%s:%d: expected %s %s %lld, got %lld\n", path, expect->line, expect->metric,
+                    expect->op, expect->value, value);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+static void print_report(const char *path, const report_t *report)
+{
+    printf("%s: %d level changes, %d presses\n", path, change_count, press_count);
+    printf("  events         %lld (+%lld long)\n", report->events, report->long_events);
+    printf("  missed         %lld\n", report->missed);
+    printf("  spurious       %lld\n", report->spurious);
+    printf("  latency        max %lld us, mean %lld us (final edge to callback)\n", report->max_latency_us,
+           report->events > 0 ? report->total_latency_us / report->events : 0);
+    printf("  isr calls      %lld\n", report->isr_calls);
+    printf("  storms         %lld\n", report->storms);
+    printf("  glitches       %lld\n", report->glitches);
+    for (int i = 0; i < PIN_COUNT; ++i)
+    {
+        gpio_input_stats_t stats;
+        gpio_input_get_stats(pins[i].gpio_num, &stats);
+        printf("  gpio %-2d        %lu edges, %lu events, %lu glitches, %lu storms, max latency %lu us\n",
+               pins[i].gpio_num, (unsigned long)stats.edges, (unsigned long)stats.events,
+               (unsigned long)stats.glitches, (unsigned long)stats.storms, (unsigned long)stats.max_latency_us);
+    }
+}
+
+static bool replay(const char *path)
+{
+    if (!parse_trace(path))
+    {
+        return false;
+    }
+    if (app_loop_init() != ESP_OK || gpio_debounce_input_init(input_callback) != ESP_OK)
+    {
+        fprintf(stderr, "%s: can't initialize the inputs\n", path);
+        return false;
+    }
+
+    for (int i = 0; i < change_count; ++i)
+    {
+        host_loop_run_until(changes[i].time_us);
+        host_gpio_set_level(changes[i].gpio_num, changes[i].level);
+    }
+    host_loop_run_until((change_count > 0 ? changes[change_count - 1].time_us : 0) + REPLAY_TAIL_US);
+
+    report_t report = {0};
+    evaluate(&report);
+    print_report(path, &report);
+    return check_expectations(path, &report);
+}
+
+int main(int argc, char *argv[])
+{
+    // the inputs can only be initialized once, so every trace needs its own process
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: input_replay <trace>\n");
+        return 2;
+    }
+    return replay(argv[1]) ? 0 : 1;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+/* section attributes as ESP-IDF defines them, used instead of stubs/esp_attr.h for the linker map of iram/ */
+#define IRAM_ATTR_STR_(x) #x
+#define IRAM_ATTR_STR(x) IRAM_ATTR_STR_(x)
+#define IRAM_ATTR __attribute__((section(".iram1." IRAM_ATTR_STR(__COUNTER__))))
+#define DRAM_ATTR __attribute__((section(".dram1." IRAM_ATTR_STR(__COUNTER__))))
+#define FORCE_INLINE_ATTR static inline __attribute__((always_inline))
@@ -0,0 +1,141 @@
+/*
+ * The app loop task on simulated time. Passes are run by app_loop_run_pass() from main/app_loop_dispatch.c,
+ * the same code as on the target, only the task, its notifications and its wake timer are replaced by
+ * host_loop_run_until().
+ */
+
+#include "app_loop.h"
+#include "host_sim.h"
+
+extern int64_t host_sim_now_us;
+
+static uint32_t pending_signals = 0;
+static uint32_t passes = 0;
+static struct host_task_t
+{
+    int unused;
+} loop_task;
+
+TaskHandle_t app_loop_task_handle = NULL;
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t *woken)
+{
+    (void)task;
+    (void)action;
+    pending_signals |= value;
+    if (woken != NULL)
+    {
+        *woken = pdTRUE;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    return xTaskNotifyFromISR(task, value, action, NULL);
+}
+
+/* everything runs on the loop's thread */
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return app_loop_task_handle;
+}
+
+TaskHandle_t xTaskCreateStatic(void (*function)(void *), const char *name, uint32_t stack_size, void *arg,
+                               UBaseType_t priority, StackType_t *stack, StaticTask_t *buffer)
+{
+    (void)function;
+    (void)name;
+    (void)stack_size;
+    (void)arg;
+    (void)priority;
+    (void)stack;
+    (void)buffer;
+    return NULL;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t timeout)
+{
+    (void)clear;
+    (void)timeout;
+    return 0;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    (void)task;
+    return pdPASS;
+}
+
+static void run_pass(uint32_t signals)
+{
+    passes++;
+    app_loop_run_pass(signals);
+}
+
+void host_loop_run_until(int64_t until_us)
+{
+    for (;;)
+    {
+        if (pending_signals != 0)
+        {
+            uint32_t signals = pending_signals;
+            pending_signals = 0;
+            run_pass(signals);
+            continue;
+        }
+        int64_t deadline_us = app_loop_next_deadline();
+        if (deadline_us > until_us)
+        {
+            break;
+        }
+        // the wake timer expires
+        if (deadline_us > host_sim_now_us)
+        {
+            host_sim_now_us = deadline_us;
+        }
+        run_pass(1UL << APP_LOOP_SIGNAL_WAKE);
+    }
+    if (until_us > host_sim_now_us)
+    {
+        host_sim_now_us = until_us;
+    }
+}
+
+uint32_t host_loop_passes(void)
+{
+    return passes;
+}
+
+int64_t host_loop_next_deadline(void)
+{
+    return app_loop_next_deadline();
+}
+
+esp_err_t app_loop_init(void)
+{
+    if (app_loop_task_handle != NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    app_loop_task_handle = &loop_task;
+    return ESP_OK;
+}
+
+void app_loop_signal(app_loop_signal_t signal)
+{
+    if (app_loop_task_handle != NULL)
+    {
+        pending_signals |= 1UL << signal;
+    }
+}
+
+uint32_t app_loop_get_stack_high_water_mark(void)
+{
+    return 0;
+}
+
+void app_loop_log_stack(const char *where)
+{
+    (void)where;
+}
@@ -0,0 +1,106 @@
+#include "host_sim.h"
+
+#include <string.h>
+
+#include "nvs.h"
+
+#define HOST_NVS_ENTRIES 16
+#define HOST_NVS_NAME_LENGTH 16
+
+typedef struct host_nvs_entry_t
+{
+    char namespace_name[HOST_NVS_NAME_LENGTH];
+    char key[HOST_NVS_NAME_LENGTH];
+    uint16_t value;
+} host_nvs_entry_t;
+
+/* a handle is the index of its namespace in namespaces + 1 */
+static char namespaces[HOST_NVS_ENTRIES][HOST_NVS_NAME_LENGTH];
+static int namespace_count = 0;
+static host_nvs_entry_t entries[HOST_NVS_ENTRIES];
+static int entry_count = 0;
+
+void host_nvs_erase(void)
+{
+    namespace_count = 0;
+    entry_count = 0;
+}
+
+static host_nvs_entry_t *find_entry(nvs_handle_t handle, const char *key)
+{
+    for (int i = 0; i < entry_count; ++i)
+    {
+        if (strcmp(entries[i].namespace_name, namespaces[handle - 1]) == 0 && strcmp(entries[i].key, key) == 0)
+        {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (strlen(namespace_name) >= HOST_NVS_NAME_LENGTH)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < namespace_count; ++i)
+    {
+        if (strcmp(namespaces[i], namespace_name) == 0)
+        {
+            *out_handle = i + 1;
+            return ESP_OK;
+        }
+    }
+    // like on the target, a namespace only exists once something was written to it
+    if (open_mode == NVS_READONLY)
+    {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (namespace_count == HOST_NVS_ENTRIES)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    strcpy(namespaces[namespace_count], namespace_name);
+    *out_handle = ++namespace_count;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_u16(nvs_handle_t handle, const char *key, uint16_t *out_value)
+{
+    host_nvs_entry_t *entry = find_entry(handle, key);
+    if (entry == NULL)
+    {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *out_value = entry->value;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u16(nvs_handle_t handle, const char *key, uint16_t value)
+{
+    host_nvs_entry_t *entry = find_entry(handle, key);
+    if (entry == NULL)
+    {
+        if (entry_count == HOST_NVS_ENTRIES || strlen(key) >= HOST_NVS_NAME_LENGTH)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+        entry = &entries[entry_count++];
+        strcpy(entry->namespace_name, namespaces[handle - 1]);
+        strcpy(entry->key, key);
+    }
+    entry->value = value;
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    (void)handle;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    (void)handle;
+}
@@ -0,0 +1,244 @@
+#include "host_sim.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "soc/gpio_struct.h"
+#include "soc/soc.h"
+
+typedef struct host_pin_t
+{
+    int level;
+    gpio_int_type_t intr_type;
+    bool intr_enabled;
+    gpio_isr_t isr;
+    void *isr_arg;
+    uint32_t isr_calls;
+    uint32_t output_pulses;
+} host_pin_t;
+
+gpio_dev_t GPIO;
+
+/* shared with host_app_loop.c, which advances it */
+int64_t host_sim_now_us = 0;
+
+static host_pin_t pins[HOST_GPIO_COUNT];
+static host_gpio_output_hook output_hook = NULL;
+static uint32_t set_level_failures = 0;
+
+int64_t host_now_us(void)
+{
+    return host_sim_now_us;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return host_sim_now_us;
+}
+
+void host_log(char level, const char *tag, const char *format, ...)
+{
+    if (getenv("HOST_TEST_LOG") == NULL)
+    {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%c %lld %s: ", level, (long long)host_sim_now_us, tag);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    (void)level;
+    (void)tag;
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t)(host_sim_now_us / 1000);
+}
+
+static bool valid_pin(int gpio_num)
+{
+    return gpio_num >= 0 && gpio_num < HOST_GPIO_COUNT;
+}
+
+static bool raises_interrupt(const host_pin_t *pin, int previous_level)
+{
+    switch (pin->intr_type)
+    {
+    case GPIO_INTR_POSEDGE:
+        return previous_level == 0 && pin->level == 1;
+    case GPIO_INTR_NEGEDGE:
+        return previous_level == 1 && pin->level == 0;
+    case GPIO_INTR_ANYEDGE:
+        return previous_level != pin->level;
+    case GPIO_INTR_LOW_LEVEL:
+        return pin->level == 0;
+    case GPIO_INTR_HIGH_LEVEL:
+        return pin->level == 1;
+    default:
+        return false;
+    }
+}
+
+void host_gpio_set_level(int gpio_num, int level)
+{
+    if (!valid_pin(gpio_num))
+    {
+        return;
+    }
+    host_pin_t *pin = &pins[gpio_num];
+    int previous_level = pin->level;
+    pin->level = level ? 1 : 0;
+    if (pin->intr_enabled && pin->isr != NULL && raises_interrupt(pin, previous_level))
+    {
+        pin->isr_calls++;
+        pin->isr(pin->isr_arg);
+    }
+}
+
+int host_gpio_get_level(int gpio_num)
+{
+    return valid_pin(gpio_num) ? pins[gpio_num].level : 0;
+}
+
+void host_gpio_set_intr_type(int gpio_num, gpio_int_type_t intr_type)
+{
+    if (valid_pin(gpio_num))
+    {
+        pins[gpio_num].intr_type = intr_type;
+    }
+}
+
+void host_gpio_set_intr_enabled(int gpio_num, int enabled)
+{
+    if (valid_pin(gpio_num))
+    {
+        pins[gpio_num].intr_enabled = enabled != 0;
+    }
+}
+
+uint32_t host_gpio_isr_calls(int gpio_num)
+{
+    return valid_pin(gpio_num) ? pins[gpio_num].isr_calls : 0;
+}
+
+uint32_t host_gpio_output_pulses(int gpio_num)
+{
+    return valid_pin(gpio_num) ? pins[gpio_num].output_pulses : 0;
+}
+
+void host_gpio_set_output_hook(host_gpio_output_hook hook)
+{
+    output_hook = hook;
+}
+
+void host_gpio_fail_set_level(uint32_t count)
+{
+    set_level_failures = count;
+}
+
+uint32_t host_reg_read(uint32_t reg)
+{
+    (void)reg;
+    uint32_t value = 0;
+    for (int i = 0; i < 32; ++i)
+    {
+        value |= (uint32_t)pins[i].level << i;
+    }
+    return value;
+}
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    for (int i = 0; i < HOST_GPIO_COUNT; ++i)
+    {
+        if (config->pin_bit_mask & (1ULL << i))
+        {
+            // inputs idle high through their pull-up
+            if (config->mode == GPIO_MODE_INPUT && config->pull_up_en)
+            {
+                pins[i].level = 1;
+            }
+            pins[i].intr_type = config->intr_type;
+            pins[i].intr_enabled = config->intr_type != GPIO_INTR_DISABLE;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (!valid_pin(gpio_num))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (set_level_failures > 0)
+    {
+        set_level_failures--;
+        return ESP_FAIL;
+    }
+    host_pin_t *pin = &pins[gpio_num];
+    if (level && !pin->level)
+    {
+        pin->output_pulses++;
+    }
+    pin->level = level ? 1 : 0;
+    if (output_hook != NULL)
+    {
+        output_hook(gpio_num, pin->level);
+    }
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    return host_gpio_get_level(gpio_num);
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    (void)intr_alloc_flags;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    if (!valid_pin(gpio_num))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pins[gpio_num].isr = isr_handler;
+    pins[gpio_num].isr_arg = args;
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num)
+{
+    host_gpio_set_intr_enabled(gpio_num, 1);
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio_num)
+{
+    host_gpio_set_intr_enabled(gpio_num, 0);
+    return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_enable(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    host_gpio_set_intr_type(gpio_num, intr_type);
+    return ESP_OK;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+/*
+ * Simulated time, pins and app loop for the host tests. Firmware modules are compiled unchanged
+ * against the headers in test/host/stubs, which route all hardware and OS access to this simulation.
+ * Everything runs on the test's thread: the ISR of a pin runs inside host_gpio_set_level() and the app loop
+ * runs inside host_loop_run_until(), just as if the loop task had been woken on the target.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define HOST_GPIO_COUNT 64
+
+    /* current simulated time, what esp_timer_get_time() returns */
+    int64_t host_now_us(void);
+
+    /* drive the input @p gpio_num to @p level at the current time, runs its ISR if the edge raises an interrupt */
+    void host_gpio_set_level(int gpio_num, int level);
+    /* level of an input or output */
+    int host_gpio_get_level(int gpio_num);
+    /* ISR invocations of @p gpio_num so far */
+    uint32_t host_gpio_isr_calls(int gpio_num);
+    /* rising edges written to the output @p gpio_num with gpio_set_level */
+    uint32_t host_gpio_output_pulses(int gpio_num);
+    /* called for every gpio_set_level, e.g. to let a simulated device react to an output */
+    typedef void (*host_gpio_output_hook)(int gpio_num, int level);
+    void host_gpio_set_output_hook(host_gpio_output_hook hook);
+    /* lets the next @p count gpio_set_level calls fail */
+    void host_gpio_fail_set_level(uint32_t count);
+
+    /* forget everything written to the host NVS */
+    void host_nvs_erase(void);
+
+    /* run the app loop and advance time to @p until_us, every raised signal and due timer is handled on the way */
+    void host_loop_run_until(int64_t until_us);
+    /* passes the app loop made, every pass is one wake up of the loop task on the target */
+    uint32_t host_loop_passes(void);
+    /* deadline of the earliest app loop timer, INT64_MAX if none is active */
+    int64_t host_loop_next_deadline(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
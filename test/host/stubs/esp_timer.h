@@ -0,0 +1,7 @@
+#pragma once
+
+/* the host tests run on simulated time, see host_sim.h */
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
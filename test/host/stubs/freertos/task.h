@@ -0,0 +1,24 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_task_t *TaskHandle_t;
+
+typedef enum eNotifyAction
+{
+    eNoAction = 0,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+    eSetValueWithoutOverwrite,
+} eNotifyAction;
+
+/* every notification goes to the simulated app loop */
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t *woken);
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+/* the host has no other tasks: creating one fails, nothing waits for a notification */
+TaskHandle_t xTaskCreateStatic(void (*function)(void *), const char *name, uint32_t stack_size, void *arg,
+                               UBaseType_t priority, StackType_t *stack, StaticTask_t *buffer);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t timeout);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
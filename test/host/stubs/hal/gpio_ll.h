@@ -0,0 +1,28 @@
+#pragma once
+
+/* host stand-in for the register level gpio functions the input shim uses */
+
+#include "driver/gpio.h"
+#include "soc/gpio_struct.h"
+
+int host_gpio_get_level(int gpio_num);
+void host_gpio_set_intr_type(int gpio_num, gpio_int_type_t intr_type);
+void host_gpio_set_intr_enabled(int gpio_num, int enabled);
+
+static inline int gpio_ll_get_level(gpio_dev_t *hw, uint32_t gpio_num)
+{
+    (void)hw;
+    return host_gpio_get_level((int)gpio_num);
+}
+
+static inline void gpio_ll_set_intr_type(gpio_dev_t *hw, uint32_t gpio_num, gpio_int_type_t intr_type)
+{
+    (void)hw;
+    host_gpio_set_intr_type((int)gpio_num, intr_type);
+}
+
+static inline void gpio_ll_intr_disable(gpio_dev_t *hw, uint32_t gpio_num)
+{
+    (void)hw;
+    host_gpio_set_intr_enabled((int)gpio_num, 0);
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+/* the simulator returns the levels of gpio 0 - 31 for this register */
+#define GPIO_IN_REG 0x6009103C
@@ -0,0 +1,9 @@
+#pragma once
+
+/* the register block only identifies the simulated gpio matrix */
+typedef struct gpio_dev_t
+{
+    int unused;
+} gpio_dev_t;
+
+extern gpio_dev_t GPIO;
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+
+uint32_t host_reg_read(uint32_t reg);
+
+#define REG_READ(reg) host_reg_read(reg)
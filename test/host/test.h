@@ -0,0 +1,43 @@
+#pragma once
+
+/*
+ * Minimal checks for the host tests: a failed check prints its location and the test continues,
+ * TEST_RESULT() turns the number of failures into the exit code ctest looks at.
+ */
+
+#include <stdio.h>
+
+static int test_failures = 0;
+
+#define CHECK(cond)                                                                   \
+    do                                                                                \
+    {                                                                                 \
+        if (!(cond))                                                                  \
+        {                                                                             \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++;                                                          \
+        }                                                                             \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                              \
+    do                                                                                          \
+    {                                                                                           \
+        long long actual_ = (long long)(actual);                                                \
+        long long expected_ = (long long)(expected);                                            \
+        if (actual_ != expected_)                                                               \
+        {                                                                                       \
+            fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, \
+                    actual_, expected_);                                                        \
+            test_failures++;                                                                    \
+        }                                                                                       \
+    } while (0)
+
+#define RUN_TEST(fn)                                                                       \
+    do                                                                                     \
+    {                                                                                      \
+        int failures_before_ = test_failures;                                              \
+        fn();                                                                              \
+        printf("%s %s\n", test_failures == failures_before_ ? "PASS" : "FAIL", #fn);      \
+    } while (0)
+
+#define TEST_RESULT() (test_failures == 0 ? 0 : 1)
@@ -0,0 +1,175 @@
+/*
+ * debounce_fsm.c: exact detection times for clean presses, bounce, glitches, long presses and repeats.
+ */
+
+#include "debounce_fsm.h"
+#include "test.h"
+
+#define DEBOUNCE_US 30000
+#define LONG_PRESS_US 2000000
+#define REPEAT_US 500000
+#define T0 1000000
+
+static const gpio_input_timing_profile_t button = {
+    .debounce_us = DEBOUNCE_US,
+    .long_press_us = LONG_PRESS_US,
+    .repeat_us = 0,
+};
+
+static const gpio_input_timing_profile_t repeating = {
+    .debounce_us = DEBOUNCE_US,
+    .long_press_us = LONG_PRESS_US,
+    .repeat_us = REPEAT_US,
+};
+
+/* runs the state machine at @p now_us, returns the single event or -1 */
+static int update_once(debounce_fsm_t *fsm, int64_t now_us)
+{
+    gpio_input_state_t event;
+    if (!debounce_fsm_update(fsm, now_us, &event))
+    {
+        return -1;
+    }
+    return event;
+}
+
+static void test_initial_level_is_quiet(void)
+{
+    debounce_fsm_t fsm;
+    debounce_fsm_init(&fsm, &button, 1, T0);
+    CHECK_EQ(debounce_fsm_next_deadline(&fsm), DEBOUNCE_FSM_NO_DEADLINE);
+    CHECK_EQ(update_once(&fsm, T0 + 10LL * LONG_PRESS_US), -1);
+}
+
+static void test_clean_press_exact_latency(void)
+{
+    debounce_fsm_t fsm;
+    debounce_fsm_init(&fsm, &button, 1, T0);
+    debounce_fsm_edge(&fsm, 0, T0 + 100);
+    CHECK_EQ(debounce_fsm_next_deadline(&fsm), T0 + 100 + DEBOUNCE_US);
+    CHECK_EQ(update_once(&fsm, T0 + 100 + DEBOUNCE_US - 1), -1);
+    CHECK_EQ(update_once(&fsm, T0 + 100 + DEBOUNCE_US), ON);
+    CHECK_EQ(update_once(&fsm, T0 + 100 + DEBOUNCE_US), -1);
+
+    // the long press is timed from the edge, not from the report
+    CHECK_EQ(debounce_fsm_next_deadline(&fsm), T0 + 100 + LONG_PRESS_US);
+    CHECK_EQ(update_once(&fsm, T0 + 100 + LONG_PRESS_US - 1), -1);
+    CHECK_EQ(update_once(&fsm, T0 + 100 + LONG_PRESS_US), ON_LONG);
+    // reported once without a repeat interval
+    CHECK_EQ(debounce_fsm_next_deadline(&fsm), DEBOUNCE_FSM_NO_DEADLINE);
+    CHECK_EQ(update_once(&fsm, T0 + 10LL * LONG_PRESS_US), -1);
+
+    debounce_fsm_edge(&fsm, 1, T0 + 3000000);
+    CHECK_EQ(update_once(&fsm, T0 + 3000000 + DEBOUNCE_US), OFF);
+    CHECK_EQ(update_once(&fsm, T0 + 3000000 + LONG_PRESS_US), OFF_LONG);
+}
+
+static void test_bounce_restarts_debounce(void)
+{
+    debounce_fsm_t fsm;
+    debounce_fsm_init(&fsm, &button, 1, T0);
+    int64_t t = T0;
+    for (int i = 0; i < 9; ++i)
+    {
+        t += 700;
+        debounce_fsm_edge(&fsm, i % 2 == 0 ? 0 : 1, t);
+        CHECK_EQ(update_once(&fsm, t), -1);
+    }
+    // the final edge left the pin low
+    CHECK_EQ(debounce_fsm_next_deadline(&fsm), t + DEBOUNCE_US);
+    CHECK_EQ(update_once(&fsm, t + DEBOUNCE_US - 1), -1);
+    CHECK_EQ(update_once(&fsm, t + DEBOUNCE_US), ON);
+    CHECK_EQ(fsm.glitch_count, 0);
+}
+
+static void test_glitch_is_counted_not_reported(void)
+{
+    debounce_fsm_t fsm;
+    debounce_fsm_init(&fsm, &button, 1, T0);
+    debounce_fsm_edge(&fsm, 0, T0 + 1000);
+    debounce_fsm_edge(&fsm, 1, T0 + 6000);
+    CHECK_EQ(update_once(&fsm, T0 + 6000 + DEBOUNCE_US), -1);
+    CHECK_EQ(fsm.glitch_count, 1);
+    CHECK_EQ(debounce_fsm_next_deadline(&fsm), DEBOUNCE_FSM_NO_DEADLINE);
+}
+
+static void test_glitch_while_held_restarts_long_press(void)
+{
+    debounce_fsm_t fsm;
+    debounce_fsm_init(&fsm, &button, 1, T0);
+    debounce_fsm_edge(&fsm, 0, T0);
+    CHECK_EQ(update_once(&fsm, T0 + DEBOUNCE_US), ON);
+
+    // a short release while held counts as glitch, the hold is timed from its last edge
+    debounce_fsm_edge(&fsm, 1, T0 + 500000);
+    debounce_fsm_edge(&fsm, 0, T0 + 502000);
+    CHECK_EQ(update_once(&fsm, T0 + 502000 + DEBOUNCE_US), -1);
+    CHECK_EQ(fsm.glitch_count, 1);
+    CHECK_EQ(update_once(&fsm, T0 + LONG_PRESS_US), -1);
+    CHECK_EQ(update_once(&fsm, T0 + 502000 + LONG_PRESS_US), ON_LONG);
+}
+
+static void test_repeat_interval(void)
+{
+    debounce_fsm_t fsm;
+    debounce_fsm_init(&fsm, &repeating, 1, T0);
+    debounce_fsm_edge(&fsm, 0, T0);
+    CHECK_EQ(update_once(&fsm, T0 + DEBOUNCE_US), ON);
+    CHECK_EQ(update_once(&fsm, T0 + LONG_PRESS_US), ON_LONG);
+    for (int i = 1; i <= 3; ++i)
+    {
+        int64_t due = T0 + LONG_PRESS_US + i * (int64_t)REPEAT_US;
+        CHECK_EQ(debounce_fsm_next_deadline(&fsm), due);
+        CHECK_EQ(update_once(&fsm, due - 1), -1);
+        CHECK_EQ(update_once(&fsm, due), ON_LONG);
+    }
+    // releasing ends the repetition
+    debounce_fsm_edge(&fsm, 1, T0 + 4000000);
+    CHECK_EQ(update_once(&fsm, T0 + 4000000 + DEBOUNCE_US), OFF);
+}
+
+static void test_late_update_reports_in_order(void)
+{
+    // a loop that runs late still reports every state, one per call
+    debounce_fsm_t fsm;
+    debounce_fsm_init(&fsm, &button, 1, T0);
+    debounce_fsm_edge(&fsm, 0, T0);
+    int64_t late = T0 + 3LL * LONG_PRESS_US;
+    CHECK_EQ(update_once(&fsm, late), ON);
+    CHECK_EQ(update_once(&fsm, late), ON_LONG);
+    CHECK_EQ(update_once(&fsm, late), -1);
+}
+
+static void test_settled_level_is_reported_immediately(void)
+{
+    debounce_fsm_t fsm;
+    debounce_fsm_init(&fsm, &button, 1, T0);
+    debounce_fsm_settled(&fsm, 0, T0 + 5000);
+    CHECK_EQ(debounce_fsm_next_deadline(&fsm), T0 + 5000);
+    CHECK_EQ(update_once(&fsm, T0 + 5000), ON);
+    CHECK_EQ(update_once(&fsm, T0 + 5000 + LONG_PRESS_US), ON_LONG);
+}
+
+static void test_long_press_disabled(void)
+{
+    const gpio_input_timing_profile_t no_long = {.debounce_us = DEBOUNCE_US};
+    debounce_fsm_t fsm;
+    debounce_fsm_init(&fsm, &no_long, 1, T0);
+    debounce_fsm_edge(&fsm, 0, T0);
+    CHECK_EQ(update_once(&fsm, T0 + DEBOUNCE_US), ON);
+    CHECK_EQ(debounce_fsm_next_deadline(&fsm), DEBOUNCE_FSM_NO_DEADLINE);
+}
+
+int main(void)
+{
+    RUN_TEST(test_initial_level_is_quiet);
+    RUN_TEST(test_clean_press_exact_latency);
+    RUN_TEST(test_bounce_restarts_debounce);
+    RUN_TEST(test_glitch_is_counted_not_reported);
+    RUN_TEST(test_glitch_while_held_restarts_long_press);
+    RUN_TEST(test_repeat_interval);
+    RUN_TEST(test_late_update_reports_in_order);
+    RUN_TEST(test_settled_level_is_reported_immediately);
+    RUN_TEST(test_long_press_disabled);
+    return TEST_RESULT();
+}
@@ -0,0 +1,181 @@
+/*
+ * edge_ring.h: FIFO order, exact overflow accounting and no torn or lost events,
+ * first with random schedules of producer and consumer steps, then with a real producer thread.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+
+#include "edge_ring.h"
+#include "test.h"
+
+#define HAMMER_EVENTS 500000
+
+static edge_ring_t ring;
+
+/* every event carries its sequence number in all fields, a torn copy doesn't match up */
+static edge_event_t make_event(uint32_t sequence)
+{
+    return (edge_event_t){
+        .input_index = (uint8_t)sequence,
+        .level = (uint8_t)(sequence >> 8),
+        .timestamp = ((int64_t)sequence << 32) | sequence,
+    };
+}
+
+static bool event_is_consistent(const edge_event_t *event, uint32_t *sequence)
+{
+    *sequence = (uint32_t)event->timestamp;
+    return (uint32_t)(event->timestamp >> 32) == *sequence && event->input_index == (uint8_t)*sequence &&
+           event->level == (uint8_t)(*sequence >> 8);
+}
+
+static void test_empty_and_full(void)
+{
+    edge_ring_init(&ring);
+    edge_event_t event;
+    CHECK(!edge_ring_pop(&ring, &event));
+
+    for (uint32_t i = 0; i < EDGE_RING_SIZE; ++i)
+    {
+        edge_event_t pushed = make_event(i);
+        CHECK(edge_ring_push(&ring, &pushed));
+    }
+    edge_event_t extra = make_event(EDGE_RING_SIZE);
+    CHECK(!edge_ring_push(&ring, &extra));
+    CHECK(!edge_ring_push(&ring, &extra));
+    CHECK_EQ(edge_ring_overflow_count(&ring), 2);
+
+    for (uint32_t i = 0; i < EDGE_RING_SIZE; ++i)
+    {
+        uint32_t sequence;
+        CHECK(edge_ring_pop(&ring, &event));
+        CHECK(event_is_consistent(&event, &sequence));
+        CHECK_EQ(sequence, i);
+    }
+    CHECK(!edge_ring_pop(&ring, &event));
+}
+
+static void test_random_interleavings(void)
+{
+    // the indices run freely, start close to the wrap around of unsigned int
+    srand(1);
+    for (int schedule = 0; schedule < 200; ++schedule)
+    {
+        edge_ring_init(&ring);
+        unsigned int start = UINT32_MAX - (unsigned int)(rand() % (4 * EDGE_RING_SIZE));
+        atomic_store(&ring.head, start);
+        atomic_store(&ring.tail, start);
+
+        uint32_t pushed = 0;
+        uint32_t dropped = 0;
+        uint32_t next_expected = 0;
+        for (int step = 0; step < 2000; ++step)
+        {
+            // bursts on either side, like bouncing contacts against a busy loop
+            int burst = rand() % (EDGE_RING_SIZE + 8);
+            if (rand() & 1)
+            {
+                for (int i = 0; i < burst; ++i)
+                {
+                    edge_event_t event = make_event(pushed);
+                    if (edge_ring_push(&ring, &event))
+                    {
+                        pushed++;
+                    }
+                    else
+                    {
+                        dropped++;
+                    }
+                }
+            }
+            else
+            {
+                edge_event_t event;
+                for (int i = 0; i < burst && edge_ring_pop(&ring, &event); ++i)
+                {
+                    uint32_t sequence;
+                    CHECK(event_is_consistent(&event, &sequence));
+                    CHECK_EQ(sequence, next_expected);
+                    next_expected = sequence + 1;
+                }
+            }
+            CHECK(atomic_load(&ring.head) - atomic_load(&ring.tail) <= EDGE_RING_SIZE);
+        }
+        edge_event_t event;
+        while (edge_ring_pop(&ring, &event))
+        {
+            uint32_t sequence;
+            CHECK(event_is_consistent(&event, &sequence));
+            CHECK_EQ(sequence, next_expected);
+            next_expected = sequence + 1;
+        }
+        CHECK_EQ(next_expected, pushed);
+        CHECK_EQ(edge_ring_overflow_count(&ring), dropped);
+    }
+}
+
+static void *producer(void *arg)
+{
+    uint32_t *rejected = arg;
+    for (uint32_t sequence = 0; sequence < HAMMER_EVENTS; ++sequence)
+    {
+        // a full ring is retried, so every event arrives and each rejection has to show up as overflow
+        edge_event_t event = make_event(sequence);
+        while (!edge_ring_push(&ring, &event))
+        {
+            (*rejected)++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void test_producer_thread(void)
+{
+    edge_ring_init(&ring);
+    uint32_t rejected = 0;
+    pthread_t thread;
+    CHECK_EQ(pthread_create(&thread, NULL, producer, &rejected), 0);
+
+    uint32_t received = 0;
+    uint32_t torn = 0;
+    uint32_t out_of_order = 0;
+    while (received < HAMMER_EVENTS)
+    {
+        edge_event_t event;
+        if (!edge_ring_pop(&ring, &event))
+        {
+            // lets the producer run on single core machines
+            sched_yield();
+            continue;
+        }
+        uint32_t sequence;
+        if (!event_is_consistent(&event, &sequence))
+        {
+            torn++;
+        }
+        if (sequence != received)
+        {
+            out_of_order++;
+        }
+        received++;
+    }
+    pthread_join(thread, NULL);
+
+    edge_event_t event;
+    CHECK(!edge_ring_pop(&ring, &event));
+    CHECK_EQ(torn, 0);
+    CHECK_EQ(out_of_order, 0);
+    CHECK_EQ(edge_ring_overflow_count(&ring), rejected);
+    printf("edge ring: %u events passed between two threads, %u pushes rejected as overflow\n", received, rejected);
+}
+
+int main(void)
+{
+    RUN_TEST(test_empty_and_full);
+    RUN_TEST(test_random_interleavings);
+    RUN_TEST(test_producer_thread);
+    return TEST_RESULT();
+}
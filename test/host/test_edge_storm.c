@@ -0,0 +1,240 @@
+/*
+ * Interrupt storm protection: the edge-rate detector of edge_storm.h on its own, and gpio_input.c masking a
+ * noisy pin, polling it and giving the interrupt back once it is quiet, driven with synthetic storms.
+ */
+
+#include "app_loop.h"
+#include "edge_storm.h"
+#include "gpio_input.h"
+#include "host_sim.h"
+#include "test.h"
+
+#define BUTTON GPIO_NUM_9
+#define BUTTON_DEBOUNCE_US (30 * 1000)
+#define FLOATING GPIO_NUM_21
+
+static int button_events = 0;
+static int64_t button_event_us = 0;
+
+static void input_callback(int gpio_num, gpio_input_state_t state)
+{
+    if (gpio_num == BUTTON && (state == ON || state == OFF))
+    {
+        button_events++;
+        button_event_us = host_now_us();
+    }
+}
+
+static void advance(int64_t us)
+{
+    host_loop_run_until(host_now_us() + us);
+}
+
+static uint32_t random_state = 12345;
+
+static uint32_t random_word(void)
+{
+    random_state = random_state * 1664525u + 1013904223u;
+    return random_state >> 8;
+}
+
+/**
+ * Toggles @p gpio_num every @p period_us on average for @p duration_us, ends on @p final_level.
+ * The intervals are jittered by +-50 %, a strictly periodic wave could alias with the poll interval.
+ */
+static void noise(int gpio_num, int64_t period_us, int64_t duration_us, int final_level)
+{
+    int64_t end_us = host_now_us() + duration_us;
+    int level = host_gpio_get_level(gpio_num);
+    while (host_now_us() < end_us)
+    {
+        level = !level;
+        host_gpio_set_level(gpio_num, level);
+        advance(period_us / 2 + random_word() % (period_us + 1));
+    }
+    if (level != final_level)
+    {
+        host_gpio_set_level(gpio_num, final_level);
+    }
+}
+
+static bool is_polling(int gpio_num)
+{
+    gpio_input_stats_t stats;
+    gpio_input_get_stats(gpio_num, &stats);
+    return stats.storm_polling;
+}
+
+static void test_detector_threshold_and_window(void)
+{
+    edge_storm_t storm;
+    edge_storm_init(&storm, 0);
+
+    for (int i = 0; i < EDGE_STORM_MAX_EDGES; ++i)
+    {
+        CHECK(!edge_storm_isr_edge(&storm, i * 100));
+    }
+    CHECK(!edge_storm_begin_polling(&storm, 1, 10000));
+    CHECK(edge_storm_isr_edge(&storm, EDGE_STORM_MAX_EDGES * 100));
+
+    // a new window starts the count over, the same number of edges spread over two windows is fine
+    edge_storm_t slow;
+    edge_storm_init(&slow, 0);
+    for (int i = 0; i < EDGE_STORM_MAX_EDGES; ++i)
+    {
+        CHECK(!edge_storm_isr_edge(&slow, i * 100));
+    }
+    for (int i = 0; i < EDGE_STORM_MAX_EDGES; ++i)
+    {
+        CHECK(!edge_storm_isr_edge(&slow, EDGE_STORM_WINDOW_US + i * 100));
+    }
+}
+
+static void test_detector_polling_until_quiet(void)
+{
+    edge_storm_t storm;
+    edge_storm_init(&storm, 0);
+    for (int i = 0; i <= EDGE_STORM_MAX_EDGES; ++i)
+    {
+        edge_storm_isr_edge(&storm, i);
+    }
+
+    CHECK(edge_storm_begin_polling(&storm, 0, 1000));
+    CHECK(!edge_storm_begin_polling(&storm, 0, 2000));
+    CHECK(storm.polling);
+
+    CHECK(!edge_storm_poll(&storm, 0, 11000));
+    CHECK(edge_storm_poll(&storm, 1, 21000));
+    CHECK(!edge_storm_is_quiet(&storm, 21000 + EDGE_STORM_QUIET_US - 1));
+    CHECK(edge_storm_is_quiet(&storm, 21000 + EDGE_STORM_QUIET_US));
+
+    edge_storm_resume(&storm, 21000 + EDGE_STORM_QUIET_US);
+    CHECK(!storm.polling);
+    CHECK(!atomic_load(&storm.tripped));
+    CHECK_EQ(storm.window_edges, 0);
+    CHECK(!edge_storm_begin_polling(&storm, 1, 21000 + EDGE_STORM_QUIET_US));
+}
+
+static void test_storm_masks_interrupt(void)
+{
+    uint32_t isr_calls = host_gpio_isr_calls(FLOATING);
+    // 10 kHz of edges for a second, the ISR only sees the edges up to the threshold
+    noise(FLOATING, 100, 1000 * 1000, 1);
+
+    gpio_input_stats_t stats;
+    gpio_input_get_stats(FLOATING, &stats);
+    CHECK_EQ(host_gpio_isr_calls(FLOATING) - isr_calls, EDGE_STORM_MAX_EDGES + 1);
+    CHECK_EQ(stats.storms, 1);
+    CHECK(stats.storm_polling);
+}
+
+static void test_quiet_pin_gets_interrupt_back(void)
+{
+    // the samples may have missed the last edges of the noise: hold the pin long enough for a sample to see
+    // its level, then change it once more, this change is seen by the next sample
+    advance(2 * EDGE_STORM_POLL_US);
+    int64_t last_change_us = host_now_us();
+    host_gpio_set_level(FLOATING, !host_gpio_get_level(FLOATING));
+
+    uint32_t passes = host_loop_passes();
+    host_loop_run_until(last_change_us + EDGE_STORM_QUIET_US);
+    CHECK(is_polling(FLOATING));
+    // the pin is sampled every EDGE_STORM_POLL_US meanwhile
+    CHECK(host_loop_passes() - passes >= EDGE_STORM_QUIET_US / EDGE_STORM_POLL_US - 1);
+
+    host_loop_run_until(last_change_us + EDGE_STORM_QUIET_US + EDGE_STORM_POLL_US);
+    CHECK(!is_polling(FLOATING));
+
+    // interrupt driven again: no more polling wake ups, edges reach the ISR
+    passes = host_loop_passes();
+    advance(10LL * 1000 * 1000);
+    CHECK(host_loop_passes() - passes <= 1);
+
+    uint32_t isr_calls = host_gpio_isr_calls(FLOATING);
+    host_gpio_set_level(FLOATING, !host_gpio_get_level(FLOATING));
+    advance(100 * 1000);
+    host_gpio_set_level(FLOATING, !host_gpio_get_level(FLOATING));
+    advance(100 * 1000);
+    CHECK_EQ(host_gpio_isr_calls(FLOATING) - isr_calls, 2);
+}
+
+static void test_noise_during_polling_keeps_it_masked(void)
+{
+    // a burst every half second never lets the pin become quiet
+    noise(FLOATING, 100, 20 * 1000, 1);
+    CHECK(is_polling(FLOATING));
+    uint32_t isr_calls = host_gpio_isr_calls(FLOATING);
+    for (int i = 0; i < 6; ++i)
+    {
+        advance(EDGE_STORM_QUIET_US / 2);
+        noise(FLOATING, 1000, 30 * 1000, i % 2);
+        CHECK(is_polling(FLOATING));
+    }
+    CHECK_EQ(host_gpio_isr_calls(FLOATING), isr_calls);
+
+    advance(EDGE_STORM_QUIET_US + 2 * EDGE_STORM_POLL_US);
+    CHECK(!is_polling(FLOATING));
+    host_gpio_set_level(FLOATING, 1);
+    advance(100 * 1000);
+
+    gpio_input_stats_t stats;
+    gpio_input_get_stats(FLOATING, &stats);
+    CHECK_EQ(stats.storms, 2);
+}
+
+static void test_slow_edges_stay_interrupt_driven(void)
+{
+    gpio_input_stats_t before;
+    gpio_input_get_stats(FLOATING, &before);
+    uint32_t isr_calls = host_gpio_isr_calls(FLOATING);
+
+    // the shortest interval is EDGE_STORM_WINDOW_US / EDGE_STORM_MAX_EDGES, no window sees more edges than allowed
+    noise(FLOATING, 2 * EDGE_STORM_WINDOW_US / EDGE_STORM_MAX_EDGES, 2000 * 1000, 1);
+
+    gpio_input_stats_t after;
+    gpio_input_get_stats(FLOATING, &after);
+    CHECK_EQ(after.storms, before.storms);
+    CHECK(!after.storm_polling);
+    CHECK(host_gpio_isr_calls(FLOATING) - isr_calls >= 400);
+}
+
+static void test_button_works_during_storm(void)
+{
+    button_events = 0;
+    // start a storm, then press the button while the floating pin is polled
+    noise(FLOATING, 100, 20 * 1000, 0);
+    CHECK(is_polling(FLOATING));
+
+    int64_t press_us = host_now_us();
+    host_gpio_set_level(BUTTON, 0);
+    int level = 0;
+    while (host_now_us() < press_us + 200 * 1000)
+    {
+        level = !level;
+        host_gpio_set_level(FLOATING, level);
+        advance(100);
+    }
+    CHECK_EQ(button_events, 1);
+    CHECK_EQ(button_event_us - press_us, BUTTON_DEBOUNCE_US);
+
+    host_gpio_set_level(BUTTON, 1);
+    host_gpio_set_level(FLOATING, 1);
+    advance(3 * EDGE_STORM_QUIET_US);
+    CHECK_EQ(button_events, 2);
+    CHECK(!is_polling(FLOATING));
+}
+
+int main(void)
+{
+    CHECK_EQ(app_loop_init(), ESP_OK);
+    CHECK_EQ(gpio_debounce_input_init(input_callback), ESP_OK);
+
+    RUN_TEST(test_detector_threshold_and_window);
+    RUN_TEST(test_detector_polling_until_quiet);
+    RUN_TEST(test_storm_masks_interrupt);
+    RUN_TEST(test_quiet_pin_gets_interrupt_back);
+    RUN_TEST(test_noise_during_polling_keeps_it_masked);
+    RUN_TEST(test_slow_edges_stay_interrupt_driven);
+    RUN_TEST(test_button_works_during_storm);
+    return TEST_RESULT();
+}
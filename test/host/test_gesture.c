@@ -0,0 +1,305 @@
+/*
+ * gesture.c with a table like the one of the firmware: taps on a button, taps followed by a hold, a hold and
+ * a press count over two LED inputs.
+ */
+
+#include "gesture.h"
+#include "test.h"
+
+#define BUTTON 9
+#define LED_1 19
+#define LED_2 18
+#define GAP_US 400000
+#define HOLD_US 5000000
+#define CALIBRATE_HOLD_US 2000000
+#define TOGGLE_PRESSES 10
+#define TOGGLE_GAP_US 2000000
+
+enum
+{
+    SINGLE = 1,
+    DOUBLE,
+    CALIBRATE,
+    HOLD,
+    TOGGLE_RESET,
+};
+
+static const gesture_def_t table[] = {
+    {.id = SINGLE, .type = GESTURE_MULTI_PRESS, .input_mask = GESTURE_INPUT(BUTTON), .presses = 1, .wait_release = true, .gap_us = GAP_US},
+    {.id = DOUBLE, .type = GESTURE_MULTI_PRESS, .input_mask = GESTURE_INPUT(BUTTON), .presses = 2, .wait_release = true, .gap_us = GAP_US},
+    {.id = CALIBRATE, .type = GESTURE_TAP_HOLD, .input_mask = GESTURE_INPUT(BUTTON), .presses = 3, .gap_us = GAP_US, .hold_us = CALIBRATE_HOLD_US},
+    {.id = HOLD, .type = GESTURE_HOLD, .input_mask = GESTURE_INPUT(BUTTON), .hold_us = HOLD_US},
+    {.id = TOGGLE_RESET, .type = GESTURE_MULTI_PRESS, .input_mask = GESTURE_INPUT(LED_1) | GESTURE_INPUT(LED_2), .presses = TOGGLE_PRESSES, .at_least = true, .gap_us = TOGGLE_GAP_US},
+};
+#define TABLE_SIZE (sizeof(table) / sizeof(table[0]))
+
+static gesture_slot_t slots[TABLE_SIZE];
+static gesture_engine_t engine;
+static int fired[8];
+static int fired_total = 0;
+static int64_t fired_us = 0;
+static int fired_gpio = -1;
+static int64_t now_us = 0;
+
+static void on_gesture(uint8_t id, int gpio_num)
+{
+    fired[id]++;
+    fired_total++;
+    fired_us = now_us;
+    fired_gpio = gpio_num;
+}
+
+static void reset(void)
+{
+    gesture_engine_init(&engine, table, slots, TABLE_SIZE, on_gesture);
+    for (int i = 0; i < 8; ++i)
+    {
+        fired[i] = 0;
+    }
+    fired_total = 0;
+    fired_gpio = -1;
+    now_us = 1000000;
+}
+
+/* runs the engine at every deadline it asks for up to @p until_us, like the app loop timer does */
+static void run_until(int64_t until_us)
+{
+    for (;;)
+    {
+        int64_t deadline = gesture_engine_update(&engine, now_us);
+        if (deadline > until_us)
+        {
+            break;
+        }
+        now_us = deadline;
+    }
+    now_us = until_us;
+    gesture_engine_update(&engine, now_us);
+}
+
+static void input(int gpio_num, gpio_input_state_t state, int64_t after_us)
+{
+    run_until(now_us + after_us);
+    gesture_engine_input(&engine, gpio_num, state, now_us);
+}
+
+static void tap(int gpio_num, int64_t after_us)
+{
+    input(gpio_num, ON, after_us);
+    input(gpio_num, OFF, 100000);
+}
+
+static void test_single_tap(void)
+{
+    reset();
+    tap(BUTTON, 0);
+    int64_t release_us = now_us;
+    run_until(now_us + 10 * GAP_US);
+    CHECK_EQ(fired[SINGLE], 1);
+    CHECK_EQ(fired_total, 1);
+    CHECK_EQ(fired_gpio, BUTTON);
+    // the gap is measured from the release
+    CHECK_EQ(fired_us, release_us + GAP_US);
+}
+
+static void test_double_tap(void)
+{
+    reset();
+    tap(BUTTON, 0);
+    tap(BUTTON, GAP_US - 1);
+    run_until(now_us + 10 * GAP_US);
+    CHECK_EQ(fired[DOUBLE], 1);
+    CHECK_EQ(fired_total, 1);
+
+    // taps need the exact count, three or four are none of the tap gestures, nor a calibration
+    for (int taps = 3; taps <= 4; ++taps)
+    {
+        reset();
+        for (int i = 0; i < taps; ++i)
+        {
+            tap(BUTTON, 200000);
+        }
+        run_until(now_us + 10 * GAP_US);
+        CHECK_EQ(fired_total, 0);
+    }
+}
+
+static void test_calibrate_needs_two_taps_and_a_hold(void)
+{
+    reset();
+    tap(BUTTON, 0);
+    tap(BUTTON, 200000);
+    input(BUTTON, ON, 200000);
+    run_until(now_us + CALIBRATE_HOLD_US - 1);
+    CHECK_EQ(fired_total, 0);
+    run_until(now_us + 1);
+    CHECK_EQ(fired[CALIBRATE], 1);
+    CHECK_EQ(fired_gpio, BUTTON);
+
+    // the press belongs to the calibration: holding on is no factory reset, releasing it no tap
+    run_until(now_us + 2 * HOLD_US);
+    input(BUTTON, OFF, 0);
+    run_until(now_us + 10 * GAP_US);
+    CHECK_EQ(fired_total, 1);
+
+    // released too early, the three presses are nothing
+    reset();
+    tap(BUTTON, 0);
+    tap(BUTTON, 200000);
+    input(BUTTON, ON, 200000);
+    input(BUTTON, OFF, CALIBRATE_HOLD_US - 1);
+    run_until(now_us + 10 * GAP_US);
+    CHECK_EQ(fired_total, 0);
+
+    // a pause longer than the gap before the hold
+    reset();
+    tap(BUTTON, 0);
+    tap(BUTTON, 200000);
+    input(BUTTON, ON, GAP_US);
+    run_until(now_us + CALIBRATE_HOLD_US);
+    CHECK_EQ(fired[CALIBRATE], 0);
+
+    // a hold without taps is only the factory reset
+    reset();
+    input(BUTTON, ON, 0);
+    run_until(now_us + HOLD_US);
+    CHECK_EQ(fired[CALIBRATE], 0);
+    CHECK_EQ(fired[HOLD], 1);
+    CHECK_EQ(fired_total, 1);
+}
+
+static void test_taps_too_far_apart(void)
+{
+    reset();
+    tap(BUTTON, 0);
+    tap(BUTTON, GAP_US);
+    run_until(now_us + 10 * GAP_US);
+    CHECK_EQ(fired[SINGLE], 2);
+    CHECK_EQ(fired[DOUBLE], 0);
+}
+
+static void test_no_tap_while_held(void)
+{
+    reset();
+    input(BUTTON, ON, 0);
+    run_until(now_us + HOLD_US - 1);
+    CHECK_EQ(fired_total, 0);
+    run_until(now_us + 1);
+    CHECK_EQ(fired[HOLD], 1);
+
+    // the hold consumed the press, releasing it is not a tap
+    input(BUTTON, OFF, 1000000);
+    run_until(now_us + 10 * GAP_US);
+    CHECK_EQ(fired_total, 1);
+}
+
+static void test_toggle_reset_counts_both_leds(void)
+{
+    reset();
+    // every press of the switch button lights the other LED
+    for (int i = 0; i < TOGGLE_PRESSES; ++i)
+    {
+        int led = i % 2 ? LED_2 : LED_1;
+        int other = i % 2 ? LED_1 : LED_2;
+        input(other, OFF, 0);
+        input(led, ON, TOGGLE_GAP_US - 1);
+    }
+    CHECK_EQ(fired_total, 0);
+    run_until(now_us + TOGGLE_GAP_US);
+    CHECK_EQ(fired[TOGGLE_RESET], 1);
+    CHECK_EQ(fired_total, 1);
+}
+
+/* @p presses of the switch button, 500 ms apart, then waits for the sequence to end */
+static void press_switch_button(int presses)
+{
+    reset();
+    for (int i = 0; i < presses; ++i)
+    {
+        input(i % 2 ? LED_2 : LED_1, ON, 500000);
+    }
+    run_until(now_us + 2 * TOGGLE_GAP_US);
+}
+
+static void test_toggle_reset_needs_at_least_the_count(void)
+{
+    press_switch_button(TOGGLE_PRESSES - 1);
+    CHECK_EQ(fired[TOGGLE_RESET], 0);
+
+    // more presses than needed fire once, when the sequence ends
+    static const int counts[] = {TOGGLE_PRESSES, TOGGLE_PRESSES + 1, TOGGLE_PRESSES + 5};
+    for (int i = 0; i < (int)(sizeof(counts) / sizeof(counts[0])); ++i)
+    {
+        press_switch_button(counts[i]);
+        CHECK_EQ(fired[TOGGLE_RESET], 1);
+        CHECK_EQ(fired_total, 1);
+    }
+
+    // a pause longer than the gap starts over
+    reset();
+    for (int i = 0; i < TOGGLE_PRESSES; ++i)
+    {
+        input(i % 2 ? LED_2 : LED_1, ON, i == TOGGLE_PRESSES / 2 ? TOGGLE_GAP_US : 500000);
+    }
+    run_until(now_us + 2 * TOGGLE_GAP_US);
+    CHECK_EQ(fired[TOGGLE_RESET], 0);
+}
+
+static void test_suspended_inputs_dont_count(void)
+{
+    reset();
+    const uint64_t leds = GESTURE_INPUT(LED_1) | GESTURE_INPUT(LED_2);
+    for (int i = 0; i < TOGGLE_PRESSES / 2; ++i)
+    {
+        input(i % 2 ? LED_2 : LED_1, ON, 500000);
+    }
+
+    // the firmware switches channels: its pulses light the LEDs, the button still works
+    gesture_engine_suspend(&engine, leds, true);
+    for (int i = 0; i < TOGGLE_PRESSES; ++i)
+    {
+        input(i % 2 ? LED_2 : LED_1, ON, 300000);
+    }
+    input(BUTTON, ON, 0);
+    input(BUTTON, OFF, 100000);
+    gesture_engine_suspend(&engine, leds, true);
+    gesture_engine_suspend(&engine, leds, false);
+
+    // the presses before the suspension are gone
+    for (int i = 0; i < TOGGLE_PRESSES / 2; ++i)
+    {
+        input(i % 2 ? LED_2 : LED_1, ON, 500000);
+    }
+    run_until(now_us + 2 * TOGGLE_GAP_US);
+    CHECK_EQ(fired[TOGGLE_RESET], 0);
+    CHECK_EQ(fired[SINGLE], 1);
+
+    for (int i = 0; i < TOGGLE_PRESSES; ++i)
+    {
+        input(i % 2 ? LED_2 : LED_1, ON, 500000);
+    }
+    run_until(now_us + 2 * TOGGLE_GAP_US);
+    CHECK_EQ(fired[TOGGLE_RESET], 1);
+}
+
+static void test_long_states_are_ignored(void)
+{
+    reset();
+    input(BUTTON, ON_LONG, 0);
+    input(BUTTON, OFF_LONG, 0);
+    CHECK_EQ(gesture_engine_update(&engine, now_us), GESTURE_NO_DEADLINE);
+}
+
+int main(void)
+{
+    RUN_TEST(test_single_tap);
+    RUN_TEST(test_double_tap);
+    RUN_TEST(test_calibrate_needs_two_taps_and_a_hold);
+    RUN_TEST(test_taps_too_far_apart);
+    RUN_TEST(test_no_tap_while_held);
+    RUN_TEST(test_toggle_reset_counts_both_leds);
+    RUN_TEST(test_toggle_reset_needs_at_least_the_count);
+    RUN_TEST(test_suspended_inputs_dont_count);
+    RUN_TEST(test_long_states_are_ignored);
+    return TEST_RESULT();
+}
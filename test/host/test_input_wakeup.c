@@ -0,0 +1,120 @@
+/*
+ * gpio_input.c on the simulated app loop: the loop only wakes up for edges and debounce deadlines,
+ * and a press is reported exactly debounce_us after its final edge.
+ */
+
+#include "app_loop.h"
+#include "gpio_input.h"
+#include "host_sim.h"
+#include "test.h"
+
+#define BUTTON GPIO_NUM_9
+#define BUTTON_DEBOUNCE_US (30 * 1000)
+#define BUTTON_LONG_PRESS_US 2000000
+/* the former loop polled every 50 ms and needed DEBOUNCE_TICKS (25) stable ticks of 10 ms */
+#define POLLED_LATENCY_MIN_US (25 * 10 * 1000)
+
+typedef struct reported_t
+{
+    int gpio_num;
+    gpio_input_state_t state;
+    int64_t time_us;
+} reported_t;
+
+static reported_t reported[64];
+static int reported_count = 0;
+
+static void input_callback(int gpio_num, gpio_input_state_t state)
+{
+    if (reported_count < (int)(sizeof(reported) / sizeof(reported[0])))
+    {
+        reported[reported_count++] = (reported_t){gpio_num, state, host_now_us()};
+    }
+}
+
+static void advance(int64_t us)
+{
+    host_loop_run_until(host_now_us() + us);
+}
+
+static void test_idle_makes_no_wakeups(void)
+{
+    uint32_t passes = host_loop_passes();
+    advance(60LL * 1000000);
+    CHECK_EQ(host_loop_passes(), passes);
+    CHECK_EQ(host_loop_next_deadline(), INT64_MAX);
+    CHECK_EQ(reported_count, 0);
+}
+
+static void test_clean_press_latency(void)
+{
+    reported_count = 0;
+    uint32_t passes = host_loop_passes();
+    int64_t press_us = host_now_us();
+    host_gpio_set_level(BUTTON, 0);
+    advance(200 * 1000);
+
+    CHECK_EQ(reported_count, 1);
+    CHECK_EQ(reported[0].gpio_num, BUTTON);
+    CHECK_EQ(reported[0].state, ON);
+    CHECK_EQ(reported[0].time_us - press_us, BUTTON_DEBOUNCE_US);
+    CHECK(reported[0].time_us - press_us < POLLED_LATENCY_MIN_US);
+    // one pass for the edge, one for the debounce deadline
+    CHECK_EQ(host_loop_passes() - passes, 2);
+
+    gpio_input_stats_t stats;
+    CHECK_EQ(gpio_input_get_stats(BUTTON, &stats), ESP_OK);
+    CHECK_EQ(stats.last_latency_us, BUTTON_DEBOUNCE_US);
+
+    int64_t release_us = host_now_us();
+    host_gpio_set_level(BUTTON, 1);
+    advance(BUTTON_LONG_PRESS_US + 100 * 1000);
+    CHECK_EQ(reported_count, 3);
+    CHECK_EQ(reported[1].state, OFF);
+    CHECK_EQ(reported[1].time_us - release_us, BUTTON_DEBOUNCE_US);
+    CHECK_EQ(reported[2].state, OFF_LONG);
+    CHECK_EQ(reported[2].time_us - release_us, BUTTON_LONG_PRESS_US);
+
+    // nothing is pending after the long state, the loop sleeps again
+    passes = host_loop_passes();
+    advance(60LL * 1000000);
+    CHECK_EQ(host_loop_passes(), passes);
+}
+
+static void test_bounce_latency_from_final_edge(void)
+{
+    reported_count = 0;
+    // 8 edges within 4 ms, ending low
+    for (int i = 0; i < 8; ++i)
+    {
+        host_gpio_set_level(BUTTON, i % 2);
+        advance(500);
+    }
+    host_gpio_set_level(BUTTON, 0);
+    int64_t final_edge_us = host_now_us();
+    advance(100 * 1000);
+
+    CHECK_EQ(reported_count, 1);
+    CHECK_EQ(reported[0].state, ON);
+    CHECK_EQ(reported[0].time_us - final_edge_us, BUTTON_DEBOUNCE_US);
+    CHECK_EQ(host_gpio_isr_calls(BUTTON) > 0, 1);
+
+    gpio_input_snapshot_t snapshot;
+    gpio_input_get_snapshot(&snapshot);
+    CHECK_EQ(gpio_input_snapshot_state(&snapshot, BUTTON), ON);
+
+    host_gpio_set_level(BUTTON, 1);
+    advance(BUTTON_LONG_PRESS_US + 100 * 1000);
+}
+
+int main(void)
+{
+    CHECK_EQ(app_loop_init(), ESP_OK);
+    CHECK_EQ(gpio_debounce_input_init(input_callback), ESP_OK);
+    CHECK_EQ(gpio_debounce_input_init(input_callback), ESP_ERR_INVALID_STATE);
+
+    RUN_TEST(test_idle_makes_no_wakeups);
+    RUN_TEST(test_clean_press_latency);
+    RUN_TEST(test_bounce_latency_from_final_edge);
+    return TEST_RESULT();
+}
@@ -0,0 +1,109 @@
+/*
+ * latency_hist.c: bucket boundaries, percentiles and lock free recording from several threads.
+ */
+
+#include <pthread.h>
+
+#include "latency_hist.h"
+#include "test.h"
+
+#define THREADS 4
+#define RECORDS_PER_THREAD 100000
+
+static latency_hist_t hist;
+
+static void test_bucket_boundaries(void)
+{
+    CHECK_EQ(latency_hist_bucket(0), 0);
+    CHECK_EQ(latency_hist_bucket(1), 0);
+    for (int n = 1; n < LATENCY_HIST_BUCKETS; ++n)
+    {
+        CHECK_EQ(latency_hist_bucket(1u << n), n);
+        CHECK_EQ(latency_hist_bucket((1u << n) - 1), n - 1);
+    }
+    // everything from 2^(BUCKETS - 1) on ends up in the last bucket
+    CHECK_EQ(latency_hist_bucket(1u << LATENCY_HIST_BUCKETS), LATENCY_HIST_BUCKETS - 1);
+    CHECK_EQ(latency_hist_bucket(UINT32_MAX), LATENCY_HIST_BUCKETS - 1);
+}
+
+static void test_record_and_reset(void)
+{
+    latency_hist_reset(&hist);
+    CHECK_EQ(latency_hist_count(&hist), 0);
+    CHECK_EQ(latency_hist_percentile(&hist, 50), 0);
+
+    latency_hist_record(&hist, 0);
+    latency_hist_record(&hist, 3);
+    latency_hist_record(&hist, 1000);
+    latency_hist_record(&hist, UINT32_MAX);
+    CHECK_EQ(latency_hist_count(&hist), 4);
+    CHECK_EQ(hist.buckets[0], 1);
+    CHECK_EQ(hist.buckets[1], 1);
+    CHECK_EQ(hist.buckets[9], 1);
+    CHECK_EQ(hist.buckets[LATENCY_HIST_BUCKETS - 1], 1);
+
+    latency_hist_reset(&hist);
+    CHECK_EQ(latency_hist_count(&hist), 0);
+}
+
+static void test_percentiles(void)
+{
+    // 98 fast samples around 50 ms and 2 slow ones around 1 s
+    latency_hist_reset(&hist);
+    for (int i = 0; i < 98; ++i)
+    {
+        latency_hist_record(&hist, 50000 + i);
+    }
+    latency_hist_record(&hist, 1000000);
+    latency_hist_record(&hist, 1100000);
+
+    // the upper bound of the bucket is reported: 50 ms is in [2^15, 2^16), 1 s in [2^19, 2^20) and [2^20, 2^21)
+    CHECK_EQ(latency_hist_percentile(&hist, 50), 1u << 16);
+    CHECK_EQ(latency_hist_percentile(&hist, 98), 1u << 16);
+    CHECK_EQ(latency_hist_percentile(&hist, 99), 1u << 20);
+    CHECK_EQ(latency_hist_percentile(&hist, 100), 1u << 21);
+    CHECK_EQ(latency_hist_percentile(&hist, 0), 1u << 16);
+
+    // with a single sample every percentile is that sample
+    latency_hist_reset(&hist);
+    latency_hist_record(&hist, 300);
+    CHECK_EQ(latency_hist_percentile(&hist, 1), 512);
+    CHECK_EQ(latency_hist_percentile(&hist, 99), 512);
+}
+
+static void *recorder(void *arg)
+{
+    uint32_t latency_us = (uint32_t)(uintptr_t)arg;
+    for (int i = 0; i < RECORDS_PER_THREAD; ++i)
+    {
+        latency_hist_record(&hist, latency_us);
+    }
+    return NULL;
+}
+
+static void test_concurrent_records_are_not_lost(void)
+{
+    latency_hist_reset(&hist);
+    pthread_t threads[THREADS];
+    // two threads share a bucket, so increments of the same counter race
+    for (int i = 0; i < THREADS; ++i)
+    {
+        CHECK_EQ(pthread_create(&threads[i], NULL, recorder, (void *)(uintptr_t)(i < 2 ? 100 : 100000 * i)), 0);
+    }
+    for (int i = 0; i < THREADS; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    CHECK_EQ(latency_hist_count(&hist), THREADS * RECORDS_PER_THREAD);
+    CHECK_EQ(hist.buckets[latency_hist_bucket(100)], 2 * RECORDS_PER_THREAD);
+}
+
+int main(void)
+{
+    RUN_TEST(test_bucket_boundaries);
+    RUN_TEST(test_record_and_reset);
+    RUN_TEST(test_percentiles);
+    RUN_TEST(test_concurrent_records_are_not_lost);
+    return TEST_RESULT();
+}
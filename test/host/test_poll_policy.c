@@ -0,0 +1,206 @@
+/*
+ * poll_policy.c with the intervals of poll_control.h: fast poll windows after activity and their extension,
+ * check-ins and their responses, and the limits on the intervals and timeouts the client may set.
+ */
+
+#include "poll_policy.h"
+#include "test.h"
+
+#define LONG_POLL_MS 3000
+#define SHORT_POLL_MS 250
+#define FAST_POLL_TIMEOUT_MS 10000
+#define FAST_POLL_TIMEOUT_MAX_MS 60000
+#define CHECK_IN_MS (60 * 60 * 1000)
+#define MS (1000LL)
+
+static poll_policy_t policy;
+static int64_t now_us;
+static uint32_t interval_ms; /* interval applied last */
+static int check_ins;
+
+static void setup(void)
+{
+    const poll_policy_config_t config = {
+        .long_poll_ms = LONG_POLL_MS,
+        .short_poll_ms = SHORT_POLL_MS,
+        .fast_poll_timeout_ms = FAST_POLL_TIMEOUT_MS,
+        .fast_poll_timeout_max_ms = FAST_POLL_TIMEOUT_MAX_MS,
+        .check_in_interval_ms = CHECK_IN_MS,
+    };
+    now_us = 5000 * MS;
+    poll_policy_init(&policy, &config, now_us);
+    interval_ms = 0;
+    check_ins = 0;
+}
+
+/* calls poll_policy_update() at every deadline up to @p until_us and applies its actions */
+static void run_until(int64_t until_us)
+{
+    for (;;)
+    {
+        uint32_t interval;
+        uint8_t actions = poll_policy_update(&policy, now_us, &interval);
+        if (actions & POLL_POLICY_SET_INTERVAL)
+        {
+            interval_ms = interval;
+        }
+        if (actions & POLL_POLICY_CHECK_IN)
+        {
+            check_ins++;
+        }
+        int64_t deadline_us = poll_policy_next_deadline(&policy, now_us);
+        if (deadline_us > until_us)
+        {
+            break;
+        }
+        now_us = deadline_us;
+    }
+    now_us = until_us;
+}
+
+static void run_for(int64_t us)
+{
+    run_until(now_us + us);
+}
+
+static void test_idle_polls_slowly(void)
+{
+    setup();
+    run_for(0);
+    CHECK_EQ(interval_ms, LONG_POLL_MS);
+    CHECK(!poll_policy_is_fast(&policy, now_us));
+    // nothing to do until the first check-in
+    CHECK_EQ(poll_policy_next_deadline(&policy, now_us), now_us + CHECK_IN_MS * MS);
+    CHECK_EQ(policy.fast_windows, 0);
+}
+
+static void test_activity_window_is_extended(void)
+{
+    setup();
+    run_for(0);
+    poll_policy_activity(&policy, now_us);
+    run_for(0);
+    CHECK_EQ(interval_ms, SHORT_POLL_MS);
+    CHECK_EQ(poll_policy_next_deadline(&policy, now_us), now_us + FAST_POLL_TIMEOUT_MS * MS);
+
+    // activity within the window moves its end, it is still one window
+    run_for(FAST_POLL_TIMEOUT_MS / 2 * MS);
+    poll_policy_activity(&policy, now_us);
+    int64_t window_end_us = now_us + FAST_POLL_TIMEOUT_MS * MS;
+    run_until(window_end_us - 1);
+    CHECK_EQ(interval_ms, SHORT_POLL_MS);
+    run_until(window_end_us);
+    CHECK_EQ(interval_ms, LONG_POLL_MS);
+    CHECK_EQ(policy.fast_windows, 1);
+
+    // the next activity opens a new window
+    poll_policy_activity(&policy, now_us);
+    run_for(0);
+    CHECK_EQ(interval_ms, SHORT_POLL_MS);
+    CHECK_EQ(policy.fast_windows, 2);
+}
+
+static void test_check_in_opens_a_window_for_the_response(void)
+{
+    setup();
+    run_for(CHECK_IN_MS * MS - 1);
+    CHECK_EQ(check_ins, 0);
+    run_for(1);
+    CHECK_EQ(check_ins, 1);
+    CHECK_EQ(interval_ms, SHORT_POLL_MS);
+
+    // no response: back to slow polling after the timeout, the next check-in an interval later
+    int64_t check_in_us = now_us;
+    run_until(check_in_us + FAST_POLL_TIMEOUT_MS * MS);
+    CHECK_EQ(interval_ms, LONG_POLL_MS);
+    run_until(check_in_us + CHECK_IN_MS * MS);
+    CHECK_EQ(check_ins, 2);
+
+    // a response without fast poll ends the window right away
+    poll_policy_stop_fast_poll(&policy);
+    run_for(0);
+    CHECK_EQ(interval_ms, LONG_POLL_MS);
+
+    // disabled check-ins leave nothing to wait for
+    poll_policy_set_check_in_interval(&policy, 0, now_us);
+    run_for(10LL * CHECK_IN_MS * MS);
+    CHECK_EQ(check_ins, 2);
+    CHECK_EQ(poll_policy_next_deadline(&policy, now_us), POLL_POLICY_NO_DEADLINE);
+}
+
+static void test_fast_poll_response_replaces_the_check_in_window(void)
+{
+    setup();
+    run_for(CHECK_IN_MS * MS);
+    CHECK_EQ(check_ins, 1);
+
+    // a shorter timeout than the check-in window ends it earlier
+    poll_policy_fast_poll(&policy, now_us, 2000);
+    CHECK_EQ(poll_policy_next_deadline(&policy, now_us), now_us + 2000 * MS);
+    run_for(2000 * MS);
+    CHECK_EQ(interval_ms, LONG_POLL_MS);
+
+    // stopping fast poll doesn't end a window opened by activity
+    poll_policy_activity(&policy, now_us);
+    poll_policy_fast_poll(&policy, now_us, 30000);
+    run_for(FAST_POLL_TIMEOUT_MS / 2 * MS);
+    poll_policy_stop_fast_poll(&policy);
+    run_for(0);
+    CHECK_EQ(interval_ms, SHORT_POLL_MS);
+    run_for(FAST_POLL_TIMEOUT_MS / 2 * MS);
+    CHECK_EQ(interval_ms, LONG_POLL_MS);
+}
+
+static void test_fast_poll_timeout_is_clamped(void)
+{
+    // 0 asks for the configured timeout
+    setup();
+    poll_policy_fast_poll(&policy, now_us, 0);
+    CHECK_EQ(poll_policy_next_deadline(&policy, now_us), now_us + FAST_POLL_TIMEOUT_MS * MS);
+
+    // longer than the maximum is cut to it, the maximum itself is taken
+    setup();
+    poll_policy_fast_poll(&policy, now_us, FAST_POLL_TIMEOUT_MAX_MS + 1);
+    CHECK_EQ(poll_policy_next_deadline(&policy, now_us), now_us + FAST_POLL_TIMEOUT_MAX_MS * MS);
+    setup();
+    poll_policy_fast_poll(&policy, now_us, FAST_POLL_TIMEOUT_MAX_MS);
+    CHECK_EQ(poll_policy_next_deadline(&policy, now_us), now_us + FAST_POLL_TIMEOUT_MAX_MS * MS);
+}
+
+static void test_invalid_settings_are_rejected(void)
+{
+    setup();
+    CHECK(!poll_policy_set_fast_poll_timeout(&policy, 0));
+    CHECK(!poll_policy_set_fast_poll_timeout(&policy, FAST_POLL_TIMEOUT_MAX_MS + 1));
+    CHECK_EQ(policy.config.fast_poll_timeout_ms, FAST_POLL_TIMEOUT_MS);
+    CHECK(poll_policy_set_fast_poll_timeout(&policy, FAST_POLL_TIMEOUT_MAX_MS));
+    CHECK_EQ(policy.config.fast_poll_timeout_ms, FAST_POLL_TIMEOUT_MAX_MS);
+
+    // the long poll interval can't go below the short one and the other way round
+    CHECK(!poll_policy_set_long_poll(&policy, SHORT_POLL_MS - 1));
+    CHECK(!poll_policy_set_short_poll(&policy, 0));
+    CHECK(!poll_policy_set_short_poll(&policy, LONG_POLL_MS + 1));
+    CHECK_EQ(policy.config.long_poll_ms, LONG_POLL_MS);
+    CHECK_EQ(policy.config.short_poll_ms, SHORT_POLL_MS);
+    CHECK(poll_policy_set_short_poll(&policy, LONG_POLL_MS));
+    CHECK(!poll_policy_set_long_poll(&policy, LONG_POLL_MS - 1));
+    CHECK(poll_policy_set_long_poll(&policy, LONG_POLL_MS));
+
+    // accepted intervals take effect with the next update
+    setup();
+    run_for(0);
+    CHECK(poll_policy_set_long_poll(&policy, 7000));
+    run_for(0);
+    CHECK_EQ(interval_ms, 7000);
+}
+
+int main(void)
+{
+    RUN_TEST(test_idle_polls_slowly);
+    RUN_TEST(test_activity_window_is_extended);
+    RUN_TEST(test_check_in_opens_a_window_for_the_response);
+    RUN_TEST(test_fast_poll_response_replaces_the_check_in_window);
+    RUN_TEST(test_fast_poll_timeout_is_clamped);
+    RUN_TEST(test_invalid_settings_are_rejected);
+    return TEST_RESULT();
+}
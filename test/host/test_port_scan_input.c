@@ -0,0 +1,78 @@
+/*
+ * gpio_input.c built with GPIO_INPUT_PORT_SCAN: all inputs are sampled as one word every
+ * GPIO_INPUT_PORT_SCAN_PERIOD_US and a level is accepted after VERTICAL_DEBOUNCE_SAMPLES equal samples.
+ */
+
+#include "app_loop.h"
+#include "gpio_input.h"
+#include "host_sim.h"
+#include "test.h"
+#include "vertical_debounce.h"
+
+#define BUTTON GPIO_NUM_9
+#define LED_CH_1 GPIO_NUM_19
+
+static int reported_gpio = -1;
+static gpio_input_state_t reported_state;
+static int64_t reported_us = 0;
+static int reported_count = 0;
+
+static void input_callback(int gpio_num, gpio_input_state_t state)
+{
+    if (state == ON || state == OFF)
+    {
+        reported_gpio = gpio_num;
+        reported_state = state;
+        reported_us = host_now_us();
+        reported_count++;
+    }
+}
+
+static void advance(int64_t us)
+{
+    host_loop_run_until(host_now_us() + us);
+}
+
+static void test_press_after_four_samples(void)
+{
+    int64_t press_us = host_now_us() + 1234;
+    advance(1234);
+    host_gpio_set_level(BUTTON, 0);
+    advance(100 * 1000);
+
+    CHECK_EQ(reported_count, 1);
+    CHECK_EQ(reported_gpio, BUTTON);
+    CHECK_EQ(reported_state, ON);
+    // accepted with the 4th sample that sees the level, the first one is up to a period after the edge
+    CHECK(reported_us - press_us > (VERTICAL_DEBOUNCE_SAMPLES - 1) * GPIO_INPUT_PORT_SCAN_PERIOD_US);
+    CHECK(reported_us - press_us <= VERTICAL_DEBOUNCE_SAMPLES * GPIO_INPUT_PORT_SCAN_PERIOD_US);
+    CHECK_EQ(host_gpio_isr_calls(BUTTON), 0);
+}
+
+static void test_short_glitch_is_ignored(void)
+{
+    reported_count = 0;
+    host_gpio_set_level(LED_CH_1, 0);
+    advance(2 * GPIO_INPUT_PORT_SCAN_PERIOD_US);
+    host_gpio_set_level(LED_CH_1, 1);
+    advance(100 * 1000);
+    CHECK_EQ(reported_count, 0);
+}
+
+static void test_samples_at_scan_period(void)
+{
+    uint32_t passes = host_loop_passes();
+    advance(1000 * 1000);
+    CHECK_EQ(host_loop_passes() - passes, 1000 * 1000 / GPIO_INPUT_PORT_SCAN_PERIOD_US);
+}
+
+int main(void)
+{
+    CHECK_EQ(app_loop_init(), ESP_OK);
+    CHECK_EQ(gpio_debounce_input_init(input_callback), ESP_OK);
+
+    RUN_TEST(test_press_after_four_samples);
+    RUN_TEST(test_short_glitch_is_ignored);
+    RUN_TEST(test_samples_at_scan_period);
+    return TEST_RESULT();
+}
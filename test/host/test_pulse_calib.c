@@ -0,0 +1,204 @@
+/*
+ * pulse_calib.c against a simulated USB switch that only reacts to pulses of a minimum width
+ * with a minimum gap to the previous pulse, with the configuration of the firmware.
+ */
+
+#include "pulse_calib.h"
+#include "test.h"
+
+#define MIN_PULSE_MS 20
+#define MAX_PULSE_MS 200
+#define MIN_GAP_MS 10
+#define MAX_GAP_MS 500
+#define TRIALS 3
+#define MARGIN_PERCENT 25
+#define CONFIRM_TIMEOUT_US (500 * 1000)
+#define REST_US (500 * 1000)
+#define REACT_US (30 * 1000) /* pulse end to LED change */
+#define CHANNELS 2
+#define MAX_CHANGES 16
+
+typedef struct simulated_switch_t
+{
+    uint16_t needs_pulse_ms; /* shorter pulses are ignored */
+    uint16_t needs_gap_ms;   /* pulses closer to the end of the previous one are ignored */
+    int channel;
+    int pulsed_channel;
+    int64_t last_pulse_end_us;
+    int64_t change_us[MAX_CHANGES];
+    int change_channel[MAX_CHANGES];
+    int change_count;
+    int pulses;
+    int64_t last_pulse_us;
+} simulated_switch_t;
+
+typedef struct done_t
+{
+    int count;
+    bool success;
+    uint16_t pulse_ms;
+    uint16_t gap_ms;
+} done_t;
+
+static simulated_switch_t sw;
+static pulse_calib_t calib;
+static int64_t now_us;
+static int64_t calib_deadline_us;
+static done_t done;
+
+static void pulse(uint16_t pulse_ms)
+{
+    sw.pulses++;
+    sw.last_pulse_us = now_us;
+    bool recognized = pulse_ms >= sw.needs_pulse_ms && now_us - sw.last_pulse_end_us >= sw.needs_gap_ms * 1000LL;
+    sw.last_pulse_end_us = now_us + pulse_ms * 1000LL;
+    if (recognized && sw.change_count < MAX_CHANGES)
+    {
+        sw.pulsed_channel = (sw.pulsed_channel + 1) % CHANNELS;
+        sw.change_us[sw.change_count] = sw.last_pulse_end_us + REACT_US;
+        sw.change_channel[sw.change_count] = sw.pulsed_channel;
+        sw.change_count++;
+    }
+}
+
+static void calib_done(bool success, uint16_t pulse_ms, uint16_t gap_ms)
+{
+    done.count++;
+    done.success = success;
+    done.pulse_ms = pulse_ms;
+    done.gap_ms = gap_ms;
+}
+
+static void setup(uint16_t needs_pulse_ms, uint16_t needs_gap_ms)
+{
+    sw = (simulated_switch_t){
+        .needs_pulse_ms = needs_pulse_ms,
+        .needs_gap_ms = needs_gap_ms,
+        .last_pulse_end_us = -1000000,
+    };
+    done = (done_t){0};
+    now_us = 0;
+    const pulse_calib_config_t config = {
+        .min_pulse_ms = MIN_PULSE_MS,
+        .max_pulse_ms = MAX_PULSE_MS,
+        .min_gap_ms = MIN_GAP_MS,
+        .max_gap_ms = MAX_GAP_MS,
+        .trials = TRIALS,
+        .margin_percent = MARGIN_PERCENT,
+        .confirm_timeout_us = CONFIRM_TIMEOUT_US,
+        .rest_us = REST_US,
+    };
+    pulse_calib_init(&calib, &config, pulse, calib_done);
+    pulse_calib_observe(&calib, sw.channel, now_us);
+    pulse_calib_start(&calib, now_us);
+    calib_deadline_us = pulse_calib_update(&calib, now_us);
+}
+
+/* a press of the switch button at the current time */
+static void manual_press(void)
+{
+    sw.pulsed_channel = (sw.pulsed_channel + 1) % CHANNELS;
+    sw.channel = sw.pulsed_channel;
+    pulse_calib_observe(&calib, sw.channel, now_us);
+    calib_deadline_us = pulse_calib_update(&calib, now_us);
+}
+
+/* delivers LED changes and calibration deadlines in time order up to @p until_us */
+static void run_until(int64_t until_us)
+{
+    for (;;)
+    {
+        int next_change = -1;
+        for (int i = 0; i < sw.change_count; ++i)
+        {
+            if (next_change < 0 || sw.change_us[i] < sw.change_us[next_change])
+            {
+                next_change = i;
+            }
+        }
+        int64_t change_us = next_change >= 0 ? sw.change_us[next_change] : INT64_MAX;
+        int64_t next_us = change_us < calib_deadline_us ? change_us : calib_deadline_us;
+        if (next_us > until_us)
+        {
+            break;
+        }
+
+        now_us = next_us;
+        if (next_us == change_us)
+        {
+            sw.channel = sw.change_channel[next_change];
+            sw.change_count--;
+            sw.change_us[next_change] = sw.change_us[sw.change_count];
+            sw.change_channel[next_change] = sw.change_channel[sw.change_count];
+            pulse_calib_observe(&calib, sw.channel, now_us);
+        }
+        calib_deadline_us = pulse_calib_update(&calib, now_us);
+    }
+    now_us = until_us;
+}
+
+static uint16_t with_margin(uint16_t value)
+{
+    return value + value * MARGIN_PERCENT / 100;
+}
+
+static void test_finds_the_thresholds_of_the_switch(void)
+{
+    const uint16_t thresholds[][2] = {{57, 83}, {MIN_PULSE_MS, MIN_GAP_MS}, {MAX_PULSE_MS - 1, MAX_GAP_MS - 1}, {121, 11}};
+    for (int i = 0; i < 4; ++i)
+    {
+        setup(thresholds[i][0], thresholds[i][1]);
+        run_until(10 * 60 * 1000000LL);
+
+        CHECK_EQ(done.count, 1);
+        CHECK(done.success);
+        CHECK_EQ(done.pulse_ms, with_margin(thresholds[i][0]));
+        CHECK_EQ(done.gap_ms, with_margin(thresholds[i][1]));
+        CHECK(!pulse_calib_is_running(&calib));
+        CHECK_EQ(calib_deadline_us, PULSE_CALIB_NO_DEADLINE);
+    }
+}
+
+static void test_dead_switch_fails(void)
+{
+    setup(UINT16_MAX, 0);
+    run_until(10 * 60 * 1000000LL);
+
+    CHECK_EQ(done.count, 1);
+    CHECK(!done.success);
+    CHECK_EQ(sw.channel, 0);
+    CHECK(!pulse_calib_is_running(&calib));
+    // every candidate of the binary search fails once, the search never gets to the gap
+    CHECK(sw.pulses <= 8);
+}
+
+static void test_change_between_trials_delays_the_next_one(void)
+{
+    setup(57, 83);
+    // the first trial is confirmed by its LED change, the result is taken at the change
+    run_until(MAX_PULSE_MS * 1000LL);
+    CHECK_EQ(sw.pulses, 1);
+    int64_t trial_end_us = sw.last_pulse_us + (MIN_PULSE_MS + (MAX_PULSE_MS - MIN_PULSE_MS) / 2) * 1000LL + REACT_US;
+
+    // someone presses the switch button during the rest
+    run_until(trial_end_us + REST_US / 2);
+    manual_press();
+    run_until(trial_end_us + REST_US);
+    CHECK_EQ(sw.pulses, 1);
+    run_until(now_us + REST_US / 2);
+    CHECK_EQ(sw.pulses, 2);
+    CHECK_EQ(sw.last_pulse_us, trial_end_us + REST_US / 2 + REST_US);
+
+    run_until(10 * 60 * 1000000LL);
+    CHECK(done.success);
+    CHECK_EQ(done.pulse_ms, with_margin(57));
+    CHECK_EQ(done.gap_ms, with_margin(83));
+}
+
+int main(void)
+{
+    RUN_TEST(test_finds_the_thresholds_of_the_switch);
+    RUN_TEST(test_dead_switch_fails);
+    RUN_TEST(test_change_between_trials_delays_the_next_one);
+    return TEST_RESULT();
+}
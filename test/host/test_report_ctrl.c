@@ -0,0 +1,290 @@
+/*
+ * report_ctrl.c with the configuration of the firmware: immediate reports, the minimum interval,
+ * deduplication against the acknowledged value, superseding unacknowledged reports, default responses,
+ * timeouts and retries.
+ */
+
+#include "report_ctrl.h"
+#include "test.h"
+
+#define MIN_INTERVAL_US (250 * 1000)
+#define ACK_TIMEOUT_US (2 * 1000 * 1000)
+#define MAX_RETRIES 2
+
+static report_ctrl_t ctrl;
+static int64_t now_us;
+static uint16_t reported[32];
+static int64_t reported_us[32];
+static int report_count;
+
+static void setup(void)
+{
+    const report_ctrl_config_t config = {
+        .min_interval_us = MIN_INTERVAL_US,
+        .ack_timeout_us = ACK_TIMEOUT_US,
+        .max_retries = MAX_RETRIES,
+    };
+    report_ctrl_init(&ctrl, &config);
+    now_us = 1000 * 1000;
+    report_count = 0;
+}
+
+/* calls report_ctrl_update() at every deadline up to @p until_us and records the reports */
+static void run_until(int64_t until_us)
+{
+    for (;;)
+    {
+        uint16_t value;
+        if (report_ctrl_update(&ctrl, now_us, &value) && report_count < 32)
+        {
+            reported[report_count] = value;
+            reported_us[report_count] = now_us;
+            report_count++;
+        }
+        int64_t deadline_us = report_ctrl_next_deadline(&ctrl);
+        if (deadline_us > until_us)
+        {
+            break;
+        }
+        // a deadline in the past means the report is due now
+        now_us = deadline_us > now_us ? deadline_us : now_us;
+    }
+    now_us = until_us;
+}
+
+static void run_for(int64_t us)
+{
+    run_until(now_us + us);
+}
+
+static void test_first_change_is_reported_right_away(void)
+{
+    setup();
+    CHECK_EQ(report_ctrl_next_deadline(&ctrl), REPORT_CTRL_NO_DEADLINE);
+    report_ctrl_set(&ctrl, 1);
+    run_for(0);
+
+    CHECK_EQ(report_count, 1);
+    CHECK_EQ(reported[0], 1);
+    CHECK_EQ(reported_us[0], 1000 * 1000);
+    CHECK_EQ(report_ctrl_next_deadline(&ctrl), now_us + ACK_TIMEOUT_US);
+
+    report_ctrl_ack(&ctrl, true);
+    CHECK_EQ(ctrl.acked, 1);
+    CHECK_EQ(report_ctrl_next_deadline(&ctrl), REPORT_CTRL_NO_DEADLINE);
+
+    // a change after the minimum interval goes out immediately as well
+    run_for(MIN_INTERVAL_US);
+    report_ctrl_set(&ctrl, 0);
+    run_for(0);
+    CHECK_EQ(report_count, 2);
+    CHECK_EQ(reported[1], 0);
+    CHECK_EQ(reported_us[1] - reported_us[0], MIN_INTERVAL_US);
+}
+
+static void test_burst_collapses_to_the_latest_value(void)
+{
+    setup();
+    report_ctrl_set(&ctrl, 0);
+    run_for(0);
+    report_ctrl_ack(&ctrl, true);
+
+    report_ctrl_set(&ctrl, 1);
+    run_for(10 * 1000);
+    report_ctrl_set(&ctrl, 2);
+    run_for(10 * 1000);
+    report_ctrl_set(&ctrl, 3);
+    run_for(MIN_INTERVAL_US);
+
+    CHECK_EQ(report_count, 2);
+    CHECK_EQ(reported[1], 3);
+    CHECK_EQ(reported_us[1] - reported_us[0], MIN_INTERVAL_US);
+    CHECK_EQ(ctrl.collapsed, 2);
+    CHECK_EQ(ctrl.sent, 2);
+}
+
+static void test_acknowledged_value_is_not_reported_again(void)
+{
+    setup();
+    report_ctrl_set(&ctrl, 2);
+    run_for(0);
+    report_ctrl_ack(&ctrl, true);
+
+    // the same value and a change that is back before the interval ends need no report
+    report_ctrl_set(&ctrl, 2);
+    report_ctrl_set(&ctrl, 3);
+    run_for(MIN_INTERVAL_US / 2);
+    report_ctrl_set(&ctrl, 2);
+    run_for(10 * MIN_INTERVAL_US);
+
+    CHECK_EQ(report_count, 1);
+    CHECK_EQ(report_ctrl_next_deadline(&ctrl), REPORT_CTRL_NO_DEADLINE);
+
+    // unless the coordinator forgot it, e.g. after a rejoin
+    report_ctrl_invalidate(&ctrl);
+    run_for(0);
+    CHECK_EQ(report_count, 2);
+    CHECK_EQ(reported[1], 2);
+}
+
+static void test_change_while_unacked_supersedes_after_the_interval(void)
+{
+    setup();
+    report_ctrl_set(&ctrl, 0);
+    run_for(0);
+    report_ctrl_set(&ctrl, 1);
+    run_for(MIN_INTERVAL_US / 2);
+    CHECK_EQ(report_count, 1);
+
+    // the new value doesn't wait for the response to the report of 0
+    run_for(MIN_INTERVAL_US / 2);
+    CHECK_EQ(report_count, 2);
+    CHECK_EQ(reported[1], 1);
+    CHECK_EQ(reported_us[1] - reported_us[0], MIN_INTERVAL_US);
+    CHECK_EQ(ctrl.superseded, 1);
+    CHECK_EQ(ctrl.collapsed, 0);
+
+    // responses are matched in sending order, the first one belongs to the report of 0
+    report_ctrl_ack(&ctrl, true);
+    CHECK_EQ(ctrl.acked_value, 0);
+    CHECK_EQ(report_ctrl_next_deadline(&ctrl), reported_us[1] + ACK_TIMEOUT_US);
+    report_ctrl_ack(&ctrl, true);
+    CHECK_EQ(ctrl.acked_value, 1);
+    run_for(10 * MIN_INTERVAL_US);
+    CHECK_EQ(report_count, 2);
+    CHECK_EQ(report_ctrl_next_deadline(&ctrl), REPORT_CTRL_NO_DEADLINE);
+}
+
+static void test_lost_response_of_a_superseded_report(void)
+{
+    setup();
+    report_ctrl_set(&ctrl, 0);
+    run_for(0);
+    report_ctrl_set(&ctrl, 1);
+    run_for(MIN_INTERVAL_US);
+    CHECK_EQ(report_count, 2);
+
+    // the report of 0 times out, the response to 1 arrives after that
+    run_until(reported_us[0] + ACK_TIMEOUT_US);
+    CHECK_EQ(ctrl.failed, 1);
+    CHECK_EQ(ctrl.retries, 0);
+    CHECK_EQ(report_count, 2);
+    report_ctrl_ack(&ctrl, true);
+    CHECK_EQ(ctrl.acked_value, 1);
+
+    // the response to 1 is lost while 0 is still waiting: it is credited to 0 and 1 is sent again
+    setup();
+    report_ctrl_set(&ctrl, 0);
+    run_for(0);
+    report_ctrl_set(&ctrl, 1);
+    run_for(MIN_INTERVAL_US);
+    report_ctrl_ack(&ctrl, true);
+    CHECK_EQ(ctrl.acked_value, 0);
+    run_until(reported_us[1] + ACK_TIMEOUT_US);
+    CHECK_EQ(report_count, 3);
+    CHECK_EQ(reported[2], 1);
+    report_ctrl_ack(&ctrl, true);
+    CHECK_EQ(ctrl.acked_value, 1);
+}
+
+static void test_change_back_to_the_value_in_flight(void)
+{
+    setup();
+    report_ctrl_set(&ctrl, 0);
+    run_for(0);
+    report_ctrl_set(&ctrl, 1);
+    run_for(MIN_INTERVAL_US);
+    CHECK_EQ(report_count, 2);
+
+    // 0 is still in flight, but 1 was sent after it: 0 has to be reported again
+    report_ctrl_set(&ctrl, 0);
+    run_for(MIN_INTERVAL_US);
+    CHECK_EQ(report_count, 3);
+    CHECK_EQ(reported[2], 0);
+
+    // back to the newest report's value: nothing to send, its response is waited for
+    report_ctrl_set(&ctrl, 1);
+    report_ctrl_set(&ctrl, 0);
+    run_for(MIN_INTERVAL_US);
+    CHECK_EQ(report_count, 3);
+    CHECK_EQ(report_ctrl_next_deadline(&ctrl), reported_us[0] + ACK_TIMEOUT_US);
+}
+
+static void test_reports_in_flight_are_limited(void)
+{
+    setup();
+    for (int i = 0; i < REPORT_CTRL_MAX_IN_FLIGHT + 2; ++i)
+    {
+        report_ctrl_set(&ctrl, i);
+        run_for(MIN_INTERVAL_US);
+    }
+    CHECK_EQ(report_count, REPORT_CTRL_MAX_IN_FLIGHT);
+    CHECK_EQ(ctrl.in_flight, REPORT_CTRL_MAX_IN_FLIGHT);
+
+    // a response makes room for the latest value right away, the minimum interval has passed
+    report_ctrl_ack(&ctrl, true);
+    run_for(0);
+    CHECK_EQ(report_count, REPORT_CTRL_MAX_IN_FLIGHT + 1);
+    CHECK_EQ(reported[REPORT_CTRL_MAX_IN_FLIGHT], REPORT_CTRL_MAX_IN_FLIGHT + 1);
+}
+
+static void test_failed_reports_are_retried_then_given_up(void)
+{
+    setup();
+    report_ctrl_set(&ctrl, 1);
+    run_for(0);
+    for (int i = 0; i < MAX_RETRIES; ++i)
+    {
+        report_ctrl_ack(&ctrl, false);
+        run_for(MIN_INTERVAL_US);
+        CHECK_EQ(report_count, i + 2);
+        CHECK_EQ(reported[i + 1], 1);
+    }
+    report_ctrl_ack(&ctrl, false);
+    run_for(10 * MIN_INTERVAL_US);
+
+    CHECK_EQ(report_count, MAX_RETRIES + 1);
+    CHECK_EQ(ctrl.failed, MAX_RETRIES + 1);
+    CHECK_EQ(report_ctrl_next_deadline(&ctrl), REPORT_CTRL_NO_DEADLINE);
+
+    // a new value gets a fresh set of retries
+    report_ctrl_set(&ctrl, 2);
+    run_for(0);
+    CHECK_EQ(report_count, MAX_RETRIES + 2);
+    CHECK_EQ(reported[MAX_RETRIES + 1], 2);
+}
+
+static void test_missing_response_times_out(void)
+{
+    setup();
+    report_ctrl_set(&ctrl, 1);
+    run_for(0);
+    run_for(ACK_TIMEOUT_US - 1);
+    CHECK_EQ(ctrl.failed, 0);
+    CHECK(ctrl.in_flight);
+
+    run_for(1);
+    CHECK_EQ(ctrl.failed, 1);
+    CHECK_EQ(report_count, 2);
+    CHECK_EQ(reported_us[1] - reported_us[0], ACK_TIMEOUT_US);
+
+    // the response to the first report arrives late, it is taken for the resend
+    report_ctrl_ack(&ctrl, true);
+    report_ctrl_ack(&ctrl, true);
+    CHECK_EQ(ctrl.acked, 1);
+    CHECK_EQ(report_ctrl_next_deadline(&ctrl), REPORT_CTRL_NO_DEADLINE);
+}
+
+int main(void)
+{
+    RUN_TEST(test_first_change_is_reported_right_away);
+    RUN_TEST(test_burst_collapses_to_the_latest_value);
+    RUN_TEST(test_acknowledged_value_is_not_reported_again);
+    RUN_TEST(test_change_while_unacked_supersedes_after_the_interval);
+    RUN_TEST(test_lost_response_of_a_superseded_report);
+    RUN_TEST(test_change_back_to_the_value_in_flight);
+    RUN_TEST(test_reports_in_flight_are_limited);
+    RUN_TEST(test_failed_reports_are_retried_then_given_up);
+    RUN_TEST(test_missing_response_times_out);
+    return TEST_RESULT();
+}
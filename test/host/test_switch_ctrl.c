@@ -0,0 +1,368 @@
+/*
+ * switch_ctrl.c against a simulated USB switch: every pulse advances the switch by one channel and its LEDs
+ * show the new channel a little later, unless the switch is told to miss pulses. Floods of requests have to end on
+ * the latest target without a single unneeded pulse.
+ */
+
+#include "switch_ctrl.h"
+#include "test.h"
+
+#define PULSE_MS 200
+#define GAP_MS 100
+#define CONFIRM_TIMEOUT_US (1000 * 1000)
+#define MAX_ATTEMPTS 3
+#define REACT_US (30 * 1000) /* pulse end to LED change */
+#define MAX_CHANGES 64
+
+typedef struct simulated_switch_t
+{
+    int channels;
+    int channel;        /* shown by the LEDs */
+    int pulsed_channel; /* where the pulses issued so far lead */
+    int missed_left;    /* pulses that will be ignored */
+    int64_t change_us[MAX_CHANGES];
+    int change_channel[MAX_CHANGES];
+    int change_count;
+    int pulses;
+    int wasted_pulses; /* issued while the earlier pulses already lead to the target */
+    int64_t first_pulse_us;
+    int64_t last_pulse_us;
+} simulated_switch_t;
+
+typedef struct done_t
+{
+    int count;
+    int target;
+    bool success;
+    uint32_t latency_us;
+    uint8_t attempts;
+} done_t;
+
+static simulated_switch_t sw;
+static switch_ctrl_t ctrl;
+static int64_t now_us;
+static int64_t ctrl_deadline_us;
+static done_t done;
+
+static void pulse(uint16_t pulse_ms)
+{
+    if (sw.pulses++ == 0)
+    {
+        sw.first_pulse_us = now_us;
+    }
+    sw.last_pulse_us = now_us;
+    if (sw.pulsed_channel == ctrl.target)
+    {
+        sw.wasted_pulses++;
+    }
+    if (sw.missed_left > 0)
+    {
+        sw.missed_left--;
+        return;
+    }
+    sw.pulsed_channel = (sw.pulsed_channel + 1) % sw.channels;
+    if (sw.change_count < MAX_CHANGES)
+    {
+        sw.change_us[sw.change_count] = now_us + pulse_ms * 1000LL + REACT_US;
+        sw.change_channel[sw.change_count] = sw.pulsed_channel;
+        sw.change_count++;
+    }
+}
+
+static uint32_t random_state = 1;
+
+static uint32_t random_word(void)
+{
+    random_state = random_state * 1664525u + 1013904223u;
+    return random_state >> 8;
+}
+
+static void switch_done(int target, bool success, uint32_t latency_us, uint8_t attempts)
+{
+    done.count++;
+    done.target = target;
+    done.success = success;
+    done.latency_us = latency_us;
+    done.attempts = attempts;
+}
+
+/* the switch is on @p channel, the controller starts out without an observation if @p observed is false */
+static void setup_switch(int channels, int channel, bool observed)
+{
+    sw = (simulated_switch_t){.channels = channels, .channel = channel, .pulsed_channel = channel};
+    done = (done_t){0};
+    now_us = 0;
+    const switch_ctrl_config_t config = {
+        .channels = channels,
+        .pulse_ms = PULSE_MS,
+        .pulse_gap_ms = GAP_MS,
+        .confirm_timeout_us = CONFIRM_TIMEOUT_US,
+        .max_attempts = MAX_ATTEMPTS,
+    };
+    switch_ctrl_init(&ctrl, &config, pulse, switch_done);
+    if (observed)
+    {
+        switch_ctrl_observe(&ctrl, channel, now_us);
+    }
+    ctrl_deadline_us = switch_ctrl_update(&ctrl, now_us);
+}
+
+static void setup(int channels, int channel)
+{
+    setup_switch(channels, channel, true);
+}
+
+static void request(int target)
+{
+    switch_ctrl_request(&ctrl, target, now_us);
+    ctrl_deadline_us = switch_ctrl_update(&ctrl, now_us);
+}
+
+/* delivers LED changes and controller deadlines in time order up to @p until_us */
+static void run_until(int64_t until_us)
+{
+    for (;;)
+    {
+        int next_change = -1;
+        for (int i = 0; i < sw.change_count; ++i)
+        {
+            if (next_change < 0 || sw.change_us[i] < sw.change_us[next_change])
+            {
+                next_change = i;
+            }
+        }
+        int64_t change_us = next_change >= 0 ? sw.change_us[next_change] : INT64_MAX;
+        int64_t next_us = change_us < ctrl_deadline_us ? change_us : ctrl_deadline_us;
+        if (next_us > until_us)
+        {
+            break;
+        }
+
+        now_us = next_us;
+        if (next_us == change_us)
+        {
+            sw.channel = sw.change_channel[next_change];
+            sw.change_count--;
+            sw.change_us[next_change] = sw.change_us[sw.change_count];
+            sw.change_channel[next_change] = sw.change_channel[sw.change_count];
+            switch_ctrl_observe(&ctrl, sw.channel, now_us);
+        }
+        ctrl_deadline_us = switch_ctrl_update(&ctrl, now_us);
+    }
+    now_us = until_us;
+}
+
+static void run_for(int64_t us)
+{
+    run_until(now_us + us);
+}
+
+static void test_confirmed_by_the_leds(void)
+{
+    setup(2, 0);
+    request(1);
+    CHECK_EQ(sw.pulses, 1);
+    CHECK_EQ(ctrl.phase, SWITCH_CTRL_WAITING);
+    run_for(5000 * 1000);
+
+    CHECK_EQ(done.count, 1);
+    CHECK_EQ(done.target, 1);
+    CHECK(done.success);
+    CHECK_EQ(done.attempts, 1);
+    CHECK_EQ(done.latency_us, PULSE_MS * 1000 + REACT_US);
+    CHECK_EQ(sw.channel, 1);
+    CHECK_EQ(ctrl.phase, SWITCH_CTRL_IDLE);
+    CHECK_EQ(ctrl_deadline_us, SWITCH_CTRL_NO_DEADLINE);
+
+    // the current channel needs no pulse and no done callback
+    request(1);
+    CHECK_EQ(sw.pulses, 1);
+    CHECK_EQ(done.count, 1);
+}
+
+static void test_missed_pulse_is_retried(void)
+{
+    setup(2, 0);
+    sw.missed_left = 1;
+    request(1);
+    run_for(10 * 1000 * 1000);
+
+    CHECK_EQ(done.count, 1);
+    CHECK(done.success);
+    CHECK_EQ(done.attempts, 2);
+    CHECK_EQ(ctrl.retries, 1);
+    CHECK_EQ(sw.pulses, 2);
+    // the retry starts at the confirmation deadline of the first pulse
+    CHECK_EQ(done.latency_us, PULSE_MS * 1000 + CONFIRM_TIMEOUT_US + PULSE_MS * 1000 + REACT_US);
+}
+
+static void test_dead_switch_fails_after_max_attempts(void)
+{
+    setup(2, 0);
+    sw.missed_left = 1000;
+    request(1);
+    run_for(60LL * 1000 * 1000);
+
+    CHECK_EQ(done.count, 1);
+    CHECK(!done.success);
+    CHECK_EQ(done.attempts, MAX_ATTEMPTS);
+    CHECK_EQ(sw.pulses, MAX_ATTEMPTS);
+    CHECK_EQ(ctrl.failures, 1);
+    CHECK_EQ(done.latency_us, MAX_ATTEMPTS * (PULSE_MS * 1000 + CONFIRM_TIMEOUT_US));
+    CHECK_EQ(ctrl.phase, SWITCH_CTRL_IDLE);
+    CHECK_EQ(ctrl_deadline_us, SWITCH_CTRL_NO_DEADLINE);
+}
+
+static void test_requests_collapse_to_the_latest(void)
+{
+    setup(4, 0);
+    request(1);
+    run_for(10 * 1000);
+    request(2);
+    run_for(10 * 1000);
+    request(3);
+    run_for(10 * 1000 * 1000);
+
+    CHECK_EQ(done.count, 1);
+    CHECK_EQ(done.target, 3);
+    CHECK(done.success);
+    CHECK_EQ(done.attempts, 1);
+    CHECK_EQ(ctrl.coalesced, 2);
+    CHECK_EQ(sw.pulses, 3);
+    CHECK_EQ(sw.channel, 3);
+}
+
+static void test_burst_of_writes_needs_one_train(void)
+{
+    // the first write starts a pulse right away, the rest of the burst only moves the target
+    const int targets[] = {1, 3, 2, 0, 3, 1, 2};
+    setup(4, 0);
+    for (int i = 0; i < 7; ++i)
+    {
+        request(targets[i]);
+    }
+    run_for(10 * 1000 * 1000);
+
+    CHECK_EQ(done.count, 1);
+    CHECK_EQ(done.target, 2);
+    CHECK(done.success);
+    CHECK_EQ(sw.channel, 2);
+    CHECK_EQ(sw.pulses, 2);
+    CHECK_EQ(sw.wasted_pulses, 0);
+    CHECK_EQ(ctrl.coalesced, 6);
+    CHECK_EQ(ctrl.retries, 0);
+}
+
+static void test_write_flood_ends_on_the_latest_target(void)
+{
+    for (int round = 0; round < 100; ++round)
+    {
+        setup(4, (int)(random_word() % 4));
+        int target = sw.channel;
+        for (int i = 0; i < 50; ++i)
+        {
+            target = (int)(random_word() % 4);
+            request(target);
+            // from several writes per pulse up to pauses that let trains confirm
+            run_for(random_word() % (3 * (PULSE_MS + GAP_MS) * 1000));
+        }
+        run_for(30LL * 1000 * 1000);
+
+        CHECK_EQ(sw.channel, target);
+        CHECK_EQ(ctrl.current, target);
+        CHECK_EQ(ctrl.phase, SWITCH_CTRL_IDLE);
+        CHECK_EQ(ctrl.retries, 0);
+        CHECK_EQ(ctrl.failures, 0);
+        // every pulse was needed for the target at the time it was issued
+        CHECK_EQ(sw.wasted_pulses, 0);
+        if (done.count > 0)
+        {
+            CHECK_EQ(done.target, target);
+        }
+    }
+}
+
+static void test_unknown_start_continues_from_the_leds(void)
+{
+    setup_switch(4, 2, false);
+    CHECK_EQ(ctrl.current, SWITCH_CTRL_UNKNOWN);
+    request(1);
+    CHECK_EQ(sw.pulses, 1);
+    run_for(10 * 1000 * 1000);
+
+    // 2 -> 3 with the first pulse, then 3 -> 0 -> 1
+    CHECK_EQ(done.count, 1);
+    CHECK(done.success);
+    CHECK_EQ(sw.pulses, 3);
+    CHECK_EQ(sw.channel, 1);
+}
+
+static void test_pulse_counts_for_every_pair(void)
+{
+    const int channel_counts[] = {2, 4};
+    for (int c = 0; c < 2; ++c)
+    {
+        int channels = channel_counts[c];
+        for (int from = 0; from < channels; ++from)
+        {
+            for (int to = 0; to < channels; ++to)
+            {
+                int expected = (to - from + channels) % channels;
+                setup(channels, from);
+                CHECK_EQ(switch_ctrl_pulses_between(&ctrl, from, to), expected);
+                request(to);
+                run_for(30LL * 1000 * 1000);
+
+                // one train with the minimum number of pulses, spaced by pulse and gap
+                CHECK_EQ(sw.pulses, expected);
+                CHECK_EQ(sw.channel, to);
+                CHECK_EQ(done.count, expected > 0 ? 1 : 0);
+                CHECK_EQ(ctrl.retries, 0);
+                if (expected > 0)
+                {
+                    CHECK(done.success);
+                    CHECK_EQ(done.attempts, 1);
+                    CHECK_EQ(sw.last_pulse_us - sw.first_pulse_us, (expected - 1) * (PULSE_MS + GAP_MS) * 1000LL);
+                }
+            }
+        }
+        CHECK_EQ(switch_ctrl_pulses_between(&ctrl, SWITCH_CTRL_UNKNOWN, 0), 1);
+    }
+}
+
+static void test_channel_out_of_range_is_rejected(void)
+{
+    setup(2, 0);
+    request(2);
+    request(-1);
+    request(0xFFFF);
+    run_for(10 * 1000 * 1000);
+
+    CHECK_EQ(ctrl.rejected, 3);
+    CHECK_EQ(sw.pulses, 0);
+    CHECK_EQ(done.count, 0);
+    CHECK_EQ(ctrl.phase, SWITCH_CTRL_IDLE);
+
+    // a rejected request doesn't disturb a running one
+    request(1);
+    request(7);
+    run_for(10 * 1000 * 1000);
+    CHECK_EQ(done.count, 1);
+    CHECK_EQ(done.target, 1);
+    CHECK(done.success);
+    CHECK_EQ(sw.pulses, 1);
+}
+
+int main(void)
+{
+    RUN_TEST(test_confirmed_by_the_leds);
+    RUN_TEST(test_missed_pulse_is_retried);
+    RUN_TEST(test_dead_switch_fails_after_max_attempts);
+    RUN_TEST(test_requests_collapse_to_the_latest);
+    RUN_TEST(test_burst_of_writes_needs_one_train);
+    RUN_TEST(test_write_flood_ends_on_the_latest_target);
+    RUN_TEST(test_unknown_start_continues_from_the_leds);
+    RUN_TEST(test_pulse_counts_for_every_pair);
+    RUN_TEST(test_channel_out_of_range_is_rejected);
+    return TEST_RESULT();
+}
@@ -0,0 +1,215 @@
+/*
+ * timer_wheel.c on its own: order of equal deadlines, deadlines more than a revolution apart, stopping a due timer,
+ * restarting from inside an expiry and random operations against a sorted reference.
+ */
+
+#include <stddef.h>
+
+#include "test.h"
+#include "timer_wheel.h"
+
+#define TICK_US 1000
+#define REVOLUTION_US ((int64_t)TIMER_WHEEL_SLOTS * TICK_US)
+#define RANDOM_TIMERS 40
+
+static timer_wheel_t wheel;
+
+static int index_of(timer_wheel_entry_t *entries, timer_wheel_entry_t *entry)
+{
+    return entry != NULL ? (int)(entry - entries) : -1;
+}
+
+static void test_equal_deadlines_pop_in_start_order(void)
+{
+    timer_wheel_entry_t entries[4] = {0};
+    timer_wheel_init(&wheel, TICK_US);
+    timer_wheel_start(&wheel, &entries[2], 5000);
+    timer_wheel_start(&wheel, &entries[0], 5000);
+    timer_wheel_start(&wheel, &entries[3], 5000);
+    timer_wheel_start(&wheel, &entries[1], 5000);
+    // a restart goes behind the timers that were started before
+    timer_wheel_start(&wheel, &entries[0], 5000);
+
+    CHECK(timer_wheel_pop_expired(&wheel, 4999) == NULL);
+    CHECK_EQ(index_of(entries, timer_wheel_pop_expired(&wheel, 5000)), 2);
+    CHECK_EQ(index_of(entries, timer_wheel_pop_expired(&wheel, 5000)), 3);
+    CHECK_EQ(index_of(entries, timer_wheel_pop_expired(&wheel, 5000)), 1);
+    CHECK_EQ(index_of(entries, timer_wheel_pop_expired(&wheel, 5000)), 0);
+    CHECK(timer_wheel_pop_expired(&wheel, 5000) == NULL);
+    CHECK_EQ(timer_wheel_next_deadline(&wheel), TIMER_WHEEL_NO_DEADLINE);
+
+    // the start sequence wraps around
+    wheel.sequence = UINT32_MAX - 1;
+    for (int i = 0; i < 4; ++i)
+    {
+        timer_wheel_start(&wheel, &entries[i], 7000);
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+        CHECK_EQ(index_of(entries, timer_wheel_pop_expired(&wheel, 7000)), i);
+    }
+}
+
+static void test_deadlines_beyond_one_revolution(void)
+{
+    timer_wheel_entry_t entries[4] = {0};
+    timer_wheel_init(&wheel, TICK_US);
+    // entries 0 and 1 share a slot one revolution apart, 2 is in the last slot and 3 in the first one after it
+    int64_t base_us = 10 * REVOLUTION_US + 5 * TICK_US;
+    timer_wheel_start(&wheel, &entries[0], base_us + REVOLUTION_US);
+    timer_wheel_start(&wheel, &entries[1], base_us);
+    timer_wheel_start(&wheel, &entries[2], 11 * REVOLUTION_US - 1);
+    timer_wheel_start(&wheel, &entries[3], 11 * REVOLUTION_US);
+
+    CHECK_EQ(timer_wheel_next_deadline(&wheel), base_us);
+    CHECK_EQ(index_of(entries, timer_wheel_pop_expired(&wheel, base_us)), 1);
+    // the slot of entry 1 now has entry 0 at its head, which must wait for the next revolution
+    CHECK_EQ(timer_wheel_next_deadline(&wheel), 11 * REVOLUTION_US - 1);
+    CHECK(timer_wheel_pop_expired(&wheel, base_us + REVOLUTION_US - 1) != &entries[0]);
+    CHECK_EQ(index_of(entries, timer_wheel_pop_expired(&wheel, 100 * REVOLUTION_US)), 3);
+    CHECK_EQ(index_of(entries, timer_wheel_pop_expired(&wheel, 100 * REVOLUTION_US)), 0);
+    CHECK(timer_wheel_pop_expired(&wheel, 100 * REVOLUTION_US) == NULL);
+
+    // only far timers: the search falls back to comparing every slot
+    timer_wheel_start(&wheel, &entries[0], 500 * REVOLUTION_US + 3 * TICK_US);
+    timer_wheel_start(&wheel, &entries[1], 300 * REVOLUTION_US + 40 * TICK_US);
+    CHECK_EQ(timer_wheel_next_deadline(&wheel), 300 * REVOLUTION_US + 40 * TICK_US);
+    // a nearer timer than the cached one is picked up right away
+    timer_wheel_start(&wheel, &entries[2], -5);
+    CHECK_EQ(timer_wheel_next_deadline(&wheel), -5);
+    CHECK_EQ(index_of(entries, timer_wheel_pop_expired(&wheel, 0)), 2);
+    CHECK_EQ(timer_wheel_next_deadline(&wheel), 300 * REVOLUTION_US + 40 * TICK_US);
+}
+
+static void test_stopping_a_due_timer(void)
+{
+    timer_wheel_entry_t entries[3] = {0};
+    timer_wheel_init(&wheel, TICK_US);
+    timer_wheel_start(&wheel, &entries[0], 1000);
+    timer_wheel_start(&wheel, &entries[1], 1000);
+    timer_wheel_start(&wheel, &entries[2], 1500);
+
+    // all three are due, the first callback stops the next one and the cached earliest timer
+    CHECK_EQ(index_of(entries, timer_wheel_pop_expired(&wheel, 2000)), 0);
+    CHECK_EQ(timer_wheel_next_deadline(&wheel), 1000);
+    timer_wheel_stop(&wheel, &entries[1]);
+    CHECK(!entries[1].active);
+    CHECK_EQ(timer_wheel_next_deadline(&wheel), 1500);
+    CHECK_EQ(index_of(entries, timer_wheel_pop_expired(&wheel, 2000)), 2);
+    CHECK(timer_wheel_pop_expired(&wheel, 2000) == NULL);
+
+    // stopping twice or stopping a timer that already expired changes nothing
+    timer_wheel_stop(&wheel, &entries[1]);
+    timer_wheel_stop(&wheel, &entries[2]);
+    CHECK_EQ(wheel.active, 0);
+}
+
+static void test_restart_from_an_expiry(void)
+{
+    timer_wheel_entry_t entries[3] = {0};
+    timer_wheel_init(&wheel, TICK_US);
+    timer_wheel_start(&wheel, &entries[0], 1000);
+    timer_wheel_start(&wheel, &entries[1], 1000);
+    timer_wheel_start(&wheel, &entries[2], 3000);
+
+    // a pass collects everything due at 1000, like app_loop_run_pass()
+    int order[8];
+    int count = 0;
+    timer_wheel_entry_t *entry;
+    while ((entry = timer_wheel_pop_expired(&wheel, 1000)) != NULL && count < 8)
+    {
+        int index = index_of(entries, entry);
+        order[count++] = index;
+        if (index == 0 && count == 1)
+        {
+            // restarted for the same deadline: runs again in this pass, after the timers started before
+            timer_wheel_start(&wheel, &entries[0], 1000);
+        }
+        else if (index == 1)
+        {
+            // restarted for later: not in this pass
+            timer_wheel_start(&wheel, &entries[1], 2000);
+        }
+    }
+    CHECK_EQ(count, 3);
+    CHECK_EQ(order[0], 0);
+    CHECK_EQ(order[1], 1);
+    CHECK_EQ(order[2], 0);
+    CHECK_EQ(timer_wheel_next_deadline(&wheel), 2000);
+    CHECK_EQ(index_of(entries, timer_wheel_pop_expired(&wheel, 5000)), 1);
+    CHECK_EQ(index_of(entries, timer_wheel_pop_expired(&wheel, 5000)), 2);
+}
+
+static uint32_t random_state = 7;
+
+static uint32_t random_word(void)
+{
+    random_state = random_state * 1664525u + 1013904223u;
+    return random_state >> 8;
+}
+
+/* the active timer that has to run first, by a search over all of them */
+static timer_wheel_entry_t *reference_earliest(timer_wheel_entry_t *entries)
+{
+    timer_wheel_entry_t *earliest = NULL;
+    for (int i = 0; i < RANDOM_TIMERS; ++i)
+    {
+        timer_wheel_entry_t *entry = &entries[i];
+        if (entry->active &&
+            (earliest == NULL || entry->deadline_us < earliest->deadline_us ||
+             (entry->deadline_us == earliest->deadline_us && (int32_t)(entry->sequence - earliest->sequence) < 0)))
+        {
+            earliest = entry;
+        }
+    }
+    return earliest;
+}
+
+static void test_random_operations_match_a_sorted_reference(void)
+{
+    timer_wheel_entry_t entries[RANDOM_TIMERS] = {0};
+    timer_wheel_init(&wheel, TICK_US);
+    int64_t now_us = 0;
+    int mismatches = 0;
+
+    for (int step = 0; step < 200000; ++step)
+    {
+        timer_wheel_entry_t *entry = &entries[random_word() % RANDOM_TIMERS];
+        uint32_t action = random_word() % 8;
+        if (action < 4)
+        {
+            // mostly near deadlines, some several revolutions ahead and some in the past
+            int64_t delay_us = action == 0 ? (int64_t)(random_word() % (8 * REVOLUTION_US))
+                                           : (int64_t)(random_word() % (2 * TICK_US)) - TICK_US / 2;
+            timer_wheel_start(&wheel, entry, now_us + delay_us);
+        }
+        else if (action == 4)
+        {
+            timer_wheel_stop(&wheel, entry);
+        }
+        else
+        {
+            now_us += random_word() % (3 * TICK_US);
+            timer_wheel_entry_t *expected = reference_earliest(entries);
+            if (expected != NULL && expected->deadline_us > now_us)
+            {
+                expected = NULL;
+            }
+            mismatches += timer_wheel_pop_expired(&wheel, now_us) != expected;
+        }
+        timer_wheel_entry_t *earliest = reference_earliest(entries);
+        mismatches += timer_wheel_next_deadline(&wheel) !=
+                      (earliest != NULL ? earliest->deadline_us : TIMER_WHEEL_NO_DEADLINE);
+    }
+    CHECK_EQ(mismatches, 0);
+}
+
+int main(void)
+{
+    RUN_TEST(test_equal_deadlines_pop_in_start_order);
+    RUN_TEST(test_deadlines_beyond_one_revolution);
+    RUN_TEST(test_stopping_a_due_timer);
+    RUN_TEST(test_restart_from_an_expiry);
+    RUN_TEST(test_random_operations_match_a_sorted_reference);
+    return TEST_RESULT();
+}
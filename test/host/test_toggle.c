@@ -0,0 +1,215 @@
+/*
+ * Pulse engine of toggle.c on the simulated app loop: pulse width and minimum gap of queued pulses,
+ * the bounded queue, gpio_set_level failures, the stored timing and a flat heap over 100k toggles.
+ */
+
+#include <malloc.h>
+
+#include "app_loop.h"
+#include "host_sim.h"
+#include "test.h"
+#include "toggle.h"
+
+#define OUTPUT GPIO_NUM_20
+#define PULSE_MS 200
+#define GAP_MS 50
+#define MANY_TOGGLES 100000
+
+typedef struct level_change_t
+{
+    int level;
+    int64_t time_us;
+} level_change_t;
+
+static level_change_t changes[64];
+static int change_count = 0;
+static int callbacks_on = 0;
+static int callbacks_off = 0;
+
+static void output_hook(int gpio_num, int level)
+{
+    if (gpio_num == OUTPUT && change_count < (int)(sizeof(changes) / sizeof(changes[0])))
+    {
+        changes[change_count++] = (level_change_t){level, host_now_us()};
+    }
+}
+
+static void pulse_callback(uint8_t gpio_pin, bool on)
+{
+    if (gpio_pin == OUTPUT)
+    {
+        if (on)
+        {
+            callbacks_on++;
+        }
+        else
+        {
+            callbacks_off++;
+        }
+    }
+}
+
+static void reset_recording(void)
+{
+    change_count = 0;
+    callbacks_on = 0;
+    callbacks_off = 0;
+}
+
+static void advance(int64_t us)
+{
+    host_loop_run_until(host_now_us() + us);
+}
+
+static toggle_stats_t stats(void)
+{
+    toggle_stats_t stats;
+    CHECK_EQ(toggle_get_stats(OUTPUT, &stats), ESP_OK);
+    return stats;
+}
+
+static void test_queued_pulses_keep_the_gap(void)
+{
+    reset_recording();
+    int64_t start_us = host_now_us();
+    CHECK_EQ(toggle_gpio(OUTPUT, PULSE_MS), ESP_OK);
+    CHECK_EQ(toggle_gpio(OUTPUT, PULSE_MS), ESP_OK);
+    CHECK_EQ(toggle_gpio(OUTPUT, 2 * PULSE_MS), ESP_OK);
+    CHECK_EQ(stats().queue_depth, 2);
+    advance(2000 * 1000);
+
+    // on / off pairs, the output is active low
+    int64_t expected_us[] = {0, PULSE_MS, PULSE_MS + GAP_MS, 2 * PULSE_MS + GAP_MS,
+                             2 * PULSE_MS + 2 * GAP_MS, 4 * PULSE_MS + 2 * GAP_MS};
+    CHECK_EQ(change_count, 6);
+    for (int i = 0; i < change_count && i < 6; ++i)
+    {
+        CHECK_EQ(changes[i].level, i % 2 == 0 ? GPIO_OUTPUT_LEVEL_ON : GPIO_OUTPUT_LEVEL_OFF);
+        CHECK_EQ(changes[i].time_us - start_us, expected_us[i] * 1000);
+    }
+    CHECK_EQ(callbacks_on, 3);
+    CHECK_EQ(callbacks_off, 3);
+    CHECK_EQ(stats().queue_depth, 0);
+    CHECK_EQ(host_loop_next_deadline(), INT64_MAX);
+}
+
+static void test_full_queue_drops_pulses(void)
+{
+    toggle_stats_t before = stats();
+    CHECK_EQ(toggle_gpio(OUTPUT, PULSE_MS), ESP_OK);
+    for (int i = 0; i < TOGGLE_QUEUE_DEPTH; ++i)
+    {
+        CHECK_EQ(toggle_gpio(OUTPUT, PULSE_MS), ESP_OK);
+    }
+    CHECK_EQ(toggle_gpio(OUTPUT, PULSE_MS), ESP_ERR_NO_MEM);
+    advance(5000 * 1000);
+
+    toggle_stats_t after = stats();
+    CHECK_EQ(after.pulses - before.pulses, TOGGLE_QUEUE_DEPTH + 1);
+    CHECK_EQ(after.queued - before.queued, TOGGLE_QUEUE_DEPTH);
+    CHECK_EQ(after.dropped - before.dropped, 1);
+    CHECK_EQ(after.max_queue_depth, TOGGLE_QUEUE_DEPTH);
+    CHECK_EQ(toggle_gpio(99, PULSE_MS), ESP_ERR_INVALID_STATE);
+}
+
+static void test_failed_start_drops_the_pulse(void)
+{
+    reset_recording();
+    toggle_stats_t before = stats();
+    int64_t start_us = host_now_us();
+    host_gpio_fail_set_level(1);
+    CHECK_EQ(toggle_gpio(OUTPUT, PULSE_MS), ESP_FAIL);
+    // the engine keeps the gap after the failed attempt and continues with the next pulse
+    CHECK_EQ(toggle_gpio(OUTPUT, PULSE_MS), ESP_OK);
+    advance(1000 * 1000);
+
+    CHECK_EQ(stats().failed - before.failed, 1);
+    CHECK_EQ(stats().pulses - before.pulses, 1);
+    CHECK_EQ(callbacks_on, 1);
+    CHECK_EQ(change_count, 2);
+    CHECK_EQ(changes[0].time_us - start_us, GAP_MS * 1000);
+    CHECK_EQ(host_gpio_get_level(OUTPUT), GPIO_OUTPUT_LEVEL_OFF);
+}
+
+static void test_failed_end_is_retried(void)
+{
+    reset_recording();
+    toggle_stats_t before = stats();
+    int64_t start_us = host_now_us();
+    CHECK_EQ(toggle_gpio(OUTPUT, PULSE_MS), ESP_OK);
+    host_gpio_fail_set_level(1);
+    advance(PULSE_MS * 1000);
+    CHECK_EQ(host_gpio_get_level(OUTPUT), GPIO_OUTPUT_LEVEL_ON);
+    CHECK_EQ(callbacks_off, 0);
+
+    advance(1000 * 1000);
+    CHECK_EQ(stats().failed - before.failed, 1);
+    CHECK_EQ(change_count, 2);
+    CHECK_EQ(changes[1].level, GPIO_OUTPUT_LEVEL_OFF);
+    CHECK_EQ(changes[1].time_us - start_us, (PULSE_MS + GAP_MS) * 1000);
+    CHECK_EQ(callbacks_off, 1);
+    CHECK_EQ(host_loop_next_deadline(), INT64_MAX);
+}
+
+static void test_stored_timing(void)
+{
+    toggle_timing_t timing;
+    host_nvs_erase();
+    CHECK(toggle_load_timing() != ESP_OK);
+
+    toggle_timing_t calibrated = {.pulse_ms = 60, .gap_ms = 30};
+    toggle_set_timing(&calibrated);
+    CHECK_EQ(toggle_save_timing(), ESP_OK);
+    toggle_timing_t other = {.pulse_ms = PULSE_MS, .gap_ms = GAP_MS};
+    toggle_set_timing(&other);
+
+    CHECK_EQ(toggle_load_timing(), ESP_OK);
+    toggle_get_timing(&timing);
+    CHECK_EQ(timing.pulse_ms, 60);
+    CHECK_EQ(timing.gap_ms, 30);
+    toggle_set_timing(&other);
+}
+
+static void test_many_toggles_keep_the_heap_flat(void)
+{
+    toggle_stats_t before = stats();
+    struct mallinfo2 heap_before = mallinfo2();
+
+    for (int i = 0; i < MANY_TOGGLES / (TOGGLE_QUEUE_DEPTH + 1); ++i)
+    {
+        for (int j = 0; j < TOGGLE_QUEUE_DEPTH + 1; ++j)
+        {
+            toggle_gpio(OUTPUT, PULSE_MS);
+        }
+        advance((TOGGLE_QUEUE_DEPTH + 1) * (PULSE_MS + GAP_MS) * 1000);
+    }
+
+    struct mallinfo2 heap_after = mallinfo2();
+    toggle_stats_t after = stats();
+    CHECK_EQ(after.pulses - before.pulses, MANY_TOGGLES);
+    CHECK_EQ(after.dropped, before.dropped);
+    CHECK_EQ(heap_after.uordblks, heap_before.uordblks);
+    CHECK_EQ(heap_after.hblkhd, heap_before.hblkhd);
+    CHECK_EQ(host_gpio_get_level(OUTPUT), GPIO_OUTPUT_LEVEL_OFF);
+    CHECK_EQ(host_loop_next_deadline(), INT64_MAX);
+}
+
+int main(void)
+{
+    CHECK_EQ(app_loop_init(), ESP_OK);
+    CHECK_EQ(toggle_driver_gpio_init(OUTPUT), ESP_OK);
+    CHECK_EQ(toggle_driver_gpio_init(OUTPUT), ESP_OK);
+    CHECK_EQ(host_gpio_get_level(OUTPUT), GPIO_OUTPUT_LEVEL_OFF);
+    toggle_timing_t timing = {.pulse_ms = PULSE_MS, .gap_ms = GAP_MS};
+    toggle_set_timing(&timing);
+    toggle_set_pulse_callback(pulse_callback);
+    host_gpio_set_output_hook(output_hook);
+
+    RUN_TEST(test_queued_pulses_keep_the_gap);
+    RUN_TEST(test_full_queue_drops_pulses);
+    RUN_TEST(test_failed_start_drops_the_pulse);
+    RUN_TEST(test_failed_end_is_retried);
+    RUN_TEST(test_stored_timing);
+    RUN_TEST(test_many_toggles_keep_the_heap_flat);
+    return TEST_RESULT();
+}
@@ -0,0 +1,99 @@
+/*
+ * vertical_debounce.c against a per-pin counter model: both have to report the same changes
+ * for every sample of random bouncing inputs.
+ */
+
+#include <stdlib.h>
+
+#include "test.h"
+#include "vertical_debounce.h"
+
+/* rand() leaves the top bit clear */
+static uint32_t random_word(void)
+{
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+/* per-pin reference: a pin flips after VERTICAL_DEBOUNCE_SAMPLES consecutive samples that differ from its state */
+typedef struct reference_t
+{
+    uint32_t state;
+    uint8_t count[32];
+} reference_t;
+
+static uint32_t reference_sample(reference_t *ref, uint32_t sample)
+{
+    uint32_t changed = 0;
+    for (int bit = 0; bit < 32; ++bit)
+    {
+        if (((sample ^ ref->state) >> bit) & 1)
+        {
+            if (++ref->count[bit] == VERTICAL_DEBOUNCE_SAMPLES)
+            {
+                ref->count[bit] = 0;
+                changed |= 1UL << bit;
+            }
+        }
+        else
+        {
+            ref->count[bit] = 0;
+        }
+    }
+    ref->state ^= changed;
+    return changed;
+}
+
+static void test_change_after_four_samples(void)
+{
+    vertical_debounce_t vd;
+    vertical_debounce_init(&vd, 0xFFFFFFFF);
+    for (int i = 1; i < VERTICAL_DEBOUNCE_SAMPLES; ++i)
+    {
+        CHECK_EQ(vertical_debounce_sample(&vd, 0xFFFFFFFE), 0);
+    }
+    CHECK_EQ(vertical_debounce_sample(&vd, 0xFFFFFFFE), 1);
+    CHECK_EQ(vd.state, 0xFFFFFFFE);
+    CHECK_EQ(vertical_debounce_sample(&vd, 0xFFFFFFFE), 0);
+}
+
+static void test_bounce_restarts_count(void)
+{
+    vertical_debounce_t vd;
+    vertical_debounce_init(&vd, 0);
+    const uint32_t samples[] = {1, 1, 1, 0, 1, 1, 1};
+    for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); ++i)
+    {
+        CHECK_EQ(vertical_debounce_sample(&vd, samples[i]), 0);
+    }
+    CHECK_EQ(vertical_debounce_sample(&vd, 1), 1);
+}
+
+static void test_matches_per_pin_model(void)
+{
+    srand(4);
+    vertical_debounce_t vd;
+    reference_t ref = {0};
+    vertical_debounce_init(&vd, 0);
+    uint32_t levels = 0;
+    for (int i = 0; i < 200000; ++i)
+    {
+        // a few pins change their level, others bounce for a sample
+        levels ^= random_word() & random_word() & random_word();
+        uint32_t bounce = random_word() & random_word() & random_word() & random_word();
+        uint32_t sample = levels ^ bounce;
+        CHECK_EQ(vertical_debounce_sample(&vd, sample), reference_sample(&ref, sample));
+        CHECK_EQ(vd.state, ref.state);
+        if (test_failures > 0)
+        {
+            break;
+        }
+    }
+}
+
+int main(void)
+{
+    RUN_TEST(test_change_after_four_samples);
+    RUN_TEST(test_bounce_restarts_count);
+    RUN_TEST(test_matches_per_pin_model);
+    return TEST_RESULT();
+}
@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+"""
+tools/tlog.py against the firmware's tlog.c: builds the token database from log_tokens.def, decodes the output
+of tlog_messages built with TLOG_TOKENIZED=1 and compares it line by line with the same messages built without.
+
+Usage: check_tlog.py <tlog.py> <log_tokens.def> <tlog_messages_text> <tlog_messages_tokenized>
+"""
+
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+
+def main():
+    if len(sys.argv) != 5:
+        print(__doc__.strip())
+        return 2
+    tlog_py, def_path, text_exe, tokenized_exe = sys.argv[1:]
+
+    with tempfile.TemporaryDirectory() as tmp:
+        db_path = os.path.join(tmp, "log_tokens.json")
+        subprocess.run([sys.executable, tlog_py, "db", def_path, db_path], check=True)
+        with open(db_path, "r", encoding="utf-8") as f:
+            tokens = json.load(f)["tokens"]
+
+        text = subprocess.run([text_exe], check=True, capture_output=True, text=True).stdout
+        tokenized = subprocess.run([tokenized_exe], check=True, capture_output=True, text=True).stdout
+        decoded = subprocess.run([sys.executable, tlog_py, "decode", db_path], input=tokenized, check=True,
+                                 capture_output=True, text=True).stdout
+
+    errors = []
+    # the database has every message of the .def in order, with the formats the text mode prints
+    with open(def_path, "r", encoding="utf-8") as f:
+        names = re.findall(r"^LOG_TOKEN\((\w+),", f.read(), re.MULTILINE)
+    if [t["name"] for t in tokens] != names or [t["token"] for t in tokens] != list(range(len(names))):
+        errors.append(f"database {[(t['token'], t['name']) for t in tokens]} doesn't match {names}")
+
+    text_lines = text.splitlines()
+    tokenized_lines = tokenized.splitlines()
+    decoded_lines = decoded.splitlines()
+    if len(text_lines) != len(tokens):
+        errors.append(f"{len(text_lines)} text lines for {len(tokens)} messages, log every message once")
+    if not all(line.startswith("$TL ") for line in tokenized_lines):
+        errors.append(f"tokenized output has lines that aren't records: {tokenized_lines}")
+    for line, (expected, actual) in enumerate(zip(text_lines, decoded_lines), start=1):
+        if expected != actual:
+            errors.append(f"line {line}: text '{expected}', decoded '{actual}'")
+    if len(decoded_lines) != len(text_lines):
+        errors.append(f"{len(decoded_lines)} decoded lines, {len(text_lines)} text lines")
+
+    for error in errors:
+        print(error)
+    if not errors:
+        print(f"{len(text_lines)} messages decode to the text output")
+    return 1 if errors else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
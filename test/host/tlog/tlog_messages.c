@@ -0,0 +1,27 @@
+/*
+ * Logs every message of log_tokens.def once through the TLOG macros, built with and without TLOG_TOKENIZED.
+ * check_tlog.py decodes the tokenized output with tools/tlog.py and compares it with the text output.
+ * Arguments cover negative %i, zero padding, %lx and unsigned values above INT32_MAX.
+ */
+
+#include "host_sim.h"
+#include "tlog.h"
+
+/* the tag tools/tlog.py prints, the tokenized build doesn't use it */
+static const char *TAG __attribute__((unused)) = "tlog";
+
+int main(void)
+{
+    // timestamps are printed in decimal and hex
+    host_loop_run_until(123456789);
+    TLOGI(INPUT_CHANGED, 21, -1);
+    TLOGW(ZB_ATTRIBUTE_RECEIVED, 10, 0x14u, 0x55u, 2);
+    TLOGI(ZB_STATE_REQUESTED, -2147483647 - 1);
+    TLOGE(ZB_DEFAULT_RESPONSE, 0x1u, 1, 20, 0x86u);
+    TLOGI(SWITCH_STATE_CHANGED, 3);
+    TLOGD(SWITCH_ATTRIBUTE_UPDATED, 4, 0);
+    TLOGI(SWITCH_STATE_REPORTED, 4000000000u);
+    TLOGD(OTA_UPGRADE_VALUE, 0x2u, (unsigned long)0x01020304, 0x1u, 4096u);
+    tlog_flush();
+    return 0;
+}
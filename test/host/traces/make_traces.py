@@ -0,0 +1,196 @@
+#!/usr/bin/env python3
+"""
+Writes the synthetic edge traces for input_replay (see input_replay.c for the format).
+
+The traces are deterministic, rerun this after changing it and commit the results:
+    python3 test/host/traces/make_traces.py test/host/traces
+
+Inputs (main/input_pins.h): GPIO9 boot button (30 ms debounce), GPIO19 / GPIO18 channel LEDs (50 ms),
+GPIO21 unconnected (250 ms). Level 0 is a pressed button or a lit LED.
+"""
+
+import os
+import random
+import sys
+
+BUTTON = 9
+LED_CH_1 = 19
+LED_CH_2 = 18
+FLOATING = 21
+
+BUTTON_DEBOUNCE_US = 30_000
+LED_DEBOUNCE_US = 50_000
+
+
+class Trace:
+    def __init__(self, description):
+        self.description = description
+        self.changes = []
+        self.presses = []
+        self.expects = []
+
+    def level(self, time_us, gpio, level):
+        self.changes.append((int(time_us), gpio, level))
+
+    def press(self, gpio, down_us, up_us):
+        self.presses.append((gpio, int(down_us), int(up_us)))
+
+    def expect(self, metric, op, value):
+        self.expects.append((metric, op, value))
+
+    def write(self, path):
+        self.changes.sort(key=lambda change: change[0])
+        with open(path, "w", encoding="utf-8") as f:
+            for line in self.description.strip().splitlines():
+                f.write(f"# {line}\n".replace("# \n", "#\n"))
+            f.write("# generated by make_traces.py\n\n")
+            for gpio, down_us, up_us in self.presses:
+                f.write(f"press {gpio} {down_us} {up_us}\n")
+            f.write("\n")
+            for metric, op, value in self.expects:
+                f.write(f"expect {metric} {op} {value}\n")
+            f.write("\n")
+            for time_us, gpio, level in self.changes:
+                f.write(f"{time_us} {gpio} {level}\n")
+
+
+def bounce(trace, rng, time_us, gpio, level, max_edges, max_gap_us):
+    """Contact bounce: an odd number of extra edges after the first one, ending at level. Returns the final edge."""
+    trace.level(time_us, gpio, level)
+    for i in range(rng.randrange(1, max_edges // 2 + 1) * 2):
+        time_us += rng.randint(20, max_gap_us)
+        trace.level(time_us, gpio, level if i % 2 else 1 - level)
+    return time_us
+
+
+def channel_switches(trace, start_us, count, period_us, edge):
+    """The switch moves between channel 1 and 2, one LED goes out as the other one lights up."""
+    lit, dark = LED_CH_1, LED_CH_2
+    trace.press(lit, start_us, start_us + period_us)
+    edge(start_us, lit, 0)
+    for i in range(1, count):
+        t = start_us + i * period_us
+        edge(t, lit, 1)
+        lit, dark = dark, lit
+        edge(t + 300, lit, 0)
+        trace.press(lit, t + 300, t + period_us)
+    edge(start_us + count * period_us, lit, 1)
+
+
+def clean():
+    trace = Trace("""
+Clean presses: five boot button presses of 200 ms and four channel switches, no bounce at all.
+Every press is reported once, exactly one debounce time after its edge.
+""")
+    for i in range(5):
+        down = 1_000_000 + i * 3_000_000
+        trace.level(down, BUTTON, 0)
+        trace.level(down + 200_000, BUTTON, 1)
+        trace.press(BUTTON, down, down + 200_000)
+    channel_switches(trace, 20_000_000, 4, 3_000_000, trace.level)
+    trace.expect("events", "==", 2 * 9)
+    trace.expect("missed", "==", 0)
+    trace.expect("spurious", "==", 0)
+    trace.expect("max_latency_us", "==", LED_DEBOUNCE_US)
+    trace.expect("glitches", "==", 0)
+    return trace
+
+
+def heavy_bounce():
+    trace = Trace("""
+Heavy bounce: twenty boot button presses with up to 40 bounce edges within a few ms on both edges,
+and channel switches whose optocoupler outputs chatter for up to 8 ms.
+Every press is reported once, one debounce time after the final edge of its burst.
+""")
+    rng = random.Random(6)
+    for i in range(20):
+        down = 1_000_000 + i * 2_500_000
+        up = down + rng.randint(150_000, 600_000)
+        bounce(trace, rng, down, BUTTON, 0, 40, 200)
+        bounce(trace, rng, up, BUTTON, 1, 40, 200)
+        trace.press(BUTTON, down, up)
+
+    def chatter(time_us, gpio, level):
+        bounce(trace, rng, time_us, gpio, level, 16, 1000)
+
+    channel_switches(trace, 60_000_000, 10, 2_000_000, chatter)
+    trace.expect("events", "==", 2 * 30)
+    trace.expect("missed", "==", 0)
+    trace.expect("spurious", "==", 0)
+    trace.expect("max_latency_us", "==", LED_DEBOUNCE_US)
+    trace.expect("storms", "==", 0)
+    return trace
+
+
+def glitches():
+    trace = Trace("""
+Glitches: pulses shorter than the debounce time on the boot button and the LED inputs, some of them bouncing,
+between three real button presses. No glitch is reported, every one is counted, the presses still are.
+""")
+    rng = random.Random(7)
+    t = 1_000_000
+    count = 0
+    for i in range(30):
+        gpio = [BUTTON, LED_CH_1, LED_CH_2][i % 3]
+        limit = BUTTON_DEBOUNCE_US if gpio == BUTTON else LED_DEBOUNCE_US
+        end = t + rng.randint(200, limit * 2 // 3)
+        trace.level(t, gpio, 0)
+        if rng.random() < 0.5:
+            end = bounce(trace, rng, end, gpio, 1, 6, 300)
+        else:
+            trace.level(end, gpio, 1)
+        count += 1
+        t = end + 500_000
+        if i % 10 == 9:
+            trace.level(t, BUTTON, 0)
+            trace.level(t + 250_000, BUTTON, 1)
+            trace.press(BUTTON, t, t + 250_000)
+            t += 3_000_000
+    trace.expect("events", "==", 6)
+    trace.expect("missed", "==", 0)
+    trace.expect("spurious", "==", 0)
+    trace.expect("glitches", "==", count)
+    return trace
+
+
+def floating_gpio21():
+    trace = Trace("""
+Floating GPIO21: five bursts of noise of 400 ms with edges every 50 us to 2 ms on the unconnected input,
+while the boot button is pressed. The storm protection masks the interrupt after 50 edges per burst,
+so the ISR load stays bounded, and the button presses are still reported on time.
+""")
+    rng = random.Random(21)
+    level = 1
+    for burst in range(5):
+        start = 1_000_000 + burst * 4_000_000
+        t = start
+        while t < start + 400_000:
+            level = 1 - level
+            trace.level(t, FLOATING, level)
+            t += rng.randint(50, 2_000)
+        # the pull-up wins once the noise stops
+        if level == 0:
+            trace.level(t, FLOATING, 1)
+            level = 1
+        down = start + 100_000
+        trace.level(down, BUTTON, 0)
+        trace.level(down + 200_000, BUTTON, 1)
+        trace.press(BUTTON, down, down + 200_000)
+    trace.expect("missed", "==", 0)
+    trace.expect("spurious", "==", 0)
+    trace.expect("storms", "==", 5)
+    # 51 edges per burst before the pin is masked, 2 per button press
+    trace.expect("isr_calls", "<=", 5 * (51 + 2))
+    trace.expect("max_latency_us", "<=", BUTTON_DEBOUNCE_US)
+    return trace
+
+
+def main():
+    out_dir = sys.argv[1] if len(sys.argv) > 1 else os.path.dirname(os.path.abspath(__file__))
+    for name, make in (("clean", clean), ("bounce", heavy_bounce), ("glitch", glitches),
+                       ("floating_gpio21", floating_gpio21)):
+        make().write(os.path.join(out_dir, f"{name}.trace"))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""
+Checks the linker map of a build for input path code or data that ended up in flash.
+
+The gpio ISR is registered with ESP_INTR_FLAG_IRAM and keeps running while the flash cache is
+disabled (e.g. during OTA writes). Everything it calls has to be in IRAM and everything it touches
+in DRAM, otherwise the chip crashes with a cache error as soon as an input changes during a flash write.
+
+ESP-IDF builds with -ffunction-sections / -fdata-sections, so a function or variable that is linked
+normally shows up as input section .text.<name> / .bss.<name> etc. IRAM_ATTR code is placed in
+anonymous .iram1.* sections and doesn't show up by name, which is fine: only named hot path code in a
+flash output section is reported. Global functions are also listed by their symbol, which is enough to
+know that the map belongs to the firmware. A map without any input path function is an error, the
+names are probably out of date or the build wasn't made with -ffunction-sections.
+
+test/host builds GNU ld maps of the host objects with output sections named like the ESP-IDF ones and
+checks this script against them, it has no map of a real firmware build to run on.
+
+Usage: python3 tools/check_iram.py build/zigbee-switcher.map
+"""
+
+import re
+import sys
+
+# code executed by gpio_interrupt_handler, most of it is expected to be inlined
+HOT_FUNCTIONS = [
+    "gpio_interrupt_handler",
+    "edge_ring_push",
+    "edge_storm_isr_edge",
+    "gpio_input_port_get_level",
+    "gpio_input_port_now_us",
+    "gpio_input_port_intr_disable",
+    "gpio_input_port_arm_level",
+    "gpio_ll_get_level",
+    "gpio_ll_intr_disable",
+    "gpio_ll_set_intr_type",
+    "esp_timer_get_time",
+    "app_loop_signal_from_isr",
+    "xTaskGenericNotifyFromISR",
+]
+
+# data read or written by gpio_interrupt_handler
+HOT_DATA = [
+    "internal_config",
+    "edge_ring",
+    "app_loop_task_handle",
+]
+
+FLASH_SECTIONS = (".flash.", ".rodata")
+DRAM_SECTIONS = (".dram0.",)
+
+OUTPUT_SECTION_RE = re.compile(r"^(\.[\w.]+)")
+INPUT_SECTION_RE = re.compile(r"^\s+(\.[\w.$]+)")
+SYMBOL_RE = re.compile(r"^\s+0x[0-9a-fA-F]+\s+([A-Za-z_][\w.$]*)\s*$")
+
+
+def parse_map(path):
+    """
+    Yields (output section, input section, None) for every input section of the memory map
+    and (output section, None, symbol) for every symbol listed with its address.
+    """
+    output_section = None
+    in_memory_map = False
+    with open(path, "r", encoding="utf-8", errors="replace") as f:
+        for line in f:
+            if line.startswith("Linker script and memory map"):
+                in_memory_map = True
+                continue
+            if not in_memory_map:
+                continue
+            m = OUTPUT_SECTION_RE.match(line)
+            if m:
+                output_section = m.group(1)
+                continue
+            if output_section is None:
+                continue
+            m = INPUT_SECTION_RE.match(line)
+            if m:
+                yield output_section, m.group(1), None
+                continue
+            m = SYMBOL_RE.match(line)
+            if m:
+                yield output_section, None, m.group(1)
+
+
+def section_symbol(input_section, prefixes):
+    for prefix in prefixes:
+        if input_section.startswith(prefix):
+            return input_section[len(prefix):]
+    return None
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(__doc__.strip().splitlines()[-1])
+        return 2
+
+    errors = []
+    found_functions = set()
+    found_data = set()
+
+    for output_section, input_section, symbol in parse_map(sys.argv[1]):
+        if symbol is not None:
+            if symbol in HOT_FUNCTIONS:
+                found_functions.add(symbol)
+            continue
+
+        name = section_symbol(input_section, (".text.", ".literal."))
+        if name in HOT_FUNCTIONS:
+            found_functions.add(name)
+            if output_section.startswith(FLASH_SECTIONS):
+                errors.append(f"function {name} is in {output_section}")
+
+        name = section_symbol(input_section, (".bss.", ".sbss.", ".data.", ".sdata.", ".rodata."))
+        if name in HOT_DATA:
+            found_data.add(name)
+            if not output_section.startswith(DRAM_SECTIONS):
+                errors.append(f"variable {name} is in {output_section}")
+
+    if not found_functions:
+        errors.append("none of the input path functions is in the map, is it a map of the firmware built with -ffunction-sections?")
+    for name in HOT_DATA:
+        if name not in found_data:
+            errors.append(f"variable {name} not found in the map, was it renamed?")
+
+    for error in errors:
+        print(f"check_iram: {error}", file=sys.stderr)
+    if errors:
+        return 1
+
+    print(f"check_iram: {len(HOT_FUNCTIONS)} functions and {len(HOT_DATA)} variables of the input ISR path are flash free")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
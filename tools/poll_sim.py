@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""
+Compares the latency of commands sent to the end device with the fixed poll interval (ED_KEEP_ALIVE)
+and with the poll control policy.
+
+This is a Python model of the policy of main/poll_policy.c, it doesn't run the firmware code. The C
+policy is tested on the host by test/host/test_poll_policy.c, keep the two in step when either changes.
+
+The parent buffers commands for the end device, they are delivered with the next poll. With the
+policy the device polls every short poll interval during a fast poll window, which opens after local
+activity, after every delivered command (more are likely to follow) and after check-ins.
+
+Schedule, one event per line, '#' starts a comment:
+  <ms> write [count] [spacing ms]   commands queued at the parent, e.g. a batch of an automation
+  <ms> press                        local activity, e.g. a button press reported to the coordinator
+
+Usage:
+  python3 tools/poll_sim.py schedule.txt
+  printf '1000 write 3 400\\n20000 press\\n20300 write\\n' | python3 tools/poll_sim.py -
+"""
+
+import argparse
+import sys
+
+
+def parse_schedule(lines):
+    events = []
+    for number, line in enumerate(lines, 1):
+        line = line.split("#", 1)[0].strip()
+        if not line:
+            continue
+        fields = line.split()
+        if fields[1:2] == ["write"] and len(fields) <= 4:
+            count = int(fields[2]) if len(fields) > 2 else 1
+            spacing = int(fields[3]) if len(fields) > 3 else 0
+            events.extend((int(fields[0]) + i * spacing, "write") for i in range(count))
+        elif fields[1:2] == ["press"] and len(fields) == 2:
+            events.append((int(fields[0]), "press"))
+        else:
+            raise ValueError(f"line {number}: expected '<ms> write [count] [spacing ms]' or '<ms> press'")
+    return sorted(events)
+
+
+def simulate(events, duration_ms, args, policy):
+    """returns the latencies of all commands and the number of polls"""
+    presses = {at for at, kind in events if kind == "press"}
+    writes = sorted(at for at, kind in events if kind == "write")
+    queued = []
+    latencies = []
+    polls = 0
+
+    fast_until = -1
+    check_in_due = args.check_in_ms if policy and args.check_in_ms else None
+    interval = args.long_poll_ms
+    last_poll = 0
+    next_poll = 0
+    next_write = 0
+
+    def open_window(now):
+        nonlocal fast_until
+        fast_until = max(fast_until, now + args.fast_poll_timeout_ms)
+
+    for now in range(duration_ms):
+        while next_write < len(writes) and writes[next_write] <= now:
+            queued.append(writes[next_write])
+            next_write += 1
+
+        if policy:
+            if now in presses:
+                open_window(now)
+            if check_in_due is not None and now >= check_in_due:
+                check_in_due = now + args.check_in_ms
+                open_window(now)
+            wanted = args.short_poll_ms if now < fast_until else args.long_poll_ms
+            if wanted != interval:
+                interval = wanted
+                next_poll = min(next_poll, now + interval) if interval == args.short_poll_ms else last_poll + interval
+                next_poll = max(next_poll, now)
+
+        if now >= next_poll:
+            polls += 1
+            last_poll = now
+            next_poll = now + interval
+            if queued:
+                latencies.extend(now - at for at in queued)
+                queued.clear()
+                if policy:
+                    open_window(now)
+                    if interval != args.short_poll_ms:
+                        interval = args.short_poll_ms
+                        next_poll = now + interval
+
+    return latencies, polls
+
+
+def percentile(values, percent):
+    if not values:
+        return 0
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, (len(ordered) * percent) // 100)]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("schedule", help="schedule file, - for stdin")
+    parser.add_argument("--duration-ms", type=int, default=0, help="default: last event + 60 s")
+    parser.add_argument("--long-poll-ms", type=int, default=3000, help="ED_KEEP_ALIVE / long poll interval")
+    parser.add_argument("--short-poll-ms", type=int, default=250, help="short poll interval")
+    parser.add_argument("--fast-poll-timeout-ms", type=int, default=10000, help="length of a fast poll window")
+    parser.add_argument("--check-in-ms", type=int, default=60 * 60 * 1000, help="check-in interval, 0 disables")
+    args = parser.parse_args()
+
+    source = sys.stdin if args.schedule == "-" else open(args.schedule, "r", encoding="utf-8")
+    with source:
+        events = parse_schedule(source)
+    duration_ms = args.duration_ms or (events[-1][0] if events else 0) + 60 * 1000
+
+    print(f"{'':12} {'commands':>8} {'mean ms':>8} {'p50 ms':>8} {'p95 ms':>8} {'max ms':>8} {'polls':>8}")
+    for name, policy in (("fixed", False), ("poll control", True)):
+        latencies, polls = simulate(events, duration_ms, args, policy)
+        mean = sum(latencies) / len(latencies) if latencies else 0
+        print(f"{name:12} {len(latencies):8} {mean:8.0f} {percentile(latencies, 50):8} "
+              f"{percentile(latencies, 95):8} {max(latencies, default=0):8} {polls:8}")
+    print("model of main/poll_policy.c, not the firmware code")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+"""
+Tick timeline of the sleepy end device build (sdkconfig.defaults.sleepy), estimates how much of the
+time the chip is awake for a schedule of events.
+
+This is a hand-written model of the wakeups, not generated from the firmware's timers: the durations
+are guesses and timers that aren't listed below (report retries, OTA, the stack's own alarms) are
+missing. Use its output as an estimate and cross-check it against a current trace measured on the
+device before relying on it.
+
+The timeline has 1 ms ticks. The chip is awake for:
+  - every parent poll (ED_KEEP_ALIVE)
+  - the diagnostics publishing alarm, right at the start and then every DIAG_PUBLISH_INTERVAL_MS
+  - every raw input edge, the debounce deadline after it and the long press deadline of a pressed input
+  - toggle pulses and the gap after them (the toggle driver holds a no light sleep lock)
+  - the channel report after the LEDs settled
+and then for the idle time the FreeRTOS tickless idle waits before entering light sleep.
+Channel writes are buffered by the parent and only arrive with the next poll.
+
+Schedule, one event per line, '#' starts a comment:
+  <ms> switch <channel>      channel write from the coordinator, channels count from 1
+  <ms> press <duration ms>   press of the boot button
+
+Usage:
+  python3 tools/sleep_sim.py schedule.txt
+  printf '1000 switch 2\\n20000 press 100\\n' | python3 tools/sleep_sim.py - --duration-ms 60000
+"""
+
+import argparse
+import sys
+
+
+class Timeline:
+    def __init__(self, duration_ms, idle_ms):
+        self.awake = bytearray(duration_ms)
+        self.idle_ms = idle_ms
+
+    def wake(self, start_ms, length_ms=1):
+        """awake from start_ms for length_ms, plus the idle time before sleeping again"""
+        end = min(len(self.awake), start_ms + max(length_ms, 1) + self.idle_ms)
+        for tick in range(max(0, start_ms), end):
+            self.awake[tick] = 1
+
+    def awake_ms(self):
+        return sum(self.awake)
+
+    def wakeups(self):
+        count = 0
+        previous = 0
+        for tick in self.awake:
+            if tick and not previous:
+                count += 1
+            previous = tick
+        return count
+
+
+def parse_schedule(lines):
+    events = []
+    for number, line in enumerate(lines, 1):
+        line = line.split("#", 1)[0].strip()
+        if not line:
+            continue
+        fields = line.split()
+        if len(fields) != 3 or fields[1] not in ("switch", "press"):
+            raise ValueError(f"line {number}: expected '<ms> switch <channel>' or '<ms> press <duration ms>'")
+        events.append((int(fields[0]), fields[1], int(fields[2])))
+    return sorted(events)
+
+
+def edge(timeline, at_ms, args):
+    """raw edge: interrupt and app loop, then the debounce deadline"""
+    timeline.wake(at_ms, args.isr_ms)
+    timeline.wake(at_ms + args.debounce_ms, args.isr_ms)
+
+
+def simulate(events, args):
+    timeline = Timeline(args.duration_ms, args.idle_ms)
+
+    for poll in range(0, args.duration_ms, args.keep_alive_ms):
+        timeline.wake(poll, args.poll_ms)
+    # diag_start_publishing() publishes once and diag_publish() re-arms itself
+    for publish in range(0, args.duration_ms, args.diag_interval_ms):
+        timeline.wake(publish, args.diag_ms)
+
+    channel = 1
+    output_free_ms = 0
+    for at_ms, kind, value in events:
+        if kind == "press":
+            edge(timeline, at_ms, args)
+            edge(timeline, at_ms + value, args)
+            # gesture gap deadline after the release
+            timeline.wake(at_ms + value + args.gesture_gap_ms, args.isr_ms)
+            continue
+
+        if not 1 <= value <= args.channels:
+            raise ValueError(f"channel {value} out of range 1..{args.channels}")
+        # the write is delivered with the next poll
+        received_ms = -(-at_ms // args.keep_alive_ms) * args.keep_alive_ms
+        pulses = (value - channel) % args.channels
+        channel = value
+        start_ms = max(received_ms, output_free_ms)
+        for _ in range(pulses):
+            timeline.wake(start_ms, args.pulse_ms + args.gap_ms)
+            # the LEDs of the old and the new channel change at the end of the pulse
+            edge(timeline, start_ms + args.pulse_ms, args)
+            timeline.wake(start_ms + args.pulse_ms + args.led_debounce_ms + args.long_press_ms, args.isr_ms)
+            start_ms += args.pulse_ms + args.gap_ms
+        output_free_ms = start_ms
+        if pulses:
+            settled_ms = start_ms - args.gap_ms + args.led_debounce_ms
+            timeline.wake(settled_ms, args.report_ms)
+
+    return timeline
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("schedule", help="schedule file, - for stdin")
+    parser.add_argument("--duration-ms", type=int, default=10 * 60 * 1000)
+    parser.add_argument("--channels", type=int, default=2, help="USB_SWITCH_CHANNELS")
+    parser.add_argument("--keep-alive-ms", type=int, default=3000, help="ED_KEEP_ALIVE")
+    parser.add_argument("--poll-ms", type=int, default=6, help="radio on per poll")
+    parser.add_argument("--idle-ms", type=int, default=30, help="CONFIG_FREERTOS_IDLE_TIME_BEFORE_SLEEP in ms")
+    parser.add_argument("--isr-ms", type=int, default=1, help="awake per interrupt or timer")
+    parser.add_argument("--debounce-ms", type=int, default=30, help="debounce of the boot button")
+    parser.add_argument("--led-debounce-ms", type=int, default=50, help="debounce of the LED inputs")
+    parser.add_argument("--long-press-ms", type=int, default=4000, help="long press deadline of the LED inputs")
+    parser.add_argument("--gesture-gap-ms", type=int, default=400, help="GESTURE_BUTTON_GAP_US in ms")
+    parser.add_argument("--pulse-ms", type=int, default=200, help="calibrated pulse width")
+    parser.add_argument("--gap-ms", type=int, default=100, help="calibrated gap")
+    parser.add_argument("--report-ms", type=int, default=6, help="radio on per report")
+    parser.add_argument("--diag-interval-ms", type=int, default=30 * 1000, help="DIAG_PUBLISH_INTERVAL_MS")
+    parser.add_argument("--diag-ms", type=int, default=2, help="awake per diagnostics publish")
+    args = parser.parse_args()
+
+    source = sys.stdin if args.schedule == "-" else open(args.schedule, "r", encoding="utf-8")
+    with source:
+        events = parse_schedule(source)
+
+    timeline = simulate(events, args)
+    awake_ms = timeline.awake_ms()
+    print(f"duration  {args.duration_ms} ms")
+    print(f"events    {len(events)}")
+    print(f"wakeups   {timeline.wakeups()}")
+    print(f"awake     {awake_ms} ms")
+    print(f"fraction  {awake_ms / args.duration_ms:.2%}")
+    print("model estimate, cross-check with a measured current trace")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+"""
+Token database and decoder for the tokenized log of main/tlog.h.
+
+Firmware built with TLOG_TOKENIZED=1 prints hot path messages as
+"$TL <timestamp ms> <level> <token> <args...>" (all hex). The token is the index of the message in
+main/log_tokens.def, the build writes the matching database to build/log_tokens.json.
+
+Usage:
+  python3 tools/tlog.py db main/log_tokens.def build/log_tokens.json
+  idf.py monitor | python3 tools/tlog.py decode build/log_tokens.json
+"""
+
+import json
+import re
+import sys
+
+TOKEN_RE = re.compile(r'^\s*LOG_TOKEN\(\s*(\w+)\s*,\s*((?:"(?:[^"\\]|\\.)*"\s*)+)\)', re.MULTILINE)
+STRING_RE = re.compile(r'"((?:[^"\\]|\\.)*)"')
+LINE_RE = re.compile(r"\$TL ([0-9a-f]+) ([0-9a-f]+) ([0-9a-f]+)((?: [0-9a-f]+)*)")
+# C conversion specifications, length modifiers are dropped for python
+SPEC_RE = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(hh|h|ll|l|z|j|t)?([diouxXc%])")
+
+LEVELS = "NEWIDV"
+
+
+def build_db(def_path, db_path):
+    with open(def_path, "r", encoding="utf-8") as f:
+        source = f.read()
+    tokens = []
+    for token, (name, literals) in enumerate(TOKEN_RE.findall(source)):
+        fmt = "".join(STRING_RE.findall(literals)).encode().decode("unicode_escape")
+        tokens.append({"token": token, "name": name, "format": fmt})
+    with open(db_path, "w", encoding="utf-8") as f:
+        json.dump({"tokens": tokens}, f, indent=2)
+        f.write("\n")
+    return 0
+
+
+def format_message(fmt, args):
+    values = iter(args)
+
+    def convert(match):
+        flags, _, conversion = match.groups()
+        if conversion == "%":
+            return "%"
+        value = next(values, None)
+        if value is None:
+            return "<missing>"
+        if conversion in "di" and value & 0x80000000:
+            value -= 1 << 32
+        return ("%" + flags + conversion) % value
+
+    return SPEC_RE.sub(convert, fmt)
+
+
+def decode(db_path):
+    with open(db_path, "r", encoding="utf-8") as f:
+        formats = {t["token"]: t["format"] for t in json.load(f)["tokens"]}
+    for line in sys.stdin:
+        m = LINE_RE.search(line)
+        if not m:
+            sys.stdout.write(line)
+            continue
+        timestamp, level, token = (int(v, 16) for v in m.groups()[:3])
+        args = [int(v, 16) for v in m.group(4).split()]
+        fmt = formats.get(token)
+        text = format_message(fmt, args) if fmt is not None else f"unknown token {token} {args}"
+        letter = LEVELS[level] if level < len(LEVELS) else "?"
+        sys.stdout.write(f"{line[:m.start()]}{letter} ({timestamp}) tlog: {text}\n")
+        sys.stdout.flush()
+    return 0
+
+
+def main():
+    if len(sys.argv) == 4 and sys.argv[1] == "db":
+        return build_db(sys.argv[2], sys.argv[3])
+    if len(sys.argv) == 3 and sys.argv[1] == "decode":
+        return decode(sys.argv[2])
+    print(__doc__.strip())
+    return 2
+
+
+if __name__ == "__main__":
+    sys.exit(main())
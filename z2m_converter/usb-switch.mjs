@@ -7,14 +7,24 @@ import {
 import reporting from "zigbee-herdsman-converters/lib/reporting";
 import utils from "zigbee-herdsman-converters/lib/utils";
 
-const channelValues = ["ch_1", "ch_2"];
+// the device reports its channel count (USB_SWITCH_CHANNELS) as numberOfStates of endpoint 10,
+// it is read during configure. Present value n is channel "ch_<n + 1>".
+const defaultChannelCount = 2;
+const channelCount = (device) => device?.meta?.numberOfStates ?? defaultChannelCount;
+const channelValues = (count) => Array.from({ length: count }, (_, i) => `ch_${i + 1}`);
+// values of the multistate action attribute on endpoint 11 (usb_switch_action_t) that the device reports.
+// Hold, toggle reset and calibrate are handled on the device and never reported.
+const actionValues = { 1: "single", 2: "double" };
 
 const switchLocalInput = {
   cluster: "genMultistateValue",
   type: ["readResponse", "attributeReport"],
   convert: (model, msg, publish, options, meta) => {
+    if (msg.endpoint.ID !== 10) {
+      return;
+    }
     const presentValue = msg.data["presentValue"];
-    const action = channelValues[presentValue];
+    const action = channelValues(channelCount(meta.device))[presentValue];
     const property = "channel";
     return {
       [property]: `${action}`,
@@ -22,13 +32,28 @@ const switchLocalInput = {
   },
 };
 
+const switchAction = {
+  cluster: "genMultistateValue",
+  type: ["attributeReport"],
+  convert: (model, msg, publish, options, meta) => {
+    if (msg.endpoint.ID !== 11) {
+      return;
+    }
+    const action = actionValues[msg.data["presentValue"]];
+    if (!action) {
+      return;
+    }
+    return { action };
+  },
+};
+
 const switchLocalOutput = {
   key: ["channel"],
   convertSet: async (entity, key, value, meta) => {
     utils.assertString(value, key);
     await entity.write(
       "genMultistateValue",
-      { presentValue: channelValues.indexOf(value) },
+      { presentValue: channelValues(channelCount(meta.device)).indexOf(value) },
       utils.getOptions(meta.mapped, entity),
     );
     return { state: { channel: value } };
@@ -50,13 +75,19 @@ export default {
   vendor: "KONQI",
   description: "konqi's homebrew usb-switch extension",
   ota: true,
-  fromZigbee: [switchLocalInput],
+  fromZigbee: [switchLocalInput, switchAction],
   toZigbee: [switchLocalOutput],
-  exposes: [e.enum("channel", ea.ALL, channelValues)],
+  exposes: (device, options) => [
+    e.enum("channel", ea.ALL, channelValues(channelCount(device))),
+    e.action(Object.values(actionValues)),
+  ],
   extend: [identify(), onOff({ powerOnBehavior: false })],
   configure: async (device, coordinatorEndpoint, logger) => {
     const endpoint = device.getEndpoint(10);
     // await endpoint.read("genMultistateValue", ["presentValue"]);
+    const { numberOfStates } = await endpoint.read("genMultistateValue", ["numberOfStates"]);
+    device.meta.numberOfStates = numberOfStates;
+    device.save();
     await endpoint.bind("genMultistateValue", coordinatorEndpoint);
     await endpoint.configureReporting("genMultistateValue", [
       {
@@ -66,6 +97,8 @@ export default {
         reportableChange: 1,
       },
     ]);
+    const actionEndpoint = device.getEndpoint(11);
+    await actionEndpoint.bind("genMultistateValue", coordinatorEndpoint);
   },
   meta: {},
 };